@@ -147,9 +147,9 @@
 ; This is our image structure 100MB (0x00000000->0x06400000):
 ;    Address|        FAT 16   |SECTOR|           Description                   |
 ; 0x00000000| BPB REGION      |  1   | Boot sector.                            |
-; 0x00000200| RESERVED REGION | 200  | Our kernel code.                        |
-; 0x00019000| FAT REGION      | 400  | FAT.                                    |
-; 0x0004B000| ROOT DIRECTORY  |      | Contain directory entries.              |
+; 0x00000200| RESERVED REGION | 400  | Loader, kernel and shell code.          |
+; 0x00032000| FAT REGION      | 400  | FAT.                                    |
+; 0x00064000| ROOT DIRECTORY  |      | Contain directory entries.              |
 ; ..........|                 |      |                                         |
 ; ..........| DATA REGION     |      |                                         |
 ; ..........|                 |      |                                         |
@@ -171,8 +171,8 @@ nop
 OEMIdetifier db     'LARVAOS '
 BytesPerSector      dw 0x200
 SectorsPerCluster   db 0x4      ; Each cluster is 2KB.
-ReservedSectors     dw 0xC8     ; We reverse first 200 sectors for our kernel.
-                                ; So, the FAT REGION will start at sector 201.
+ReservedSectors     dw 0x190    ; We reverse first 400 sectors for our kernel.
+                                ; So, the FAT REGION will start at sector 401.
 FATcopies           db 0x02
 RootDirEntries      dw 0x200
 NumSectors          dw 0x00
@@ -3,9 +3,9 @@
 ; physical memory at address 0x7E00. First of all, to prepare to long mode, we
 ; need to check it is supported or not. That is done by using `cpuid`
 ; instruction and it's service: "EAX Maximum Input Value for Extended Function 
-; CPUID Information.". After that we load 100 sectors [6:105] which we have
-; spent for our kernel code (51200 bytes are enough for our kernel code). Now
-; the physical memory look like:
+; CPUID Information.". After that we load 256 sectors [6:261] which we have
+; spent for our kernel code (the build checks kernel.bin fits in 131072 bytes).
+; Now the physical memory look like:
 ;              Memory
 ;      |-------------------| Max size
 ;      |      Free         |
@@ -13,7 +13,12 @@
 ;      |      Reserved     |
 ;      |-------------------| 0x80000
 ;      |      Free         |
-;      |                   | 0x10000 -> We will use this region for kernel code.
+;      |-------------------| 0x50000
+;      |      Kernel       | 0x30000 -> We will use this region for kernel code.
+;      |-------------------|
+;      |      Shell        | 0x20000
+;      |-------------------|
+;      |      Free         |
 ;      |-------------------|
 ;      |      Loader       | 0x7E00
 ;      |-------------------|
@@ -54,12 +59,18 @@
 ; - Enable long mode by setting bits in special registers (cr4, cr3, msr).
 ; - Enable paging by setting bit[31] in cr0 register.
 ; After switch to long mode, final missions of loader code are relocated kernel
-; code from address 0x10000 to 0x200000 and finally jump to it. So from now we
+; code from address 0x30000 to 0x200000 and finally jump to it. So from now we
 ; can run kernel code and user application in 64 bit mode. Congratulation!
 
 [BITS 16]
 [ORG 0x7E00]
 
+; The kernel area of the disk image, keep it the same as the Makefile.
+KERNEL_START_SECTOR     equ 6
+KERNEL_SECTORS          equ 256
+KERNEL_READ_SECTORS     equ 64      ; 32KB per read, BIOSes read at most 127.
+SHELL_START_SECTOR      equ KERNEL_START_SECTOR + KERNEL_SECTORS
+
 Start:
     ; 1. Get DriveID from boot-code.
     mov [DriveID], dl
@@ -82,23 +93,33 @@ Start:
     test edx, (1<<26)       ; Bit 26: 1-GByte pages are available if 1.
     jz NotSupport           ; If zero flag is set, CPU doesn't support.
 
-    ; 4. Load the kernel file to address 0x0010000.
+    ; 4. Load the kernel file to address 0x0030000.
 LoadKernel:
     mov si, ReadPacket
     mov word[si], 0x10          ; Packet size is 16 bytes.
-    mov word[si + 2], 0x64      ; We will load 100 sectors from the disk.
     mov word[si + 4], 0x00      ; Memory offset.
-    mov word[si + 6], 0x1000    ; Memory segment. So, we will load the kernel
-                                ; code to physical memory at address: 0x1000 *
-                                ; 0x10 + 0x00 = 0x10000
-    mov dword[si + 8], 0x06     ; We load from sector 7 from hard disk image to
-    mov dword[si + 12], 0x00    ; sector 107.
+    mov word[si + 6], 0x3000    ; Memory segment. So, we will load the kernel
+                                ; code to physical memory at address: 0x3000 *
+                                ; 0x10 + 0x00 = 0x30000
+    mov dword[si + 8], KERNEL_START_SECTOR  ; We load from sector 7 from hard
+    mov dword[si + 12], 0x00                ; disk image to sector 262.
+
+    ; The kernel is read in pieces, a read can't cross a 64KB segment.
+ReadKernel:
+    mov si, ReadPacket
+    mov word[si + 2], KERNEL_READ_SECTORS   ; The BIOS may change the count.
 
     mov dl, [DriveID]           ; DriveID param.
     mov ah, 0x42                ; Use INT 13 Extensions - EXTENDED READ service.
     int 0x13                    ; Call the Disk Service.
     jc ReadError                ; Carry flag will be set if error.
 
+    mov si, ReadPacket
+    add word[si + 6], KERNEL_READ_SECTORS * 512 / 16   ; Next segment.
+    add dword[si + 8], KERNEL_READ_SECTORS
+    cmp dword[si + 8], SHELL_START_SECTOR
+    jb ReadKernel
+
 ; Load the shell process to 0x20000 to run init process.
 LoadShell:
     mov si, ReadPacket
@@ -108,8 +129,8 @@ LoadShell:
     mov word[si + 6], 0x2000    ; Memory segment. So, we will load the user
                                 ; code to physical memory at address: 0x2000 *
                                 ; 0x10 + 0x00 = 0x20000
-    mov dword[si + 8], 0x6A     ; We load from sector 107 from hard disk image
-    mov dword[si + 12], 0x00    ; to sector 127.
+    mov dword[si + 8], SHELL_START_SECTOR   ; We load from sector 263 from
+    mov dword[si + 12], 0x00                ; hard disk image to sector 282.
 
     mov dl, [DriveID]           ; DriveID param.
     mov ah, 0x42                ; Use INT 13 Extensions - EXTENDED READ service.
@@ -323,12 +344,12 @@ LMEntry:
     ; 14. Initialize stack pointer.
     mov rsp, 0x7C00
 
-    ; 15. Relocate kernel from 0x10000 to 0x200000 and jump to it.
+    ; 15. Relocate kernel from 0x30000 to 0x200000 and jump to it.
     cld                 ; Clear direction flag.
     mov rdi, 0x200000   ; Destination address.
-    mov rsi, 0x10000    ; Source address.
-    mov rcx, 51200/8    ; RCX acts as a counter, we will copy 100 sectors: 512
-                        ; * 100 = 51200 bytes.
+    mov rsi, 0x30000    ; Source address.
+    mov rcx, KERNEL_SECTORS * 512 / 8   ; RCX acts as a counter, we copy 256
+                                        ; sectors: 512 * 256 = 131072 bytes.
     rep movsq           ; Repeat quad-word one time.
 
     ; Since the kernel is relocated to the new virtual address which is far away
@@ -0,0 +1,202 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "acpi.h"
+#include "memory.h"
+
+/* Private define ------------------------------------------------------------*/
+#define EBDA_SEGMENT_POINTER        0x40E
+#define EBDA_SEARCH_SIZE            1024
+#define BIOS_AREA_START             0xE0000
+#define BIOS_AREA_END               0x100000
+#define RSDP_ALIGNMENT              16
+#define RSDP_REVISION_1_SIZE        20
+
+/* The MMIO region is never given back, so every table is mapped once, at the
+ * first lookup. The root table rarely lists more than a dozen tables. */
+#define ACPI_MAXIMUM_TABLES         32
+
+/* Private type --------------------------------------------------------------*/
+/**
+ * @brief   Root System Description Pointer, the XSDT fields only exist from
+ *          revision 2.
+ */
+typedef struct {
+    char signature[8];          /* "RSD PTR ".                              */
+    uint8_t checksum;           /* Of the first 20 bytes.                   */
+    char oem_id[6];
+    uint8_t revision;
+    uint32_t rsdt_address;
+    uint32_t length;
+    uint64_t xsdt_address;
+    uint8_t extended_checksum;
+    uint8_t reserved[3];
+} __attribute__ ((packed)) RSDP;
+
+/* Private variable ----------------------------------------------------------*/
+static ACPITableHeader *s_root_table = NULL;
+static uint32_t s_root_entry_size = 0;
+static ACPITableHeader *s_tables[ACPI_MAXIMUM_TABLES];
+static uint32_t s_table_count = 0;
+
+/* Private function prototypes -----------------------------------------------*/
+/**
+ * @brief   Search the RSDP in a physical range, the range is in the kernel
+ *          mapping of low memory.
+ */
+static RSDP *SearchRSDP(uint64_t start, uint64_t end);
+
+/**
+ * @brief   Map a whole table at the physical address and check its checksum.
+ */
+static ACPITableHeader *MapTable(uint64_t phys);
+
+/**
+ * @brief   Sum of the bytes, a valid structure sums to 0.
+ */
+static uint8_t Checksum(const void *data, uint64_t size);
+
+/**
+ * @brief   Find the RSDP and map the RSDT or the XSDT.
+ */
+static bool MapRootTable(void);
+
+/**
+ * @brief   Map every table which the root table lists.
+ */
+static void MapTables(void);
+
+/* Public function -----------------------------------------------------------*/
+ACPITableHeader *FindACPITable(const char *signature)
+{
+    if (s_root_table == NULL) {
+        if (!MapRootTable()) {
+            return NULL;
+        }
+
+        MapTables();
+    }
+
+    for (uint32_t i = 0; i < s_table_count; i++) {
+        if (memcmp(s_tables[i]->signature, signature, 4) == 0) {
+            return s_tables[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Private function ----------------------------------------------------------*/
+static RSDP *SearchRSDP(uint64_t start, uint64_t end)
+{
+    for (uint64_t p = start; p + sizeof(RSDP) <= end; p += RSDP_ALIGNMENT) {
+        RSDP *rsdp = (RSDP *)PHY_TO_VIR(p);
+
+        if (memcmp(rsdp->signature, "RSD PTR ", 8) == 0
+            && Checksum(rsdp, RSDP_REVISION_1_SIZE) == 0) {
+            return rsdp;
+        }
+    }
+
+    return NULL;
+}
+
+static ACPITableHeader *MapTable(uint64_t phys)
+{
+    ACPITableHeader *table = NULL;
+    uint32_t length = 0;
+    uint64_t mapped = 0;
+
+    /* The header mapping covers the rest of its page, most tables fit in it.
+     * A header across pages is mapped by its two pages. */
+    mapped = SMALL_PAGE_SIZE - (phys & (SMALL_PAGE_SIZE - 1));
+    if (mapped < sizeof(ACPITableHeader)) {
+        mapped += SMALL_PAGE_SIZE;
+    }
+
+    table = (ACPITableHeader *)MapMMIO(phys, mapped);
+    if (table == NULL) {
+        return NULL;
+    }
+
+    length = table->length;
+    if (length < sizeof(ACPITableHeader)) {
+        return NULL;
+    }
+
+    if (length > mapped) {
+        table = (ACPITableHeader *)MapMMIO(phys, length);
+    }
+
+    if (table == NULL || Checksum(table, length) != 0) {
+        return NULL;
+    }
+
+    return table;
+}
+
+static uint8_t Checksum(const void *data, uint64_t size)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint8_t sum = 0;
+
+    for (uint64_t i = 0; i < size; i++) {
+        sum += bytes[i];
+    }
+
+    return sum;
+}
+
+static bool MapRootTable(void)
+{
+    uint64_t ebda = (uint64_t)*(uint16_t *)PHY_TO_VIR(EBDA_SEGMENT_POINTER) << 4;
+    RSDP *rsdp = NULL;
+
+    if (ebda != 0) {
+        rsdp = SearchRSDP(ebda, ebda + EBDA_SEARCH_SIZE);
+    }
+
+    if (rsdp == NULL) {
+        rsdp = SearchRSDP(BIOS_AREA_START, BIOS_AREA_END);
+    }
+
+    if (rsdp == NULL) {
+        return false;
+    }
+
+    if (rsdp->revision >= 2
+        && rsdp->xsdt_address != 0
+        && Checksum(rsdp, rsdp->length) == 0) {
+        s_root_table = MapTable(rsdp->xsdt_address);
+        s_root_entry_size = sizeof(uint64_t);
+    } else {
+        s_root_table = MapTable(rsdp->rsdt_address);
+        s_root_entry_size = sizeof(uint32_t);
+    }
+
+    return s_root_table != NULL;
+}
+
+static void MapTables(void)
+{
+    uint64_t entries = (s_root_table->length - sizeof(ACPITableHeader))
+                       / s_root_entry_size;
+    const uint8_t *entry = (const uint8_t *)(s_root_table + 1);
+    uint64_t phys = 0;
+    ACPITableHeader *table = NULL;
+
+    for (uint64_t i = 0;
+         i < entries && s_table_count < ACPI_MAXIMUM_TABLES;
+         i++, entry += s_root_entry_size) {
+        /* Entries of the RSDT are 32-bit, entries of the XSDT are 64-bit, and
+         * both are not aligned. */
+        phys = 0;
+        memcpy(&phys, entry, s_root_entry_size);
+
+        /* A table with a bad checksum is never returned. */
+        table = MapTable(phys);
+        if (table != NULL) {
+            s_tables[s_table_count++] = table;
+        }
+    }
+}
@@ -0,0 +1,45 @@
+/**
+ * @file    acpi.h
+ * @author  Cong Nguyen (congnt264@gmail.com)
+ * @brief   ACPI table lookup. The firmware puts the Root System Description
+ *          Pointer (RSDP) in the first KB of the EBDA or in the BIOS area
+ *          0xE0000-0xFFFFF, it points to the RSDT (32-bit entries) or the XSDT
+ *          (64-bit entries), which list the physical addresses of the other
+ *          tables. The tables are usually in reserved memory after the RAM we
+ *          map, so they are mapped to the MMIO region to be read.
+ *
+ * @version 0.1
+ * @date 2023-09-24
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+#include <stdint.h>
+
+/* Public type ---------------------------------------------------------------*/
+/**
+ * @brief   Header of all system description tables.
+ */
+typedef struct {
+    char signature[4];
+    uint32_t length;            /* Length of the table with the header. */
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__ ((packed)) ACPITableHeader;
+
+/* Public function prototype -------------------------------------------------*/
+/**
+ * @brief       Find a table by its signature. All tables are mapped at the
+ *              first lookup, later lookups don't map anything.
+ *
+ * @param[in]   signature   - Signature of 4 characters, "APIC" for the MADT.
+ * @return      ACPITableHeader* - Mapped table, its checksum is checked.
+ *                          - NULL if there is no such table.
+ */
+ACPITableHeader *FindACPITable(const char *signature);
@@ -0,0 +1,378 @@
+#include <stddef.h>
+
+#include "bcache.h"
+#include "memory.h"
+#include "wait.h"
+#include "assert.h"
+
+/* Private type --------------------------------------------------------------*/
+/**
+ * @brief   Buffer cache structure.
+ *
+ * @property buffers    - All buffers.
+ * @property hash       - Buffers by sector number.
+ * @property lru_head   - Most recently used buffer.
+ * @property lru_tail   - Least recently used buffer.
+ * @property wait_queue - Processes waiting for a buffer to be read, or for a
+ *                        buffer to be released.
+ * @property stats      - Statistics.
+ */
+typedef struct {
+    Buffer *buffers;
+    Buffer *hash[BCACHE_HASH_BUCKETS];
+    Buffer *lru_head;
+    Buffer *lru_tail;
+    WaitQueue wait_queue;
+    BufferCacheStats stats;
+} BufferCache;
+
+/* Private variable ----------------------------------------------------------*/
+static BufferCache s_bcache;
+
+/* Private function prototypes -----------------------------------------------*/
+static Buffer *BufferLookup(uint32_t sector);
+
+static void HashInsert(Buffer *buf);
+
+static void HashRemove(Buffer *buf);
+
+static void LRURemove(Buffer *buf);
+
+static void LRUPushFront(Buffer *buf);
+
+/**
+ * @brief   Find the least recently used buffer that nobody holds.
+ */
+static Buffer *FindVictim(void);
+
+/**
+ * @brief   Write a held dirty buffer back to the disk.
+ */
+static void WriteBack(Buffer *buf);
+
+/**
+ * @brief   Take a free buffer for a sector and hold it, the buffer is busy
+ *          until its data is read.
+ */
+static void ClaimBuffer(Buffer *buf, uint32_t sector);
+
+/**
+ * @brief   Bring consecutive sectors into the cache, the read buffers get the
+ *          `flags`.
+ */
+static int Prefetch(uint32_t sector, uint32_t count, uint32_t flags);
+
+/**
+ * @brief   Read the data of claimed buffers of consecutive sectors with one
+ *          disk command, and release them.
+ */
+static void ReadRun(Buffer **run, uint32_t count, uint32_t flags);
+
+/* Public function -----------------------------------------------------------*/
+void InitBufferCache(void)
+{
+    ASSERT(BCACHE_BUFFERS * sizeof(Buffer) <= PAGE_SIZE);
+
+    s_bcache.buffers = (Buffer *)kalloc();
+    ASSERT(s_bcache.buffers != NULL);
+
+    for (int i = 0; i < BCACHE_BUFFERS; i++) {
+        Buffer *buf = &s_bcache.buffers[i];
+
+        buf->sector = 0;
+        buf->flags = 0;
+        buf->ref_count = 0;
+        buf->hash_next = NULL;
+        LRUPushFront(buf);
+    }
+
+    s_bcache.stats.buffers = BCACHE_BUFFERS;
+}
+
+Buffer *BufferRead(uint32_t sector)
+{
+    Buffer *buf = NULL;
+
+    for (;;) {
+        buf = BufferLookup(sector);
+        if (buf != NULL) {
+            s_bcache.stats.hits++;
+            buf->ref_count++;
+
+            if ((buf->flags & BUFFER_READAHEAD) != 0) {
+                buf->flags &= ~BUFFER_READAHEAD;
+                s_bcache.stats.readahead_hits++;
+            }
+
+            /* Another process is reading the sector, sleep until the data is
+             * there. */
+            while ((buf->flags & BUFFER_VALID) == 0) {
+                Sleep(&s_bcache.wait_queue);
+            }
+
+            return buf;
+        }
+
+        buf = FindVictim();
+        if (buf == NULL) {
+            /* All buffers are held, wait for a release. */
+            Sleep(&s_bcache.wait_queue);
+            continue;
+        }
+
+        if ((buf->flags & BUFFER_DIRTY) != 0) {
+            /* The write back can be preempted, somebody else may cache the
+             * sector or take the buffer meanwhile, so we look again. */
+            buf->ref_count++;
+            WriteBack(buf);
+            BufferRelease(buf);
+            continue;
+        }
+
+        break;
+    }
+
+    ClaimBuffer(buf, sector);
+
+    DiskReadSectors(sector, 1, buf->data);
+
+    buf->flags = BUFFER_VALID;
+    Wakeup(&s_bcache.wait_queue);
+
+    return buf;
+}
+
+int BufferReadahead(uint32_t sector, uint32_t count)
+{
+    int read = Prefetch(sector, count, BUFFER_READAHEAD);
+
+    s_bcache.stats.readahead += read;
+
+    return read;
+}
+
+void BufferReadDirect(uint32_t sector, uint32_t count, void *data)
+{
+    DiskReadSectors(sector, count, data);
+    s_bcache.stats.misses += count;
+}
+
+bool BufferIsCached(uint32_t sector)
+{
+    return BufferLookup(sector) != NULL;
+}
+
+void BufferRelease(Buffer *buf)
+{
+    ASSERT(buf->ref_count > 0);
+
+    buf->ref_count--;
+    if (buf->ref_count == 0) {
+        LRURemove(buf);
+        LRUPushFront(buf);
+        Wakeup(&s_bcache.wait_queue);
+    }
+}
+
+void BufferMarkDirty(Buffer *buf)
+{
+    ASSERT(buf->ref_count > 0);
+
+    if ((buf->flags & BUFFER_DIRTY) == 0) {
+        buf->flags |= BUFFER_DIRTY;
+        s_bcache.stats.dirty++;
+    }
+}
+
+int BufferSync(void)
+{
+    int written = 0;
+
+    for (int i = 0; i < BCACHE_BUFFERS; i++) {
+        Buffer *buf = &s_bcache.buffers[i];
+
+        /* A busy buffer is written or read by another process already. */
+        if ((buf->flags & BUFFER_DIRTY) == 0
+            || (buf->flags & BUFFER_BUSY) != 0) {
+            continue;
+        }
+
+        buf->ref_count++;
+        WriteBack(buf);
+        BufferRelease(buf);
+        written++;
+    }
+
+    return written;
+}
+
+void GetBufferCacheStats(BufferCacheStats *stats)
+{
+    *stats = s_bcache.stats;
+}
+
+/* Private function ----------------------------------------------------------*/
+static Buffer *BufferLookup(uint32_t sector)
+{
+    Buffer *buf = s_bcache.hash[sector % BCACHE_HASH_BUCKETS];
+
+    while (buf != NULL && buf->sector != sector) {
+        buf = buf->hash_next;
+    }
+
+    return buf;
+}
+
+static void HashInsert(Buffer *buf)
+{
+    Buffer **bucket = &s_bcache.hash[buf->sector % BCACHE_HASH_BUCKETS];
+
+    buf->hash_next = *bucket;
+    *bucket = buf;
+}
+
+static void HashRemove(Buffer *buf)
+{
+    /* A free buffer is only out of the hash table before its first use. */
+    if ((buf->flags & BUFFER_VALID) == 0) {
+        return;
+    }
+
+    Buffer **link = &s_bcache.hash[buf->sector % BCACHE_HASH_BUCKETS];
+
+    while (*link != buf) {
+        ASSERT(*link != NULL);
+        link = &(*link)->hash_next;
+    }
+
+    *link = buf->hash_next;
+    buf->hash_next = NULL;
+}
+
+static void LRURemove(Buffer *buf)
+{
+    if (buf->lru_prev != NULL) {
+        buf->lru_prev->lru_next = buf->lru_next;
+    } else {
+        s_bcache.lru_head = buf->lru_next;
+    }
+
+    if (buf->lru_next != NULL) {
+        buf->lru_next->lru_prev = buf->lru_prev;
+    } else {
+        s_bcache.lru_tail = buf->lru_prev;
+    }
+}
+
+static void LRUPushFront(Buffer *buf)
+{
+    buf->lru_prev = NULL;
+    buf->lru_next = s_bcache.lru_head;
+
+    if (s_bcache.lru_head != NULL) {
+        s_bcache.lru_head->lru_prev = buf;
+    } else {
+        s_bcache.lru_tail = buf;
+    }
+
+    s_bcache.lru_head = buf;
+}
+
+static Buffer *FindVictim(void)
+{
+    for (Buffer *buf = s_bcache.lru_tail; buf != NULL; buf = buf->lru_prev) {
+        if (buf->ref_count == 0) {
+            return buf;
+        }
+    }
+
+    return NULL;
+}
+
+static void ClaimBuffer(Buffer *buf, uint32_t sector)
+{
+    /* Reuse the buffer for the sector, it is held and busy until the data is
+     * read, so it is not evicted, and other readers of the sector wait. */
+    HashRemove(buf);
+    buf->sector = sector;
+    buf->flags = BUFFER_BUSY;
+    buf->ref_count = 1;
+    HashInsert(buf);
+    s_bcache.stats.misses++;
+}
+
+static int Prefetch(uint32_t sector, uint32_t count, uint32_t flags)
+{
+    Buffer *run[BCACHE_MAXIMUM_PREFETCH];
+    uint32_t run_length = 0;
+    int read = 0;
+
+    ASSERT(count <= BCACHE_MAXIMUM_PREFETCH);
+
+    for (uint32_t i = 0; i < count; i++) {
+        Buffer *buf = BufferLookup(sector + i);
+
+        if (buf == NULL) {
+            buf = FindVictim();
+
+            /* Don't write back for a hint, stop at the first dirty victim. */
+            if (buf == NULL || (buf->flags & BUFFER_DIRTY) != 0) {
+                break;
+            }
+
+            ClaimBuffer(buf, sector + i);
+            run[run_length++] = buf;
+            continue;
+        }
+
+        /* A cached sector ends the run. */
+        if (run_length > 0) {
+            ReadRun(run, run_length, flags);
+            read += run_length;
+            run_length = 0;
+        }
+    }
+
+    if (run_length > 0) {
+        ReadRun(run, run_length, flags);
+        read += run_length;
+    }
+
+    return read;
+}
+
+static void ReadRun(Buffer **run, uint32_t count, uint32_t flags)
+{
+    void *data[BCACHE_MAXIMUM_PREFETCH];
+
+    for (uint32_t i = 0; i < count; i++) {
+        data[i] = run[i]->data;
+    }
+
+    DiskReadSectorsScatter(run[0]->sector, count, data);
+
+    for (uint32_t i = 0; i < count; i++) {
+        run[i]->flags = BUFFER_VALID | flags;
+        BufferRelease(run[i]);
+    }
+
+    /* Readers which found a buffer of the run hold it too, so the release
+     * doesn't wake them up. */
+    Wakeup(&s_bcache.wait_queue);
+}
+
+static void WriteBack(Buffer *buf)
+{
+    ASSERT(buf->ref_count > 0);
+
+    /* Clear the dirty flag first, the holders may modify the data again while
+     * the write runs, it is marked dirty again then. */
+    buf->flags &= ~BUFFER_DIRTY;
+    buf->flags |= BUFFER_BUSY;
+    s_bcache.stats.dirty--;
+
+    DiskWriteSectors(buf->sector, 1, buf->data);
+
+    buf->flags &= ~BUFFER_BUSY;
+    s_bcache.stats.writebacks++;
+}
@@ -0,0 +1,164 @@
+/**
+ * @file    bcache.h
+ * @author  Cong Nguyen (congnt264@gmail.com)
+ * @brief   The block buffer cache keeps recently used disk sectors in memory,
+ *          so opening a file doesn't read the whole root directory from the
+ *          disk again, and reading a file twice only reads the disk once.
+ *
+ *          Each buffer holds one sector. Buffers are found by sector number
+ *          in a hash table, and they are kept in a LRU list: a released buffer
+ *          goes to the head, and a miss reuses the least recently used buffer
+ *          that nobody holds. A buffer is held (referenced) from BufferRead()
+ *          to BufferRelease(), its data can only be used in between.
+ *
+ *          The disk transfer of a buffer can be preempted, the buffer is busy
+ *          meanwhile, and other processes reading the same sector sleep until
+ *          the data is there. Modified buffers are marked dirty and written
+ *          back when they are evicted or at BufferSync().
+ *
+ * @version 0.1
+ * @date 2023-09-27
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "disk.h"
+
+/* Public define -------------------------------------------------------------*/
+/* Size of the cache, all buffers live in one page. */
+#define BCACHE_BUFFERS              256
+#define BCACHE_HASH_BUCKETS         64
+
+/* Maximum sectors of a BufferReadahead(), read with one disk command. */
+#define BCACHE_MAXIMUM_PREFETCH     64
+
+#define BUFFER_VALID                (1 << 0)    /* Data is read from disk.    */
+#define BUFFER_DIRTY                (1 << 1)    /* Data is newer than disk.   */
+#define BUFFER_BUSY                 (1 << 2)    /* Disk transfer is running.  */
+#define BUFFER_READAHEAD            (1 << 3)    /* Read ahead, not used yet.  */
+
+/* Public type ---------------------------------------------------------------*/
+/**
+ * @brief   Buffer of one disk sector.
+ *
+ * @property sector     - Sector number (LBA) of the data.
+ * @property flags      - BUFFER_* flags.
+ * @property ref_count  - Number of holders, held buffers are never evicted.
+ * @property hash_next  - Next buffer in the hash bucket.
+ * @property lru_prev   - Previous (more recently used) buffer in the LRU list.
+ * @property lru_next   - Next (less recently used) buffer in the LRU list.
+ * @property data       - Sector data.
+ */
+typedef struct Buffer {
+    uint32_t sector;
+    uint32_t flags;
+    int ref_count;
+    struct Buffer *hash_next;
+    struct Buffer *lru_prev;
+    struct Buffer *lru_next;
+    uint8_t data[SECTOR_SIZE];
+} Buffer;
+
+/**
+ * @brief   Buffer cache statistics.
+ *
+ * @property hits       - Reads found in the cache.
+ * @property misses     - Reads which went to the disk.
+ * @property writebacks - Dirty buffers written to the disk.
+ * @property readahead  - Sectors read ahead of the readers.
+ * @property readahead_hits - Read ahead sectors which were read later.
+ * @property buffers    - Size of the cache in buffers.
+ * @property dirty      - Number of dirty buffers now.
+ */
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t writebacks;
+    uint64_t readahead;
+    uint64_t readahead_hits;
+    uint64_t buffers;
+    uint64_t dirty;
+} BufferCacheStats;
+
+/* Public function prototype -------------------------------------------------*/
+/**
+ * @brief       Allocate the buffers, all of them are empty.
+ */
+void InitBufferCache(void);
+
+/**
+ * @brief       Get a held buffer with the data of a sector, it is read from the
+ *              disk if it is not cached. The function sleeps if the sector is
+ *              being read by another process, or if all buffers are held.
+ *
+ * @param[in]   sector      - Sector number (LBA).
+ * @return      Buffer*     - Buffer, release it with BufferRelease().
+ */
+Buffer *BufferRead(uint32_t sector);
+
+/**
+ * @brief       Read consecutive sectors nobody asked for yet into the cache,
+ *              the sectors which are not cached are read with as few disk
+ *              commands as possible. It is a hint: a run stops early when no
+ *              clean buffer is free. The read buffers are counted as
+ *              readahead, and as readahead hits when BufferRead() gets them
+ *              later.
+ *
+ * @param[in]   sector      - First sector number (LBA).
+ * @param[in]   count       - Number of sectors, at most
+ *                            BCACHE_MAXIMUM_PREFETCH.
+ * @return      int         - Number of sectors read from the disk.
+ */
+int BufferReadahead(uint32_t sector, uint32_t count);
+
+/**
+ * @brief       Read sectors which are not cached straight to the caller's
+ *              memory, the cache is bypassed but the reads are counted as
+ *              misses.
+ *
+ * @param[in]   sector      - First sector number (LBA).
+ * @param[in]   count       - Number of sectors, at most
+ *                            DISK_MAXIMUM_SECTORS_PER_COMMAND.
+ * @param[out]  data        - Destination, count * SECTOR_SIZE bytes.
+ */
+void BufferReadDirect(uint32_t sector, uint32_t count, void *data);
+
+/**
+ * @brief       Check a sector is in the cache, or being read into it. The LRU
+ *              order is not changed.
+ *
+ * @param[in]   sector      - Sector number (LBA).
+ */
+bool BufferIsCached(uint32_t sector);
+
+/**
+ * @brief       Release a buffer which was got by BufferRead(), it becomes the
+ *              most recently used buffer.
+ *
+ * @param[in]   buf         - Buffer.
+ */
+void BufferRelease(Buffer *buf);
+
+/**
+ * @brief       Mark a held buffer modified, it is written back later.
+ *
+ * @param[in]   buf         - Buffer.
+ */
+void BufferMarkDirty(Buffer *buf);
+
+/**
+ * @brief       Write all dirty buffers back to the disk.
+ *
+ * @return      int         - Number of written buffers.
+ */
+int BufferSync(void);
+
+/**
+ * @brief       Get the buffer cache statistics.
+ *
+ * @param[out]  stats       - Statistics.
+ */
+void GetBufferCacheStats(BufferCacheStats *stats);
@@ -0,0 +1,183 @@
+#include <stddef.h>
+#include <errno.h>
+
+#include <vdso.h>
+
+#include "clock.h"
+#include "timer.h"
+#include "memory.h"
+#include "pit.h"
+#include "trap.h"
+#include "printk.h"
+
+/* Private define ------------------------------------------------------------*/
+#define CPUID_EXTENDED_MAXIMUM_LEAF     0x80000000
+#define CPUID_ADVANCED_POWER_LEAF       0x80000007
+#define CPUID_80000007_EDX_INVARIANT_TSC (1 << 8)
+#define CLOCK_SHIFT                     32
+
+/* Longer sleeps are cut to this, so the deadline in microseconds never
+ * overflows. It is still thousands of years. */
+#define SLEEP_MAXIMUM_SECONDS           ((UINT64_MAX / 4)                      \
+                                         / (NS_PER_SECOND / NS_PER_US))
+
+/* Private variable ----------------------------------------------------------*/
+static bool s_use_tsc = false;
+static uint64_t s_tsc_frequency = 0;
+static uint64_t s_tsc_base = 0;             /* TSC value at time 0.           */
+static uint64_t s_tsc_mult = 0;             /* ns per cycle << CLOCK_SHIFT.   */
+static VDSOTimeData *s_time_page = NULL;
+
+/* Private function prototypes -----------------------------------------------*/
+/**
+ * @brief   Check CPUID for an invariant TSC.
+ */
+static bool HasInvariantTSC(void);
+
+/**
+ * @brief   Count TSC cycles for PIT_CALIBRATION_MS, measured by the PIT.
+ */
+static void CalibrateTSC(void);
+
+/**
+ * @brief   Publish the clock parameters to the user time page.
+ */
+static void UpdateTimePage(void);
+
+/* Public function -----------------------------------------------------------*/
+void InitClock(void)
+{
+    uint64_t uptime_ns = 0;
+
+    s_time_page = (VDSOTimeData *)MapUserSharedPage(VDSO_TIME_PAGE_ADDRESS);
+    if (s_time_page == NULL) {
+        printk("Clock: can't map the time page.\n");
+    }
+
+    if (!HasInvariantTSC()) {
+        printk("Clock: TSC is not invariant, using the timer clock.\n");
+        UpdateTimePage();
+        return;
+    }
+
+    CalibrateTSC();
+    s_tsc_mult = ((uint64_t)NS_PER_SECOND << CLOCK_SHIFT) / s_tsc_frequency;
+
+    /* Continue from the timer clock, so the clock never goes backwards. */
+    uptime_ns = GetUptimeUS() * NS_PER_US;
+    s_tsc_base = ReadTSC()
+                 - (uptime_ns / NS_PER_SECOND) * s_tsc_frequency
+                 - (uptime_ns % NS_PER_SECOND) * s_tsc_frequency / NS_PER_SECOND;
+    s_use_tsc = true;
+
+    UpdateTimePage();
+
+    printk("Clock: TSC %uMHz.\n", s_tsc_frequency / 1000000);
+}
+
+uint64_t ktime_ns(void)
+{
+    if (!s_use_tsc) {
+        return GetUptimeUS() * NS_PER_US;
+    }
+
+    /* The same formula as user programs use with the time page, the 128-bit
+     * product doesn't overflow. */
+    return ((unsigned __int128)(ReadTSC() - s_tsc_base) * s_tsc_mult)
+           >> CLOCK_SHIFT;
+}
+
+int ClockGetTime(int clock_id, TimeSpec *ts)
+{
+    uint64_t now = 0;
+
+    if (clock_id != CLOCK_MONOTONIC) {
+        return -EINVAL;
+    }
+
+    now = ktime_ns();
+    ts->tv_sec = now / NS_PER_SECOND;
+    ts->tv_nsec = now % NS_PER_SECOND;
+
+    return 0;
+}
+
+int NanoSleep(const TimeSpec *req, TimeSpec *rem)
+{
+    uint64_t us = 0;
+    uint64_t seconds = 0;
+
+    if (req->tv_sec < 0 || req->tv_nsec < 0 || req->tv_nsec >= NS_PER_SECOND) {
+        return -EINVAL;
+    }
+
+    seconds = (uint64_t)req->tv_sec;
+    if (seconds > SLEEP_MAXIMUM_SECONDS) {
+        seconds = SLEEP_MAXIMUM_SECONDS;
+    }
+
+    /* Round up, we sleep at least the requested time. */
+    us = seconds * (NS_PER_SECOND / NS_PER_US)
+         + (req->tv_nsec + NS_PER_US - 1) / NS_PER_US;
+    if (us > 0) {
+        TimerSleep(us);
+    }
+
+    if (rem != NULL) {
+        rem->tv_sec = 0;
+        rem->tv_nsec = 0;
+    }
+
+    return 0;
+}
+
+/* Private function ----------------------------------------------------------*/
+static bool HasInvariantTSC(void)
+{
+    uint32_t regs[4] = {0};
+
+    CPUID(CPUID_EXTENDED_MAXIMUM_LEAF, 0, regs);
+    if (regs[0] < CPUID_ADVANCED_POWER_LEAF) {
+        return false;
+    }
+
+    CPUID(CPUID_ADVANCED_POWER_LEAF, 0, regs);
+
+    return (regs[3] & CPUID_80000007_EDX_INVARIANT_TSC) != 0;
+}
+
+static void CalibrateTSC(void)
+{
+    uint64_t start = 0;
+
+    PITCalibrationPrepare();
+
+    PITCalibrationStart();
+    start = ReadTSC();
+
+    PITCalibrationWait();
+
+    s_tsc_frequency = (ReadTSC() - start) * (1000 / PIT_CALIBRATION_MS);
+}
+
+static void UpdateTimePage(void)
+{
+    if (s_time_page == NULL) {
+        return;
+    }
+
+    /* Odd sequence, readers retry until we finish. Stores are not reordered
+     * with other stores on x86, so only the compiler has to be stopped. */
+    s_time_page->sequence++;
+    __asm__ __volatile__("" ::: "memory");
+
+    s_time_page->clock_mode = s_use_tsc ? VDSO_CLOCK_TSC : VDSO_CLOCK_NONE;
+    s_time_page->base_cycles = s_tsc_base;
+    s_time_page->base_ns = 0;
+    s_time_page->mult = s_tsc_mult;
+    s_time_page->shift = CLOCK_SHIFT;
+    s_time_page->tick_ns = (uint64_t)TIMER_TICK_US * NS_PER_US;
+
+    __asm__ __volatile__("" ::: "memory");
+    s_time_page->sequence++;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file    clock.h
+ * @author  Cong Nguyen (congnt264@gmail.com)
+ * @brief   Monotonic clock in nanoseconds. The clock reads the TSC, it costs a
+ *          few cycles and has the resolution of the CPU clock. The TSC is only
+ *          used if it is invariant (CPUID.80000007H:EDX[8]), which means it
+ *          runs at a constant rate in all P-states and C-states. Its frequency
+ *          is calibrated against the PIT at boot.
+ *
+ *          Without an invariant TSC, the clock falls back to the uptime of the
+ *          timer code, in microseconds.
+ *
+ *          The clock parameters are also published in the time page (vdso.h),
+ *          user programs read the clock from it without a system call.
+ *
+ * @version 0.1
+ * @date 2023-09-21
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Public define -------------------------------------------------------------*/
+#define CLOCK_MONOTONIC             1
+#define NS_PER_SECOND               1000000000
+#define NS_PER_US                   1000
+
+/* Public type ---------------------------------------------------------------*/
+/**
+ * @brief   Time value, it has the layout of the user `struct timespec`.
+ *
+ * @property tv_sec     - Seconds.
+ * @property tv_nsec    - Nanoseconds, from 0 to 999999999.
+ */
+typedef struct {
+    int64_t tv_sec;
+    int64_t tv_nsec;
+} TimeSpec;
+
+/* Public function prototype -------------------------------------------------*/
+/**
+ * @brief       Detect and calibrate the TSC, this function should be called
+ *              after InitTimer().
+ */
+void InitClock(void);
+
+/**
+ * @brief       Get time since boot in nanoseconds.
+ */
+uint64_t ktime_ns(void);
+
+/**
+ * @brief       Get time of a clock.
+ *
+ * @param[in]   clock_id    - Clock, only CLOCK_MONOTONIC is supported.
+ * @param[out]  ts          - Time.
+ * @return      int         - 0 on success.
+ *                          - -EINVAL if the clock is not supported.
+ */
+int ClockGetTime(int clock_id, TimeSpec *ts);
+
+/**
+ * @brief       Put current process to sleep for at least the requested time.
+ *
+ * @param[in]   req         - Requested time.
+ * @param[out]  rem         - Remaining time, it is always 0 because nothing
+ *                            interrupts the sleep, it can be NULL.
+ * @return      int         - 0 on success.
+ *                          - -EINVAL if the requested time is invalid.
+ */
+int NanoSleep(const TimeSpec *req, TimeSpec *rem);
@@ -0,0 +1,150 @@
+#include <stddef.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+
+#include "dentry.h"
+#include "slab.h"
+#include "assert.h"
+
+/* Private type --------------------------------------------------------------*/
+/**
+ * @brief   Dentry structure.
+ *
+ * @property next       - Next dentry in the hash bucket.
+ * @property name       - Case folded file name.
+ * @property index      - Index of the entry in the root directory.
+ * @property entry      - Copy of the directory entry.
+ */
+typedef struct Dentry {
+    struct Dentry *next;
+    char name[DENTRY_NAME_SIZE];
+    int index;
+    DirEntry entry;
+} Dentry;
+
+/* Private variable ----------------------------------------------------------*/
+static SlabCache s_dentry_cache;
+static Dentry *s_dentry_hash[DENTRY_HASH_BUCKETS];
+
+/* Private function prototypes -----------------------------------------------*/
+/**
+ * @brief   Fold a name to lower case.
+ *
+ * @return  true if the name fits a 8.3 name.
+ */
+static bool FoldName(const char *name, char *folded);
+
+/**
+ * @brief   Get the bucket of a folded name, FNV-1a hash.
+ */
+static Dentry **GetBucket(const char *folded);
+
+/* Public function -----------------------------------------------------------*/
+void InitDentryCache(void)
+{
+    InitSlabCache(&s_dentry_cache, sizeof(Dentry));
+}
+
+int DentryInsert(const char *name, int index, const DirEntry *entry)
+{
+    char folded[DENTRY_NAME_SIZE];
+    Dentry *dentry = NULL;
+
+    if (!FoldName(name, folded)) {
+        return -ENAMETOOLONG;
+    }
+
+    Dentry **bucket = GetBucket(folded);
+
+    /* The first entry of a name is the one a directory scan finds. */
+    for (dentry = *bucket; dentry != NULL; dentry = dentry->next) {
+        if (strncmp(dentry->name, folded, DENTRY_NAME_SIZE) == 0) {
+            return -EEXIST;
+        }
+    }
+
+    dentry = SlabAlloc(&s_dentry_cache);
+    if (dentry == NULL) {
+        return -ENOMEM;
+    }
+
+    memcpy(dentry->name, folded, DENTRY_NAME_SIZE);
+    dentry->index = index;
+    memcpy(&dentry->entry, entry, sizeof(DirEntry));
+    dentry->next = *bucket;
+    *bucket = dentry;
+
+    return 0;
+}
+
+void DentryRemove(const char *name)
+{
+    char folded[DENTRY_NAME_SIZE];
+    Dentry **link = NULL;
+
+    if (!FoldName(name, folded)) {
+        return;
+    }
+
+    for (link = GetBucket(folded); *link != NULL; link = &(*link)->next) {
+        if (strncmp((*link)->name, folded, DENTRY_NAME_SIZE) == 0) {
+            Dentry *dentry = *link;
+
+            *link = dentry->next;
+            SlabFree(&s_dentry_cache, dentry);
+            return;
+        }
+    }
+}
+
+int DentryLookup(const char *name, DirEntry *entry)
+{
+    char folded[DENTRY_NAME_SIZE];
+
+    /* A longer name can't be on a FAT16 disk. */
+    if (!FoldName(name, folded)) {
+        return -ENOENT;
+    }
+
+    for (Dentry *dentry = *GetBucket(folded);
+         dentry != NULL;
+         dentry = dentry->next) {
+        if (strncmp(dentry->name, folded, DENTRY_NAME_SIZE) == 0) {
+            memcpy(entry, &dentry->entry, sizeof(DirEntry));
+            return dentry->index;
+        }
+    }
+
+    return -ENOENT;
+}
+
+/* Private function ----------------------------------------------------------*/
+static bool FoldName(const char *name, char *folded)
+{
+    int i = 0;
+
+    for (; name[i] != '\0'; i++) {
+        if (i >= DENTRY_NAME_SIZE - 1) {
+            return false;
+        }
+
+        folded[i] = tolower(name[i]);
+    }
+
+    folded[i] = '\0';
+
+    return true;
+}
+
+static Dentry **GetBucket(const char *folded)
+{
+    uint32_t hash = 2166136261u;
+
+    for (; *folded != '\0'; folded++) {
+        hash ^= (uint8_t)*folded;
+        hash *= 16777619u;
+    }
+
+    return &s_dentry_hash[hash % DENTRY_HASH_BUCKETS];
+}
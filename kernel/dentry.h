@@ -0,0 +1,65 @@
+/**
+ * @file    dentry.h
+ * @author  Cong Nguyen (congnt264@gmail.com)
+ * @brief   The dentry index maps file names to their root directory entries,
+ *          so opening a file is a hash lookup instead of a scan of the whole
+ *          root directory, and it never touches the disk.
+ *
+ *          The index is built from the root directory when the file system is
+ *          mounted and it holds every file, so a name which is not in the index
+ *          doesn't exist: every miss is a negative lookup. Code which creates
+ *          or deletes a directory entry must insert or remove its dentry too.
+ *
+ *          Names are the 8.3 names of FAT16 ("NAME.EXT"), compared without
+ *          case.
+ *
+ * @version 0.1
+ * @date 2023-09-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+#include <stdint.h>
+#include "file.h"
+
+/* Public define -------------------------------------------------------------*/
+#define DENTRY_NAME_SIZE            13  /* 8 + dot + 3 + terminator.         */
+#define DENTRY_HASH_BUCKETS         64
+
+/* Public function prototype -------------------------------------------------*/
+/**
+ * @brief       Initialize an empty index.
+ */
+void InitDentryCache(void);
+
+/**
+ * @brief       Add a directory entry to the index, an existing dentry of the
+ *              same name is kept.
+ *
+ * @param[in]   name        - File name.
+ * @param[in]   index       - Index of the entry in the root directory.
+ * @param[in]   entry       - Directory entry.
+ * @return      int         - 0 on success.
+ *                          - -ENAMETOOLONG if the name is not a 8.3 name.
+ *                          - -EEXIST if the name is indexed already.
+ *                          - -ENOMEM if there is no memory.
+ */
+int DentryInsert(const char *name, int index, const DirEntry *entry);
+
+/**
+ * @brief       Remove the dentry of a name, after its entry is deleted.
+ *
+ * @param[in]   name        - File name.
+ */
+void DentryRemove(const char *name);
+
+/**
+ * @brief       Find the directory entry of a name.
+ *
+ * @param[in]   name        - File name.
+ * @param[out]  entry       - Directory entry.
+ * @return      int         - Index of the entry in the root directory.
+ *                          - -ENOENT if the file doesn't exist.
+ */
+int DentryLookup(const char *name, DirEntry *entry);
@@ -1,43 +1,176 @@
+#include <stdbool.h>
+
 #include "disk.h"
+#include "io.h"
+#include "wait.h"
+#include "preempt.h"
+
+/* Private define ------------------------------------------------------------*/
+#define DISK_READ_SECTORS_COMMAND   0x20
+#define DISK_WRITE_SECTORS_COMMAND  0x30
+#define DISK_CACHE_FLUSH_COMMAND    0xE7
+
+#define DISK_STATUS_BUSY            0x80
+#define DISK_STATUS_DATA_REQUEST    0x08
+
+/* Private variable ----------------------------------------------------------*/
+/* A transfer can be preempted between sectors, so another process must not
+ * send a command to the controller until the transfer is done. */
+static bool s_disk_busy;
+static WaitQueue s_disk_wait_queue;
+
+/* Private function prototypes -----------------------------------------------*/
+/**
+ * @brief   Take the controller, sleep until the running transfer is done.
+ */
+static void DiskLock(void);
+
+/**
+ * @brief   Give the controller to the next waiting process.
+ */
+static void DiskUnlock(void);
+
+/**
+ * @brief   Send a command with a LBA range to the controller.
+ */
+static void DiskCommand(int lba, int sectors, uint8_t command);
+
+/**
+ * @brief   Wait until the sector buffer of the controller requires servicing.
+ */
+static void DiskWaitDataRequest(void);
 
 /* Public function -----------------------------------------------------------*/
 int DiskReadSectors(int lba, int sectors, void *buf)
 {
-    OutByte(0x1F6, (lba >> 24) | 0b11100000);    /* Port to send drive and bit
-                                                  * 24 - 27 of LBA. */
-    OutByte(0x1F2, sectors);                     /* Port to send number of
-                                                  * sectors. */
-    OutByte(0x1F3, (uint8_t)(lba & 0b11111111)); /* Port to send bit 0 - 7 of
-                                                  * LBA. */
-    OutByte(0x1F4, (uint8_t)(lba >> 8));         /* Port to send bit 8 - 15 of 
-                                                  * LBA. */
-    OutByte(0x1F5, (uint8_t)(lba >> 16));        /* Port to send bit 16 - 23 of
-                                                  * LBA. */
-    OutByte(0x1F7, 0x20);                        /* Command port, read with
-                                                  * retry. */
-                                                 /* 0x20 - READ SECTORS(S) */
-                                                 /* 0x30 - WRITE SECTORS(S) */
+    DiskLock();
+
+    DiskCommand(lba, sectors, DISK_READ_SECTORS_COMMAND);
 
     /* We are going to read two bytes at a time from the disk controller. */
     uint16_t *ptr = (uint16_t *)buf;
 
     for (int s = 0; s < sectors; s++)
     {
-        /* The sector buffer requires servicing until the sector buffer is
-         * ready. */
-        int8_t byte = InByte(0x1F7);
-        while (!(byte & 0x08))
+        DiskWaitDataRequest();
+
+        /* Copy from hard disk to memory, to read 256 words = 1 sector. */
+        for (int i = 0; i < 256; i++)
         {
-            byte = InByte(0x1F7);
+            *ptr = InWord(0x1F0); /* Data port. */
+            ptr++;
         }
 
-        /* Copy from hard disk to memory, to read 256 words = 1 sector. */
+        /* Let other processes run between sectors. */
+        PreemptionPoint();
+    }
+
+    DiskUnlock();
+
+    return 0;
+}
+
+int DiskReadSectorsScatter(int lba, int sectors, void *const *bufs)
+{
+    DiskLock();
+
+    DiskCommand(lba, sectors, DISK_READ_SECTORS_COMMAND);
+
+    for (int s = 0; s < sectors; s++)
+    {
+        uint16_t *ptr = (uint16_t *)bufs[s];
+
+        DiskWaitDataRequest();
+
         for (int i = 0; i < 256; i++)
         {
             *ptr = InWord(0x1F0); /* Data port. */
             ptr++;
         }
+
+        PreemptionPoint();
+    }
+
+    DiskUnlock();
+
+    return 0;
+}
+
+int DiskWriteSectors(int lba, int sectors, const void *buf)
+{
+    DiskLock();
+
+    DiskCommand(lba, sectors, DISK_WRITE_SECTORS_COMMAND);
+
+    const uint16_t *ptr = (const uint16_t *)buf;
+
+    for (int s = 0; s < sectors; s++)
+    {
+        DiskWaitDataRequest();
+
+        /* Copy from memory to hard disk, to write 256 words = 1 sector. */
+        for (int i = 0; i < 256; i++)
+        {
+            OutWord(0x1F0, *ptr); /* Data port. */
+            ptr++;
+        }
+
+        PreemptionPoint();
+    }
+
+    /* The drive may keep the data in its write cache, flush it so the data is
+     * on the disk when we return. */
+    OutByte(0x1F7, DISK_CACHE_FLUSH_COMMAND);
+    while (InByte(0x1F7) & DISK_STATUS_BUSY)
+    {
     }
 
+    DiskUnlock();
+
     return 0;
 }
+
+/* Private function ----------------------------------------------------------*/
+static void DiskLock(void)
+{
+    while (s_disk_busy)
+    {
+        Sleep(&s_disk_wait_queue);
+    }
+
+    s_disk_busy = true;
+}
+
+static void DiskUnlock(void)
+{
+    s_disk_busy = false;
+    WakeupOne(&s_disk_wait_queue);
+}
+
+static void DiskCommand(int lba, int sectors, uint8_t command)
+{
+    OutByte(0x1F6, (lba >> 24) | 0b11100000);    /* Port to send drive and bit
+                                                  * 24 - 27 of LBA. */
+    OutByte(0x1F2, sectors);                     /* Port to send number of
+                                                  * sectors. */
+    OutByte(0x1F3, (uint8_t)(lba & 0b11111111)); /* Port to send bit 0 - 7 of
+                                                  * LBA. */
+    OutByte(0x1F4, (uint8_t)(lba >> 8));         /* Port to send bit 8 - 15 of 
+                                                  * LBA. */
+    OutByte(0x1F5, (uint8_t)(lba >> 16));        /* Port to send bit 16 - 23 of
+                                                  * LBA. */
+    OutByte(0x1F7, command);                     /* Command port. */
+                                                 /* 0x20 - READ SECTORS(S) */
+                                                 /* 0x30 - WRITE SECTORS(S) */
+}
+
+static void DiskWaitDataRequest(void)
+{
+    /* The sector buffer requires servicing until the sector buffer is
+     * ready. */
+    int8_t byte = InByte(0x1F7);
+    while (!(byte & DISK_STATUS_DATA_REQUEST))
+    {
+        byte = InByte(0x1F7);
+    }
+}
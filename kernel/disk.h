@@ -31,6 +31,9 @@
 /* Public define -------------------------------------------------------------*/
 #define SECTOR_SIZE     512
 
+/* The sector count register has 8 bits, 0 means 256 sectors. */
+#define DISK_MAXIMUM_SECTORS_PER_COMMAND    256
+
 /* Public type ---------------------------------------------------------------*/
 
 /* Public function prototype -------------------------------------------------*/
@@ -46,3 +49,25 @@
  * @return int          - Zero if success.
  */
 int DiskReadSectors(int lba, int sectors, void *buf);
+
+/**
+ * @brief       Read consecutive sectors with one command, each sector goes to
+ *              its own buffer.
+ *
+ * @param[in] lba       - Sector number.
+ * @param[in] sectors   - Number of sectors to read.
+ * @param[out] bufs     - Buffer of each sector.
+ * @return int          - Zero if success.
+ */
+int DiskReadSectorsScatter(int lba, int sectors, void *const *bufs);
+
+/**
+ * @brief       Write number of sectors from memory to hard disk, the data is on
+ *              the disk when the function returns.
+ *
+ * @param[in] lba       - Sector number.
+ * @param[in] sectors   - Number of sectors to write.
+ * @param[in] buf       - Buffer data.
+ * @return int          - Zero if success.
+ */
+int DiskWriteSectors(int lba, int sectors, const void *buf);
@@ -5,28 +5,116 @@
 
 #include "file.h"
 #include "disk.h"
+#include "bcache.h"
+#include "dentry.h"
 #include "assert.h"
 #include "memory.h"
 #include "printk.h"
+#include "slab.h"
+#include "workqueue.h"
 
 /* Private define ------------------------------------------------------------*/
 #define ENTRY_EMPTY         0
 #define ENTRY_DELETED       0xE5
 #define START_CLUSTER_INDEX 2
 
+/* FAT16 entries from this value are bad clusters and end of chain marks. */
+#define FAT16_BAD_CLUSTER   0xFFF7
+
+/* Readahead window in sectors, and the number of readahead requests which can
+ * be in flight at the same time. */
+#define READAHEAD_MINIMUM_WINDOW    8
+#define READAHEAD_MAXIMUM_WINDOW    128
+#define READAHEAD_REQUESTS          8
+
+/* Private type --------------------------------------------------------------*/
+/**
+ * @brief   Readahead request, a run of consecutive sectors a worker brings
+ *          into the buffer cache.
+ *
+ * @property work       - Work item.
+ * @property sector     - First sector.
+ * @property count      - Number of sectors.
+ */
+typedef struct {
+    Work work;
+    uint32_t sector;
+    uint32_t count;
+} ReadaheadRequest;
+
 /* Private variable ----------------------------------------------------------*/
 static BPB s_BIOS_parameter_block = {0};
 static FCB *s_fcb_table = NULL;
 static FD *s_fd_table = NULL;
 
+/* The first FAT copy, read at mount. The file system is never written, so the
+ * copy is always up to date. */
+static uint16_t *s_fat = NULL;
+static uint32_t s_fat_entries = 0;
+
+static SlabCache s_extent_cache;
+
+/* Requests live here, not in the FD, the FD can be closed and reused while the
+ * request is queued. */
+static ReadaheadRequest s_readahead_requests[READAHEAD_REQUESTS];
+
 /* Private function prototype ------------------------------------------------*/
 BPB *GetBPB(void);
 
-int FindFileInRootDir(const char *filename, DirEntry* entry);
+/**
+ * @brief   Add every file of the root directory to the dentry index.
+ *
+ * @return  0 on success, -ENOMEM if there is no memory.
+ */
+static int IndexRootDirectory(void);
 
-static void GetRelativeFileName(DirEntry* entry, char *buf);
+/**
+ * @brief   Read the first FAT to memory.
+ */
+static void LoadFAT(void);
+
+/**
+ * @brief   Follow the FAT chain of a file and build its extents.
+ *
+ * @return  0 on success, -EIO if the chain is broken, -ENOMEM if there is no
+ *          memory.
+ */
+static int BuildExtentMap(FCB *fcb);
+
+/**
+ * @brief   Free the extents of a file.
+ */
+static void FreeExtentMap(FCB *fcb);
+
+/**
+ * @brief   Find the disk sector of a file sector.
+ *
+ * @param   fcb         - File.
+ * @param   file_sector - Sector index in the file.
+ * @param   sector      - Disk sector.
+ * @return  Number of consecutive sectors on the disk from there, to the end of
+ *          the extent.
+ */
+static uint32_t GetFileRun(FCB *fcb, uint32_t file_sector, uint32_t *sector);
+
+/**
+ * @brief   Drop a reference of the FD and its FCB. The FD entry is free again
+ *          when the last reference is dropped.
+ */
+static void ReleaseFD(FD *file);
+
+/**
+ * @brief   Update the readahead state of the FD after a read, and queue the
+ *          readahead of the next window if the reads are sequential.
+ */
+static void Readahead(FD *file, uint32_t pos, uint32_t size);
+
+/**
+ * @brief   Work function of readahead requests.
+ */
+static void ReadaheadWork(Work *work);
 
-static void ReadFileData(int start_cluster, int length, void *buf);
+static void GetRelativeFileName(DirEntry* entry, char *buf);
 
 /**
  * @brief   We allocate a memory page for FCB table, so the maximum entries of
@@ -87,6 +175,14 @@ static inline int GetBytesPerCluster(void)
     return GetSectorsPerCluster() * GetBytesPerSector();
 }
 
+static inline uint32_t GetClusterStartSector(uint32_t cluster_index)
+{
+    /* Note that cluster start with index 2, so we need subtract to 2. */
+    ASSERT(cluster_index >= START_CLUSTER_INDEX);
+    return (cluster_index - START_CLUSTER_INDEX) * GetSectorsPerCluster()
+           + GetDataRegionStartSector();
+}
+
 static inline int GetNumberOfClustersStoringFileData(int file_size)
 {
     int length = file_size / GetBytesPerCluster();
@@ -104,20 +200,20 @@ static inline int GetSignature(void)
 }
 
 static int
-ReadRawData(uint32_t cluster_index, char *buf, uint32_t pos, uint32_t size);
+ReadRawData(FCB *fcb, char *buf, uint32_t pos, uint32_t size);
 
 /* Public function  ----------------------------------------------------------*/
-void InitFileSystem(void)
+int InitFileSystem(void)
 {
+    int status = 0;
+
     /* 1. Get BIOS parameter block and validate signatures. */
-    BPB *bpb = (BPB *)kalloc();
-    ASSERT(bpb != NULL);
+    Buffer *bpb = BufferRead(0);
 
-    DiskReadSectors(0, 1, bpb);
-    memcpy(GetBPB(), bpb, sizeof(BPB));
+    memcpy(GetBPB(), bpb->data, sizeof(BPB));
 
-    uint8_t boot_signature_1 = (uint8_t)((char *)bpb)[510];
-    uint8_t boot_signature_2 = (uint8_t)((char *)bpb)[511];
+    uint8_t boot_signature_1 = bpb->data[510];
+    uint8_t boot_signature_2 = bpb->data[511];
     uint16_t boot_signature = (((uint16_t)boot_signature_1) << 8)
                                 | boot_signature_2;
 
@@ -127,7 +223,10 @@ void InitFileSystem(void)
     ASSERT(boot_signature == 0x55AA);
     ASSERT(GetSignature() == 0x29);
 
-    kfree(bpb);
+    /* The buffer cache works in sectors of SECTOR_SIZE. */
+    ASSERT(GetBytesPerSector() == SECTOR_SIZE);
+
+    BufferRelease(bpb);
 
     /* 2. Calculate root directory address. */
     printk("FAT16 Root Directory base address: %x\n",
@@ -140,7 +239,25 @@ void InitFileSystem(void)
     InitFileControlBLock();
     InitFileDescriptorTable();
 
+    /* 4. Load the FAT, files are read by following their cluster chains. */
+    InitSlabCache(&s_extent_cache, sizeof(Extent));
+    LoadFAT();
+
+    for (int i = 0; i < READAHEAD_REQUESTS; i++) {
+        InitWork(&s_readahead_requests[i].work, ReadaheadWork);
+    }
+
+    /* 5. Index the root directory, Open() looks files up there. It is the
+          last step, the files indexed before a failure can still be read. */
+    InitDentryCache();
+    status = IndexRootDirectory();
+    if (status < 0) {
+        return status;
+    }
+
     printk("Initialized FAT 16 file system.\n");
+
+    return 0;
 }
 
 int Open(Process* proc, const char *file_name)
@@ -149,9 +266,26 @@ int Open(Process* proc, const char *file_name)
     int file_desc_index = -1;
     int entry_index = 0;
 
-    /* 1. Find a file entry in the process. */
+    /* 1. Find the file in the dentry index, no disk access is needed. And we
+          use the entry index for the file control block index and file
+          descriptor index also. */
+    DirEntry entry = {0};
+    entry_index = DentryLookup(file_name, &entry);
+    if (entry_index < 0) {
+        /* Not found the file on the disk. */
+        return -ENOENT;
+    }
+
+    if (entry.cluster_index < START_CLUSTER_INDEX) {
+        /* Sometime, when the file is just created, we can find it in root
+         * directory, but the data is not wrote to data section yet, so cluster
+         * index maybe is 0. In this case we will send a error to user. */
+        return -EAGAIN;
+    }
+
+    /* 2. Find a file entry in the process. */
     for (int i = USER_START_FD; i < PROCESS_MAXIMUM_FILE_DESCRIPTOR; i++) {
-        if (proc->file[i] == NULL) {
+        if (proc->files->file[i] == NULL) {
             fd = i;
             break;
         }
@@ -162,7 +296,7 @@ int Open(Process* proc, const char *file_name)
         return -EMFILE;
     }
 
-    /* 2. Find the table entry for FD. */
+    /* 3. Find the table entry for FD. */
     for (int i = 0; i < GetMaxEntriesOfFDTable(); i++) {
         if (s_fd_table[i].fcb == NULL) {
             file_desc_index = i;
@@ -175,23 +309,6 @@ int Open(Process* proc, const char *file_name)
         return -ENOMEM;
     }
 
-    /* 3. Find the file on the disk. And we use the entry index for the file
-          control block index and file descriptor index also. */
-    DirEntry entry = {0};
-    entry_index = FindFileInRootDir(file_name, &entry);
-    if (entry_index < 0) {
-        /* Not found the file on the disk. */
-        return -ENOENT;
-    }
-
-    if (entry.cluster_index < START_CLUSTER_INDEX) {
-        /* Sometime, when the file is just created, we can find it in root
-         * directory, but the data is not wrote to data section yet, so cluster
-         * index maybe is 0. In this case we will send a error to user.
-         * TODO: Return a try again error code. */
-        return -EAGAIN;
-    }
-
     /* 4. Update file control block entry. */
     if (s_fcb_table[entry_index].open_count == 0) {
         /* If this file is not opened yet, we setup the entry in FCB table. */
@@ -201,6 +318,11 @@ int Open(Process* proc, const char *file_name)
 
         memcpy(&s_fcb_table[entry_index].name, &entry.name, 8);
         memcpy(&s_fcb_table[entry_index].ext, &entry.ext, 3);
+
+        int status = BuildExtentMap(&s_fcb_table[entry_index]);
+        if (status < 0) {
+            return status;
+        }
     }
 
     s_fcb_table[entry_index].open_count++;
@@ -211,76 +333,70 @@ int Open(Process* proc, const char *file_name)
     s_fd_table[file_desc_index].open_count = 1;
 
     /* 6. Link the process file descriptor to the file descriptor entry. */
-    proc->file[fd] = &s_fd_table[file_desc_index];
+    proc->files->file[fd] = &s_fd_table[file_desc_index];
 
     return fd;
 }
 
 void Close(Process* proc, int fd)
 {
-    if (proc->file[fd] == NULL) {
+    if (proc->files->file[fd] == NULL) {
         return;
     }
 
-    ASSERT (proc->file[fd]->fcb->open_count > 0);
-    proc->file[fd]->fcb->open_count--;
-    proc->file[fd]->open_count--;
-
-    /* We don't clear file control block, because, when the file is opened, the
-     * file data is cached in the table, and then we can easily retrieve th file
-     * info. */
-    if (proc->file[fd]->open_count == 0) {
-        /* If the FD count is zero, mean fd entry is not used, we save it to
-         * NULL. Otherwise, the file descriptor entry is used by others and we
-         * leave the FCB pointer unchanged. */
-        proc->file[fd]->fcb = NULL;
-    }
-
-    proc->file[fd] = NULL;
+    ReleaseFD(proc->files->file[fd]);
+    proc->files->file[fd] = NULL;
 }
 
 int Read(Process* proc, int fd, void *buffer, int size)
 {
     uint32_t read_size;
+    FD *file = proc->files->file[fd];
 
-    if (proc->file[fd] == NULL) {
+    if (file == NULL) {
         return -EBADF;
     }
 
-    uint32_t position = proc->file[fd]->position;
-    uint32_t file_size = proc->file[fd]->fcb->file_size;
+    /* The disk read can be preempted, hold the FD, so a Close of another
+     * thread doesn't free it under us. */
+    file->fcb->open_count++;
+    file->open_count++;
+
+    uint32_t position = file->position;
+    uint32_t file_size = file->fcb->file_size;
 
     if (position + size > file_size) {
         /* Read the rest of file. */
         size = file_size - position;
     }
 
-    read_size = ReadRawData(proc->file[fd]->fcb->start_cluster,
+    /* Take the range before the read, so other processes sharing the FD read
+     * after it. */
+    file->position = position + size;
+
+    read_size = ReadRawData(file->fcb,
                             buffer,
                             position,
                             size);
 
-    proc->file[fd]->position += read_size;
+    Readahead(file, position, read_size);
+
+    ReleaseFD(file);
 
     return read_size;
 }
 
 int GetFileSize(Process *proc, int fd)
 {
-    if (proc->file[fd] == NULL) {
+    if (proc->files->file[fd] == NULL) {
         return -EBADF;
     }
 
-    return proc->file[fd]->fcb->file_size;
+    return proc->files->file[fd]->fcb->file_size;
 }
 
-int Lstat(const char *pathname, DirEntry *statbuf)
+int Lstat(const char *pathname, DirEntry *statbuf, int count)
 {
-
-    DirEntry *sector_data = kalloc();
-    if (sector_data == NULL) {
-        return -ENOMEM;
-    }
     uint16_t number_of_sectors = GetRootDirectorySectorSize();
 
     uint32_t root_entry_start = GetRootDirectoryStartSector();
@@ -289,14 +405,23 @@ int Lstat(const char *pathname, DirEntry *statbuf)
 
     int total_entries = 0;
 
-    for (int i = 0; i < number_of_sectors; i++) {
-        
-        /* Read 1 sector a time. */
-        memset(sector_data, 0, GetBPB()->bytes_per_sector);
+    if (count <= 0) {
+        return 0;
+    }
 
-        DiskReadSectors(root_entry_start + i, 1, sector_data);
+    /* A file name gives the entry of that file, the root directory "." or "/"
+     * gives all entries. */
+    if (strncmp(pathname, ".", 2) != 0 && strncmp(pathname, "/", 2) != 0) {
+        return DentryLookup(pathname, statbuf) < 0 ? -ENOENT : 1;
+    }
 
-        for (int j = 0; j < entries_per_sector; j++) {
+    for (int i = 0; i < number_of_sectors && total_entries < count; i++) {
+
+        /* Read 1 sector a time, from the buffer cache. */
+        Buffer *buf = BufferRead(root_entry_start + i);
+        DirEntry *sector_data = (DirEntry *)buf->data;
+
+        for (int j = 0; j < entries_per_sector && total_entries < count; j++) {
             if (sector_data[j].name[0] == ENTRY_EMPTY 
                 || sector_data[j].name[0] == ENTRY_DELETED) {
                 continue;
@@ -311,9 +436,10 @@ int Lstat(const char *pathname, DirEntry *statbuf)
             total_entries++;
 
         }
+
+        BufferRelease(buf);
     }
 
-    kfree(sector_data);
     return total_entries;
 }
 
@@ -324,23 +450,18 @@ BPB *GetBPB(void)
     return &s_BIOS_parameter_block;
 }
 
-int FindFileInRootDir(const char *filename, DirEntry* entry)
+static int IndexRootDirectory(void)
 {
-    int status = -ENOENT;
-
-    DirEntry *sector_data= kalloc();
-
     uint16_t number_of_sectors = GetRootDirectorySectorSize();
 
     uint32_t root_entry_start = GetRootDirectoryStartSector();
 
     uint16_t entries_per_sector = GetBPB()->bytes_per_sector / sizeof(DirEntry);
     for (int i = 0; i < number_of_sectors; i++) {
-        
-        /* Read 1 sector a time. */
-        memset(sector_data, 0, GetBPB()->bytes_per_sector);
 
-        DiskReadSectors(root_entry_start + i, 1, sector_data);
+        /* Read 1 sector a time, from the buffer cache. */
+        Buffer *buf = BufferRead(root_entry_start + i);
+        DirEntry *sector_data = (DirEntry *)buf->data;
 
         for (int j = 0; j < entries_per_sector; j++) {
             if (sector_data[j].name[0] == ENTRY_EMPTY 
@@ -353,21 +474,24 @@ int FindFileInRootDir(const char *filename, DirEntry* entry)
                 continue;
             }
 
-            char tmp_filename[13] = {0};
+            char tmp_filename[DENTRY_NAME_SIZE] = {0};
             GetRelativeFileName(&sector_data[j], tmp_filename);
 
-            if (strcasecmp(filename, tmp_filename) == 0) {
-                /* Found the file. */
-                memcpy(entry, &sector_data[j], sizeof(DirEntry));
-                status = i * entries_per_sector + j;
-                goto exit;
+            int status = DentryInsert(tmp_filename,
+                                      i * entries_per_sector + j,
+                                      &sector_data[j]);
+
+            /* A duplicate name keeps its first entry. */
+            if (status < 0 && status != -EEXIST) {
+                BufferRelease(buf);
+                return status;
             }
         }
+
+        BufferRelease(buf);
     }
 
-exit:
-    kfree(sector_data);
-    return status;
+    return 0;
 }
 
 static void GetRelativeFileName(DirEntry* entry, char *buf)
@@ -408,22 +532,6 @@ static void GetRelativeFileName(DirEntry* entry, char *buf)
     *buf = '\0';
 }
 
-static void ReadFileData(int start_cluster, int length, void *buf)
-{
-    /* Note that cluster start with index 2, so we need subtract to 2. */
-    ASSERT(start_cluster >= START_CLUSTER_INDEX);
-    uint32_t file_data_start_sector = (start_cluster - START_CLUSTER_INDEX)
-                                      * GetSectorsPerCluster()
-                                      + GetDataRegionStartSector();
-
-    uint16_t number_of_sector_need_to_read = length
-                                             * GetSectorsPerCluster();
-
-    DiskReadSectors(file_data_start_sector,
-                    number_of_sector_need_to_read,
-                    buf);
-}
-
 void InitFileControlBLock(void)
 {
     s_fcb_table = (FCB *)kalloc();
@@ -440,26 +548,259 @@ void InitFileDescriptorTable(void)
     memset(s_fd_table, 0, PAGE_SIZE);
 }
 
-static int
-ReadRawData(uint32_t cluster_index, char *buf, uint32_t pos, uint32_t size)
+static void LoadFAT(void)
+{
+    uint32_t fat_start = GetBPB()->reserved_sectors;
+    uint32_t fat_sectors = GetBPB()->sectors_per_fat;
+
+    ASSERT(fat_sectors * SECTOR_SIZE <= PAGE_SIZE);
+
+    s_fat = (uint16_t *)kalloc();
+    ASSERT(s_fat != NULL);
+
+    for (uint32_t i = 0;
+         i < fat_sectors;
+         i += DISK_MAXIMUM_SECTORS_PER_COMMAND) {
+        uint32_t count = fat_sectors - i;
+
+        if (count > DISK_MAXIMUM_SECTORS_PER_COMMAND) {
+            count = DISK_MAXIMUM_SECTORS_PER_COMMAND;
+        }
+
+        DiskReadSectors(fat_start + i, count, (char *)s_fat + i * SECTOR_SIZE);
+    }
+
+    s_fat_entries = fat_sectors * SECTOR_SIZE / sizeof(uint16_t);
+}
+
+static int BuildExtentMap(FCB *fcb)
+{
+    uint32_t clusters = GetNumberOfClustersStoringFileData(fcb->file_size);
+    uint32_t cluster = fcb->start_cluster;
+    Extent **tail = NULL;
+
+    FreeExtentMap(fcb);
+    tail = &fcb->extents;
+
+    /* The chain is followed for the clusters of the file size only, so a
+     * looping chain can't keep us here. */
+    for (uint32_t file_cluster = 0; file_cluster < clusters;) {
+        if (cluster < START_CLUSTER_INDEX
+            || cluster >= FAT16_BAD_CLUSTER
+            || cluster >= s_fat_entries) {
+            FreeExtentMap(fcb);
+            return -EIO;
+        }
+
+        Extent *extent = SlabAlloc(&s_extent_cache);
+        if (extent == NULL) {
+            FreeExtentMap(fcb);
+            return -ENOMEM;
+        }
+
+        extent->next = NULL;
+        extent->file_cluster = file_cluster;
+        extent->cluster = cluster;
+        extent->count = 0;
+
+        *tail = extent;
+        tail = &extent->next;
+
+        /* Grow the extent while the next cluster follows on the disk. A
+         * corrupt chain may point past the FAT we loaded. */
+        do {
+            if (cluster >= s_fat_entries) {
+                FreeExtentMap(fcb);
+                return -EIO;
+            }
+
+            extent->count++;
+            file_cluster++;
+            cluster = s_fat[cluster];
+        } while (file_cluster < clusters
+                 && cluster == extent->cluster + extent->count);
+    }
+
+    return 0;
+}
+
+static void FreeExtentMap(FCB *fcb)
 {
-    uint16_t number_of_clusters_need_to_read
-        = GetNumberOfClustersStoringFileData(size);
+    while (fcb->extents != NULL) {
+        Extent *extent = fcb->extents;
+
+        fcb->extents = extent->next;
+        SlabFree(&s_extent_cache, extent);
+    }
+}
+
+static uint32_t GetFileRun(FCB *fcb, uint32_t file_sector, uint32_t *sector)
+{
+    uint32_t sectors_per_cluster = GetSectorsPerCluster();
+    uint32_t file_cluster = file_sector / sectors_per_cluster;
+    Extent *extent = fcb->extents;
+
+    while (extent != NULL
+           && file_cluster >= extent->file_cluster + extent->count) {
+        extent = extent->next;
+    }
+
+    ASSERT(extent != NULL && file_cluster >= extent->file_cluster);
+
+    *sector = GetClusterStartSector(extent->cluster)
+              + file_sector
+              - extent->file_cluster * sectors_per_cluster;
+
+    return (extent->file_cluster + extent->count) * sectors_per_cluster
+           - file_sector;
+}
 
-    uint16_t start_cluster_need_to_read = cluster_index
-                                          + pos / GetBytesPerCluster();
+static int
+ReadRawData(FCB *fcb, char *buf, uint32_t pos, uint32_t size)
+{
+    uint32_t done = 0;
+
+    while (done < size) {
+        uint32_t file_sector = (pos + done) / SECTOR_SIZE;
+        uint32_t offset = (pos + done) % SECTOR_SIZE;
+        uint32_t whole_sectors = (size - done) / SECTOR_SIZE;
+        uint32_t sector = 0;
+        uint32_t run = GetFileRun(fcb, file_sector, &sector);
+
+        if (offset == 0 && whole_sectors > 0) {
+            if (!BufferIsCached(sector)) {
+                /* Whole sectors which are not cached are read straight to the
+                 * caller's buffer, without a copy. The user memory is one
+                 * page which is never paged out, so it stays in place, and
+                 * the transfer runs in the caller's address space, even if it
+                 * is preempted. */
+                uint32_t count = 1;
+                uint32_t limit = run < whole_sectors ? run : whole_sectors;
+
+                if (limit > DISK_MAXIMUM_SECTORS_PER_COMMAND) {
+                    limit = DISK_MAXIMUM_SECTORS_PER_COMMAND;
+                }
+
+                while (count < limit && !BufferIsCached(sector + count)) {
+                    count++;
+                }
+
+                BufferReadDirect(sector, count, &buf[done]);
+                done += count * SECTOR_SIZE;
+            } else {
+                /* A cached sector, maybe dirty, the cache has the data. */
+                Buffer *buffer = BufferRead(sector);
+                memcpy(&buf[done], buffer->data, SECTOR_SIZE);
+                BufferRelease(buffer);
+                done += SECTOR_SIZE;
+            }
 
-    uint16_t start_pos_in_cluster = pos % GetBytesPerCluster();
+            continue;
+        }
 
-    char *buffer = (char *)kalloc();
+        /* The unaligned head and tail pieces go through the cache. */
+        uint32_t length = SECTOR_SIZE - offset;
 
-    ReadFileData(start_cluster_need_to_read,
-                 number_of_clusters_need_to_read,
-                 buffer);
+        if (length > size - done) {
+            length = size - done;
+        }
 
-    memcpy(buf, &buffer[start_pos_in_cluster], size);
+        Buffer *buffer = BufferRead(sector);
+        memcpy(&buf[done], &buffer->data[offset], length);
+        BufferRelease(buffer);
 
-    kfree(buffer);
+        done += length;
+    }
 
     return size;
+}
+
+static void ReleaseFD(FD *file)
+{
+    ASSERT(file->fcb->open_count > 0);
+    file->fcb->open_count--;
+    file->open_count--;
+
+    /* We don't clear file control block, because, when the file is opened, the
+     * file data is cached in the table, and then we can easily retrieve th file
+     * info. */
+    if (file->open_count == 0) {
+        /* If the FD count is zero, mean fd entry is not used, we save it to
+         * NULL. Otherwise, the file descriptor entry is used by others and we
+         * leave the FCB pointer unchanged. */
+        file->fcb = NULL;
+    }
+}
+
+static void Readahead(FD *file, uint32_t pos, uint32_t size)
+{
+    uint32_t file_sectors = 0;
+    uint32_t read_end = (pos + size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+    uint32_t start = 0;
+    uint32_t end = 0;
+
+    file_sectors = (file->fcb->file_size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+
+    if (pos != file->ra_next) {
+        /* Random read, back off, and forget the window we read ahead. */
+        file->ra_window /= 2;
+        file->ra_end = 0;
+        file->ra_next = pos + size;
+        return;
+    }
+
+    file->ra_next = pos + size;
+
+    /* Sequential read, the window grows. */
+    if (file->ra_window < READAHEAD_MINIMUM_WINDOW) {
+        file->ra_window = READAHEAD_MINIMUM_WINDOW;
+    } else if (file->ra_window < READAHEAD_MAXIMUM_WINDOW) {
+        file->ra_window *= 2;
+    }
+
+    /* Only the part of the window which was not issued yet. */
+    start = file->ra_end > read_end ? file->ra_end : read_end;
+    end = read_end + file->ra_window;
+    if (end > file_sectors) {
+        end = file_sectors;
+    }
+
+    while (start < end) {
+        ReadaheadRequest *request = NULL;
+
+        for (int i = 0; i < READAHEAD_REQUESTS; i++) {
+            Work *work = &s_readahead_requests[i].work;
+
+            if (!work->pending && !work->running) {
+                request = &s_readahead_requests[i];
+                break;
+            }
+        }
+
+        /* All requests are in flight, the rest is read ahead later. */
+        if (request == NULL) {
+            break;
+        }
+
+        request->count = GetFileRun(file->fcb, start, &request->sector);
+        if (request->count > end - start) {
+            request->count = end - start;
+        }
+
+        if (request->count > BCACHE_MAXIMUM_PREFETCH) {
+            request->count = BCACHE_MAXIMUM_PREFETCH;
+        }
+
+        QueueWork(&request->work);
+        start += request->count;
+    }
+
+    file->ra_end = start;
+}
+
+static void ReadaheadWork(Work *work)
+{
+    ReadaheadRequest *request = (ReadaheadRequest *)work;
+
+    BufferReadahead(request->sector, request->count);
 }
\ No newline at end of file
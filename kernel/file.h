@@ -63,9 +63,25 @@ typedef struct {
     uint32_t file_size;
 } __attribute__ ((packed)) DirEntry;
 
+/**
+ * @brief   Extent, a run of consecutive clusters of a file.
+ *
+ * @property next           - Next extent, in file order.
+ * @property file_cluster   - Index of the first cluster in the file.
+ * @property cluster        - First cluster on the disk.
+ * @property count          - Number of clusters.
+ */
+typedef struct Extent {
+    struct Extent *next;
+    uint32_t file_cluster;
+    uint32_t cluster;
+    uint32_t count;
+} Extent;
+
 /**
  * @brief   File control block structure.
- * 
+ * @property    extents     - Cluster runs of the file, built from the FAT
+ *                            chain when the file is opened.
  */
 typedef struct {
     char name[8];
@@ -74,6 +90,7 @@ typedef struct {
     uint32_t dir_entry;
     uint32_t file_size;
     int open_count;
+    Extent *extents;
 } FCB;
 
 /**
@@ -83,21 +100,38 @@ typedef struct {
  *                            these two structures.
  * @property    position    - Indicates where the last time the process reads or
  *                            writes in the file.
+ * @property    ra_next     - Position where a sequential read continues.
+ * @property    ra_window   - Readahead window in sectors, it grows on
+ *                            sequential reads and shrinks on random reads.
+ * @property    ra_end      - File sector where the issued readahead ends.
  */
 struct FD {
     FCB *fcb;
     uint32_t position;
     int open_count;
+    uint32_t ra_next;
+    uint32_t ra_window;
+    uint32_t ra_end;
 };
 
 typedef struct FD FD;
 
 /* Public function prototype -------------------------------------------------*/
-void InitFileSystem(void);
+int InitFileSystem(void);
 
 int Open(Process* proc, const char *file_name);
 void Close(Process* proc, int fd);
 int Read(Process* proc, int fd, void *buffer, int size);
-int Lstat(const char *pathname, DirEntry *statbuf);
+/**
+ * @brief       Get directory entries. The root directory ("." or "/") gives its
+ *              used entries, a file name gives the entry of the file.
+ *
+ * @param[in]   pathname    - "." or "/", or a file name.
+ * @param[out]  statbuf     - Entries.
+ * @param[in]   count       - Size of `statbuf` in entries.
+ * @return      int         - Number of copied entries, at most `count`.
+ *                          - -ENOENT if there is no such file.
+ */
+int Lstat(const char *pathname, DirEntry *statbuf, int count);
 
 int GetFileSize(Process *proc, int fd);
\ No newline at end of file
@@ -0,0 +1,207 @@
+#include <stddef.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <string.h>
+
+#include "fpu.h"
+#include "slab.h"
+#include "trap.h"
+#include "printk.h"
+#include "assert.h"
+
+/* Private define ------------------------------------------------------------*/
+#define CR0_MP                          (1 << 1)    /* Monitor co-processor.  */
+#define CR0_EM                          (1 << 2)    /* x87 emulation.         */
+#define CR0_TS                          (1 << 3)    /* Task switched.         */
+#define CR0_NE                          (1 << 5)    /* Native x87 exceptions. */
+#define CR4_OSFXSR                      (1 << 9)    /* FXSAVE, SSE enable.    */
+#define CR4_OSXMMEXCPT                  (1 << 10)   /* SIMD exceptions (#XM). */
+#define CR4_OSXSAVE                     (1 << 18)   /* XSAVE, XGETBV enable.  */
+
+#define CPUID_1_EDX_FXSR                (1 << 24)
+#define CPUID_1_EDX_SSE                 (1 << 25)
+#define CPUID_1_ECX_XSAVE               (1 << 26)
+#define CPUID_1_ECX_AVX                 (1 << 28)
+#define CPUID_XSAVE_LEAF                0x0D
+
+#define XCR0_X87                        (1 << 0)
+#define XCR0_SSE                        (1 << 1)
+#define XCR0_AVX                        (1 << 2)
+
+#define FXSAVE_AREA_SIZE                512
+#define FPU_STATE_ALIGNMENT             64          /* Required by XSAVE.     */
+
+/* Private variable ----------------------------------------------------------*/
+static SlabCache s_fpu_state_cache;
+static void *s_fpu_initial_state = NULL;    /* State after FNINIT.            */
+static Process *s_fpu_owner = NULL;         /* Process which owns registers.  */
+static bool s_fpu_use_xsave = false;
+static uint64_t s_fpu_xcr0 = 0;
+static uint64_t s_fpu_switch_count = 0;
+
+/* Private function prototypes -----------------------------------------------*/
+static void FPUSave(void *area);
+
+static void FPURestore(void *area);
+
+/**
+ * @brief   Allocate a state area, it is initialized with the clean state.
+ */
+static void *AllocFPUState(void);
+
+/* Public function -----------------------------------------------------------*/
+void InitFPU(void)
+{
+    uint32_t regs[4] = {0};     /* EAX, EBX, ECX, EDX. */
+    uint64_t state_size = FXSAVE_AREA_SIZE;
+
+    CPUID(1, 0, regs);
+    if ((regs[3] & CPUID_1_EDX_FXSR) == 0 || (regs[3] & CPUID_1_EDX_SSE) == 0) {
+        panic("CPU does not support SSE.");
+    }
+
+    WriteCR0((ReadCR0() & ~(uint64_t)(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE);
+    WriteCR4(ReadCR4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+
+    if ((regs[2] & CPUID_1_ECX_XSAVE) != 0) {
+        s_fpu_use_xsave = true;
+        s_fpu_xcr0 = XCR0_X87 | XCR0_SSE;
+        if ((regs[2] & CPUID_1_ECX_AVX) != 0) {
+            s_fpu_xcr0 |= XCR0_AVX;
+        }
+
+        WriteCR4(ReadCR4() | CR4_OSXSAVE);
+        WriteXCR0(s_fpu_xcr0);
+
+        /* EBX is the size of the XSAVE area for features enabled in XCR0. */
+        CPUID(CPUID_XSAVE_LEAF, 0, regs);
+        state_size = regs[1];
+    }
+
+    /* Objects of the cache are aligned if their size is a multiple of the
+     * alignment, because pages are 2MB aligned. */
+    InitSlabCache(&s_fpu_state_cache,
+                  (state_size + FPU_STATE_ALIGNMENT - 1)
+                  / FPU_STATE_ALIGNMENT * FPU_STATE_ALIGNMENT);
+
+    /* Save the clean state, new processes start with it. */
+    s_fpu_initial_state = SlabAlloc(&s_fpu_state_cache);
+    ASSERT(s_fpu_initial_state != NULL);
+    memset(s_fpu_initial_state, 0, s_fpu_state_cache.object_size);
+    FInit();
+    FPUSave(s_fpu_initial_state);
+
+    /* Nobody owns the registers, the first user raises #NM. */
+    WriteCR0(ReadCR0() | CR0_TS);
+
+    printk("FPU: %s, state size: %d bytes.\n",
+           s_fpu_use_xsave ? ((s_fpu_xcr0 & XCR0_AVX) ? "XSAVE AVX" : "XSAVE")
+                           : "FXSAVE",
+           state_size);
+}
+
+void FPUSwitch(Process *new)
+{
+    if (new == s_fpu_owner) {
+        ClearTS();
+    } else {
+        WriteCR0(ReadCR0() | CR0_TS);
+    }
+}
+
+void FPUHandleTrap(void)
+{
+    Process *current_proc = GetScheduler()->current_proc;
+
+    ClearTS();
+
+    if (current_proc == s_fpu_owner) {
+        return;
+    }
+
+    if (current_proc->fpu_state == NULL) {
+        current_proc->fpu_state = AllocFPUState();
+        if (current_proc->fpu_state == NULL) {
+            printk("FPU: Out of memory, terminating process.\n");
+            Exit(PROCESS_EXIT_FAILURE);
+        }
+    }
+
+    if (s_fpu_owner != NULL) {
+        FPUSave(s_fpu_owner->fpu_state);
+    }
+
+    FPURestore(current_proc->fpu_state);
+    s_fpu_owner = current_proc;
+    s_fpu_switch_count++;
+}
+
+int FPUCopyState(Process *child, Process *parent)
+{
+    if (parent->fpu_state == NULL) {
+        return 0;
+    }
+
+    child->fpu_state = SlabAlloc(&s_fpu_state_cache);
+    if (child->fpu_state == NULL) {
+        return -ENOMEM;
+    }
+
+    /* The registers in the CPU are newer than the saved state. */
+    if (parent == s_fpu_owner) {
+        ClearTS();
+        FPUSave(parent->fpu_state);
+    }
+
+    memcpy(child->fpu_state, parent->fpu_state, s_fpu_state_cache.object_size);
+
+    return 0;
+}
+
+void FPUReleaseState(Process *proc)
+{
+    if (proc == s_fpu_owner) {
+        /* The registers hold garbage now, re-arm the trap for the process. */
+        s_fpu_owner = NULL;
+        WriteCR0(ReadCR0() | CR0_TS);
+    }
+
+    if (proc->fpu_state != NULL) {
+        SlabFree(&s_fpu_state_cache, proc->fpu_state);
+        proc->fpu_state = NULL;
+    }
+}
+
+uint64_t GetFPUSwitchCount(void)
+{
+    return s_fpu_switch_count;
+}
+
+/* Private function ----------------------------------------------------------*/
+static void FPUSave(void *area)
+{
+    if (s_fpu_use_xsave) {
+        XSave(area, s_fpu_xcr0);
+    } else {
+        FXSave(area);
+    }
+}
+
+static void FPURestore(void *area)
+{
+    if (s_fpu_use_xsave) {
+        XRestore(area, s_fpu_xcr0);
+    } else {
+        FXRestore(area);
+    }
+}
+
+static void *AllocFPUState(void)
+{
+    void *area = SlabAlloc(&s_fpu_state_cache);
+    if (area != NULL) {
+        memcpy(area, s_fpu_initial_state, s_fpu_state_cache.object_size);
+    }
+
+    return area;
+}
@@ -0,0 +1,85 @@
+/**
+ * @file    fpu.h
+ * @author  Cong Nguyen (congnt264@gmail.com)
+ * @brief   FPU/SSE/AVX state management. User processes may use the x87 FPU,
+ *          SSE and AVX registers, so the registers are a part of the process
+ *          context. Saving and restoring them (hundreds of bytes) in every
+ *          context switch is wasted work, most processes never touch them. So
+ *          we switch them lazily:
+ *
+ *          - The CPU holds the registers of only one process, the owner.
+ *          - When we switch to a process which is not the owner, we set CR0.TS,
+ *            so the first FPU/SSE/AVX instruction of the process raises the
+ *            device not available exception (#NM, vector 7).
+ *          - The #NM handler saves the registers to the state area of the
+ *            owner, restores the registers of the current process and makes
+ *            it the new owner.
+ *
+ *          A process gets its state area on its first use of the registers.
+ *          The state is saved by XSAVE if the CPU supports it (x87, SSE and
+ *          AVX state), or by FXSAVE (x87 and SSE state) if it does not.
+ *
+ *          The kernel is built with -mgeneral-regs-only, kernel code never
+ *          touches the registers, so they are not saved on kernel entry.
+ *
+ * @version 0.1
+ * @date 2023-09-10
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+#include <stdint.h>
+#include "process.h"
+
+/* Public define -------------------------------------------------------------*/
+#define DEVICE_NOT_AVAILABLE_VECTOR     7
+
+/* Public function prototype -------------------------------------------------*/
+/**
+ * @brief       Enable FPU, SSE and AVX (if supported) and detect the size of
+ *              the state area.
+ */
+void InitFPU(void);
+
+/**
+ * @brief       Called when we switch to the new process. It lets the process
+ *              use the registers directly if it is the owner, otherwise it
+ *              arms the #NM trap.
+ *
+ * @param[in]   new         - The process we are switching to.
+ */
+void FPUSwitch(Process *new);
+
+/**
+ * @brief       Device not available (#NM) handler. Loads the FPU state of the
+ *              current process to the CPU.
+ */
+void FPUHandleTrap(void);
+
+/**
+ * @brief       Copy FPU state of the parent process to the child process. Used
+ *              in Fork() so the child keeps the register values.
+ *
+ * @param[in]   child       - New process, it has no state area yet.
+ * @param[in]   parent      - Current process.
+ * @return      int         - Zero if success.
+ *                          - -ENOMEM if we cannot allocate the state area.
+ */
+int FPUCopyState(Process *child, Process *parent);
+
+/**
+ * @brief       Free FPU state of the process. The next use of the registers by
+ *              the process starts with a clean state.
+ *
+ * @param[in]   proc        - Process.
+ */
+void FPUReleaseState(Process *proc);
+
+/**
+ * @brief       Get number of FPU state switches, each switch is one #NM trap
+ *              which restores the state of a process which is not the owner.
+ *
+ * @return      uint64_t    - Number of state switches.
+ */
+uint64_t GetFPUSwitchCount(void);
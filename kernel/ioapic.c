@@ -0,0 +1,402 @@
+#include <stddef.h>
+#include <errno.h>
+
+#include "ioapic.h"
+#include "acpi.h"
+#include "lapic.h"
+#include "memory.h"
+#include "trap.h"
+#include "io.h"
+#include "printk.h"
+
+/* Private define ------------------------------------------------------------*/
+#define MAXIMUM_IOAPICS             8
+#define MAXIMUM_APIC_CPUS           64
+#define ISA_IRQS                    16
+
+#define PIC_MASTER_DATA_PORT        0x21
+#define PIC_SLAVE_DATA_PORT         0xA1
+#define PIC_CASCADE_IRQ             2
+
+/* MADT entry types. */
+#define MADT_LOCAL_APIC             0
+#define MADT_IOAPIC                 1
+#define MADT_INTERRUPT_OVERRIDE     2
+
+#define MADT_LOCAL_APIC_ENABLED     (1 << 0)
+#define MADT_POLARITY_MASK          0x3
+#define MADT_POLARITY_ACTIVE_LOW    0x3
+#define MADT_TRIGGER_SHIFT          2
+#define MADT_TRIGGER_MASK           0x3
+#define MADT_TRIGGER_LEVEL          0x3
+
+/* I/O APIC registers, accessed through the index and the data window. */
+#define IOAPIC_REGISTERS_SIZE       0x20
+#define IOAPIC_INDEX                0x00
+#define IOAPIC_DATA                 0x10
+#define IOAPIC_VERSION              0x01
+#define IOAPIC_REDIRECTION_TABLE    0x10
+#define IOAPIC_MAXIMUM_ENTRY_SHIFT  16
+
+/* Redirection entry, fixed delivery and physical destination are 0. */
+#define IOAPIC_ACTIVE_LOW           (1 << 13)
+#define IOAPIC_LEVEL_TRIGGERED      (1 << 15)
+#define IOAPIC_MASKED               (1 << 16)
+#define IOAPIC_DESTINATION_SHIFT    56
+
+/* Private type --------------------------------------------------------------*/
+/**
+ * @brief   Multiple APIC Description Table, the entries follow it.
+ */
+typedef struct {
+    ACPITableHeader header;
+    uint32_t lapic_address;
+    uint32_t flags;
+} __attribute__ ((packed)) MADT;
+
+typedef struct {
+    uint8_t type;
+    uint8_t length;
+} __attribute__ ((packed)) MADTEntryHeader;
+
+typedef struct {
+    MADTEntryHeader header;
+    uint8_t processor_id;
+    uint8_t apic_id;
+    uint32_t flags;
+} __attribute__ ((packed)) MADTLocalAPIC;
+
+typedef struct {
+    MADTEntryHeader header;
+    uint8_t ioapic_id;
+    uint8_t reserved;
+    uint32_t address;
+    uint32_t gsi_base;
+} __attribute__ ((packed)) MADTIOAPIC;
+
+typedef struct {
+    MADTEntryHeader header;
+    uint8_t bus;
+    uint8_t source;             /* ISA IRQ.                                 */
+    uint32_t gsi;
+    uint16_t flags;             /* Polarity and trigger mode.               */
+} __attribute__ ((packed)) MADTInterruptOverride;
+
+/**
+ * @brief   I/O APIC structure.
+ *
+ * @property registers  - Mapped registers.
+ * @property gsi_base   - First GSI of the pins.
+ * @property pins       - Number of input pins.
+ */
+typedef struct {
+    volatile uint32_t *registers;
+    uint32_t gsi_base;
+    uint32_t pins;
+} IOAPIC;
+
+/**
+ * @brief   Connection of an ISA IRQ.
+ *
+ * @property gsi        - Global system interrupt.
+ * @property flags      - Polarity and trigger bits of the redirection entry.
+ * @property apic_id    - Local APIC ID of the CPU which receives it.
+ */
+typedef struct {
+    uint32_t gsi;
+    uint32_t flags;
+    uint8_t apic_id;
+} IRQRoute;
+
+/* Private variable ----------------------------------------------------------*/
+static bool s_use_ioapic = false;
+static IOAPIC s_ioapics[MAXIMUM_IOAPICS];
+static int s_ioapic_count = 0;
+static uint8_t s_cpu_apic_ids[MAXIMUM_APIC_CPUS];
+static int s_cpu_count = 0;
+static IRQRoute s_irq_routes[ISA_IRQS];
+
+/* Private function prototypes -----------------------------------------------*/
+/**
+ * @brief   Read the MADT entries.
+ */
+static void ParseMADT(const MADT *madt);
+
+static void AddIOAPIC(const MADTIOAPIC *entry);
+
+static void AddInterruptOverride(const MADTInterruptOverride *entry);
+
+/**
+ * @brief   Find the I/O APIC which has the GSI.
+ */
+static IOAPIC *FindIOAPIC(uint32_t gsi);
+
+static uint32_t ReadIOAPIC(IOAPIC *ioapic, uint32_t reg);
+
+static void WriteIOAPIC(IOAPIC *ioapic, uint32_t reg, uint32_t value);
+
+/**
+ * @brief   Write the redirection entry of an ISA IRQ.
+ */
+static void WriteRoute(uint8_t irq, bool masked);
+
+/* Public function -----------------------------------------------------------*/
+bool InitIOAPIC(void)
+{
+    const MADT *madt = NULL;
+
+    for (int irq = 0; irq < ISA_IRQS; irq++) {
+        s_irq_routes[irq].gsi = irq;
+        s_irq_routes[irq].flags = 0;
+    }
+
+    if (!LAPICIsEnabled()) {
+        return false;
+    }
+
+    madt = (const MADT *)FindACPITable("APIC");
+    if (madt == NULL) {
+        printk("IOAPIC: no MADT, using the 8259 PIC.\n");
+        return false;
+    }
+
+    ParseMADT(madt);
+    if (s_ioapic_count == 0) {
+        printk("IOAPIC: not found, using the 8259 PIC.\n");
+        return false;
+    }
+
+    /* Every pin starts masked. */
+    for (int i = 0; i < s_ioapic_count; i++) {
+        for (uint32_t pin = 0; pin < s_ioapics[i].pins; pin++) {
+            WriteIOAPIC(&s_ioapics[i],
+                        IOAPIC_REDIRECTION_TABLE + pin * 2,
+                        IOAPIC_MASKED);
+        }
+    }
+
+    for (int irq = 0; irq < ISA_IRQS; irq++) {
+        s_irq_routes[irq].apic_id = LAPICGetID();
+    }
+
+    /* Take the IRQs the 8259 delivers now, and disable the 8259. */
+    s_use_ioapic = true;
+    for (int irq = 0; irq < ISA_IRQS; irq++) {
+        uint16_t port = irq < 8 ? PIC_MASTER_DATA_PORT : PIC_SLAVE_DATA_PORT;
+
+        if (irq != PIC_CASCADE_IRQ && (InByte(port) & (1 << (irq % 8))) == 0) {
+            EnableIRQ(irq);
+        }
+    }
+
+    OutByte(PIC_MASTER_DATA_PORT, 0xFF);
+    OutByte(PIC_SLAVE_DATA_PORT, 0xFF);
+
+    printk("IOAPIC: %d I/O APIC(s), %d CPU(s).\n", s_ioapic_count, s_cpu_count);
+
+    return true;
+}
+
+void EnableIRQ(uint8_t irq)
+{
+    uint16_t port = irq < 8 ? PIC_MASTER_DATA_PORT : PIC_SLAVE_DATA_PORT;
+
+    if (irq >= ISA_IRQS) {
+        return;
+    }
+
+    if (s_use_ioapic) {
+        WriteRoute(irq, false);
+    } else {
+        OutByte(port, InByte(port) & ~(1 << (irq % 8)));
+    }
+}
+
+void DisableIRQ(uint8_t irq)
+{
+    uint16_t port = irq < 8 ? PIC_MASTER_DATA_PORT : PIC_SLAVE_DATA_PORT;
+
+    if (irq >= ISA_IRQS) {
+        return;
+    }
+
+    if (s_use_ioapic) {
+        WriteRoute(irq, true);
+    } else {
+        OutByte(port, InByte(port) | (1 << (irq % 8)));
+    }
+}
+
+int SetIRQAffinity(uint8_t irq, int cpu)
+{
+    IOAPIC *ioapic = NULL;
+    uint32_t low = 0;
+
+    if (!s_use_ioapic) {
+        return -ENODEV;
+    }
+
+    if (irq >= ISA_IRQS || cpu < 0 || cpu >= s_cpu_count) {
+        return -EINVAL;
+    }
+
+    s_irq_routes[irq].apic_id = s_cpu_apic_ids[cpu];
+
+    /* Keep the mask bit of the pin. */
+    ioapic = FindIOAPIC(s_irq_routes[irq].gsi);
+    if (ioapic == NULL) {
+        return -EINVAL;
+    }
+
+    low = ReadIOAPIC(ioapic,
+                     IOAPIC_REDIRECTION_TABLE
+                     + (s_irq_routes[irq].gsi - ioapic->gsi_base) * 2);
+    WriteRoute(irq, (low & IOAPIC_MASKED) != 0);
+
+    return 0;
+}
+
+int GetCPUCount(void)
+{
+    return s_cpu_count > 0 ? s_cpu_count : 1;
+}
+
+void IRQEOI(void)
+{
+    if (s_use_ioapic) {
+        LAPICEOI();
+    } else {
+        EOI();
+    }
+}
+
+/* Private function ----------------------------------------------------------*/
+static void ParseMADT(const MADT *madt)
+{
+    const uint8_t *entry = (const uint8_t *)(madt + 1);
+    const uint8_t *end = (const uint8_t *)madt + madt->header.length;
+
+    while (entry + sizeof(MADTEntryHeader) <= end) {
+        const MADTEntryHeader *header = (const MADTEntryHeader *)entry;
+
+        if (header->length < sizeof(MADTEntryHeader)
+            || entry + header->length > end) {
+            break;
+        }
+
+        switch (header->type) {
+        case MADT_LOCAL_APIC: {
+            const MADTLocalAPIC *lapic = (const MADTLocalAPIC *)entry;
+
+            if ((lapic->flags & MADT_LOCAL_APIC_ENABLED)
+                && s_cpu_count < MAXIMUM_APIC_CPUS) {
+                s_cpu_apic_ids[s_cpu_count++] = lapic->apic_id;
+            }
+        }
+        break;
+        case MADT_IOAPIC:
+            AddIOAPIC((const MADTIOAPIC *)entry);
+            break;
+        case MADT_INTERRUPT_OVERRIDE:
+            AddInterruptOverride((const MADTInterruptOverride *)entry);
+            break;
+        default:
+            break;
+        }
+
+        entry += header->length;
+    }
+}
+
+static void AddIOAPIC(const MADTIOAPIC *entry)
+{
+    IOAPIC *ioapic = &s_ioapics[s_ioapic_count];
+
+    if (s_ioapic_count >= MAXIMUM_IOAPICS) {
+        return;
+    }
+
+    ioapic->registers = (volatile uint32_t *)MapMMIO(entry->address,
+                                                     IOAPIC_REGISTERS_SIZE);
+    if (ioapic->registers == NULL) {
+        return;
+    }
+
+    ioapic->gsi_base = entry->gsi_base;
+    ioapic->pins = ((ReadIOAPIC(ioapic, IOAPIC_VERSION)
+                     >> IOAPIC_MAXIMUM_ENTRY_SHIFT) & 0xFF) + 1;
+
+    s_ioapic_count++;
+}
+
+static void AddInterruptOverride(const MADTInterruptOverride *entry)
+{
+    uint32_t flags = 0;
+
+    /* Only ISA overrides exist. */
+    if (entry->bus != 0 || entry->source >= ISA_IRQS) {
+        return;
+    }
+
+    if ((entry->flags & MADT_POLARITY_MASK) == MADT_POLARITY_ACTIVE_LOW) {
+        flags |= IOAPIC_ACTIVE_LOW;
+    }
+
+    if (((entry->flags >> MADT_TRIGGER_SHIFT) & MADT_TRIGGER_MASK)
+        == MADT_TRIGGER_LEVEL) {
+        flags |= IOAPIC_LEVEL_TRIGGERED;
+    }
+
+    s_irq_routes[entry->source].gsi = entry->gsi;
+    s_irq_routes[entry->source].flags = flags;
+}
+
+static IOAPIC *FindIOAPIC(uint32_t gsi)
+{
+    for (int i = 0; i < s_ioapic_count; i++) {
+        if (gsi >= s_ioapics[i].gsi_base
+            && gsi < s_ioapics[i].gsi_base + s_ioapics[i].pins) {
+            return &s_ioapics[i];
+        }
+    }
+
+    return NULL;
+}
+
+static uint32_t ReadIOAPIC(IOAPIC *ioapic, uint32_t reg)
+{
+    ioapic->registers[IOAPIC_INDEX / sizeof(uint32_t)] = reg;
+    return ioapic->registers[IOAPIC_DATA / sizeof(uint32_t)];
+}
+
+static void WriteIOAPIC(IOAPIC *ioapic, uint32_t reg, uint32_t value)
+{
+    ioapic->registers[IOAPIC_INDEX / sizeof(uint32_t)] = reg;
+    ioapic->registers[IOAPIC_DATA / sizeof(uint32_t)] = value;
+}
+
+static void WriteRoute(uint8_t irq, bool masked)
+{
+    IRQRoute *route = &s_irq_routes[irq];
+    IOAPIC *ioapic = FindIOAPIC(route->gsi);
+    uint32_t reg = 0;
+    uint64_t entry = 0;
+
+    if (ioapic == NULL) {
+        return;
+    }
+
+    reg = IOAPIC_REDIRECTION_TABLE + (route->gsi - ioapic->gsi_base) * 2;
+    entry = (uint64_t)(IRQ_VECTOR_BASE + irq)
+            | route->flags
+            | ((uint64_t)route->apic_id << IOAPIC_DESTINATION_SHIFT);
+
+    if (masked) {
+        entry |= IOAPIC_MASKED;
+    }
+
+    /* Mask the pin while the entry is half written. */
+    WriteIOAPIC(ioapic, reg, IOAPIC_MASKED);
+    WriteIOAPIC(ioapic, reg + 1, (uint32_t)(entry >> 32));
+    WriteIOAPIC(ioapic, reg, (uint32_t)entry);
+}
@@ -0,0 +1,80 @@
+/**
+ * @file    ioapic.h
+ * @author  Cong Nguyen (congnt264@gmail.com)
+ * @brief   I/O APIC driver and routing of the legacy IRQs. The I/O APICs and
+ *          the CPUs are listed in the MADT (ACPI table "APIC"). Each input pin
+ *          of an I/O APIC (global system interrupt, GSI) has a redirection
+ *          entry which selects the vector and the local APIC ID of the CPU
+ *          that receives the interrupt, so every IRQ can be steered to its
+ *          own CPU. The end of interrupt is a register write to the local
+ *          APIC, no port I/O.
+ *
+ *          ISA IRQs are connected to the GSI of the same number, unless the
+ *          MADT has an interrupt source override for them (IRQ0 is usually on
+ *          GSI 2), the override also gives the polarity and trigger mode.
+ *
+ *          Once the I/O APIC takes over, the 8259 PICs are masked. Without an
+ *          I/O APIC (or without a local APIC) the 8259 keeps delivering IRQs,
+ *          so the functions here work in both modes.
+ *
+ * @version 0.1
+ * @date 2023-09-24
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Public define -------------------------------------------------------------*/
+#define IRQ_VECTOR_BASE             32  /* IRQ n uses vector 32 + n.          */
+#define PIT_IRQ                     0
+#define KEYBOARD_IRQ                1
+
+/* Public function prototype -------------------------------------------------*/
+/**
+ * @brief       Find the I/O APICs and the CPUs in the MADT, mask every pin and
+ *              disable the 8259 PICs. It needs the local APIC.
+ *
+ * @return      true        - Legacy IRQs are delivered by the I/O APIC.
+ * @return      false       - No MADT or no I/O APIC, the 8259 is kept.
+ */
+bool InitIOAPIC(void);
+
+/**
+ * @brief       Deliver an ISA IRQ to IRQ_VECTOR_BASE + irq, on the current CPU.
+ *
+ * @param[in]   irq         - ISA IRQ number, 0 to 15.
+ */
+void EnableIRQ(uint8_t irq);
+
+/**
+ * @brief       Stop delivering an ISA IRQ.
+ *
+ * @param[in]   irq         - ISA IRQ number, 0 to 15.
+ */
+void DisableIRQ(uint8_t irq);
+
+/**
+ * @brief       Deliver an ISA IRQ to another CPU.
+ *
+ * @param[in]   irq         - ISA IRQ number, 0 to 15.
+ * @param[in]   cpu         - Index of the CPU in the MADT, the CPU must have
+ *                            its local APIC enabled.
+ * @return      int         - 0 on success.
+ *                          - -EINVAL if the CPU or the IRQ doesn't exist.
+ *                          - -ENODEV if the 8259 delivers the IRQs.
+ */
+int SetIRQAffinity(uint8_t irq, int cpu);
+
+/**
+ * @brief       Number of enabled CPUs in the MADT, 1 without MADT.
+ */
+int GetCPUCount(void);
+
+/**
+ * @brief       Send end of interrupt for an ISA IRQ, to the local APIC or to
+ *              the 8259.
+ */
+void IRQEOI(void);
@@ -0,0 +1,490 @@
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+
+#include "ioring.h"
+#include "workqueue.h"
+#include "timer.h"
+#include "slab.h"
+#include "memory.h"
+#include "file.h"
+#include "printk.h"
+
+/* Private define ------------------------------------------------------------*/
+#define IORING_MASK                 (IORING_ENTRIES - 1)
+#define IORING_SQPOLL_INTERVAL_US   1000
+#define IORING_SQPOLL_IDLE_US       100000
+#define IORING_WRITE_CHUNK_SIZE     128
+
+/* The ring is written by the user program at any time, the compiler must not
+ * reorder accesses to the ring with the index accesses. The CPU keeps the
+ * order of stores and of loads on x86. */
+#define COMPILER_BARRIER()          __asm__ __volatile__("" ::: "memory")
+
+#define CONTEXT_OF(p, member) \
+    ((IORingContext *)((char *)(p) - offsetof(IORingContext, member)))
+
+/* Private type --------------------------------------------------------------*/
+/**
+ * @brief   Ring context of a process.
+ *
+ * @property proc       - Owner process.
+ * @property ring       - Kernel address of the ring.
+ * @property setup_flags - IORING_SETUP_*.
+ * @property inflight   - Taken submissions whose completion is not posted yet,
+ *                        each of them owns a free completion slot.
+ * @property submit_budget - Submissions accepted by IORingEnter which the
+ *                        worker didn't take yet.
+ * @property work       - Work item which consumes the submission ring.
+ * @property poll_timer - SQ polling timer.
+ * @property polling    - The poll timer is running.
+ * @property last_submission - Uptime of the last taken submission.
+ * @property sleeps     - Pending sleep operations.
+ * @property cq_wait    - Processes waiting for completions.
+ */
+typedef struct IORingContext {
+    Process *proc;
+    IORing *ring;
+    uint32_t setup_flags;
+    uint32_t inflight;
+    uint32_t submit_budget;
+    Work work;
+    Timer poll_timer;
+    bool polling;
+    uint64_t last_submission;
+    HeadList sleeps;
+    WaitQueue cq_wait;
+} IORingContext;
+
+/**
+ * @brief   Sleep operation, the timer posts the completion.
+ */
+typedef struct {
+    Timer timer;
+    List link;
+    IORingContext *ctx;
+    uint64_t user_data;
+} IORingSleep;
+
+/* Private variable ----------------------------------------------------------*/
+static SlabCache s_context_cache;
+static SlabCache s_sleep_cache;
+
+/* Private function prototypes -----------------------------------------------*/
+/**
+ * @brief   Work function, it takes submissions while the completion ring has
+ *          room for them.
+ */
+static void IORingWork(Work *work);
+
+static void IORingPollTimer(Timer *timer);
+
+static void IORingSleepExpired(Timer *timer);
+
+static void StartPolling(IORingContext *ctx);
+
+/**
+ * @brief   Run one submission, operations which finish now post their
+ *          completion here.
+ */
+static void RunSubmission(IORingContext *ctx, const IORingSQE *sqe);
+
+static void PostCompletion(IORingContext *ctx,
+                           uint64_t user_data,
+                           int64_t result);
+
+/**
+ * @brief   Check if the worker can take the next submission.
+ */
+static bool CanTakeSubmission(IORingContext *ctx);
+
+static int64_t RingRead(IORingContext *ctx, const IORingSQE *sqe);
+
+static int64_t RingWrite(IORingContext *ctx, const IORingSQE *sqe);
+
+static int64_t RingOpen(IORingContext *ctx, const IORingSQE *sqe);
+
+static int64_t RingSleep(IORingContext *ctx, const IORingSQE *sqe);
+
+/* Public function -----------------------------------------------------------*/
+void InitIORing(void)
+{
+    InitSlabCache(&s_context_cache, sizeof(IORingContext));
+    InitSlabCache(&s_sleep_cache, sizeof(IORingSleep));
+}
+
+int IORingSetup(Process *proc, uint64_t ring, uint32_t flags)
+{
+    IORingContext *ctx = NULL;
+    IORing *kernel_ring = NULL;
+
+    if (proc->ioring != NULL) {
+        return -EBUSY;
+    }
+
+    if ((ring & (sizeof(uint64_t) - 1)) != 0) {
+        return -EINVAL;
+    }
+
+    kernel_ring = (IORing *)UserToKernelAddress(proc->vm->page_map,
+                                                ring,
+                                                sizeof(IORing));
+    if (kernel_ring == NULL) {
+        return -EFAULT;
+    }
+
+    ctx = SlabAlloc(&s_context_cache);
+    if (ctx == NULL) {
+        return -ENOMEM;
+    }
+
+    ctx->proc = proc;
+    ctx->ring = kernel_ring;
+    ctx->setup_flags = flags;
+    ctx->inflight = 0;
+    ctx->submit_budget = 0;
+    ctx->polling = false;
+    ctx->last_submission = 0;
+    ctx->sleeps.next = NULL;
+    ctx->sleeps.tail = NULL;
+    InitWork(&ctx->work, IORingWork);
+    InitTimerEntry(&ctx->poll_timer, IORingPollTimer);
+    InitWaitQueue(&ctx->cq_wait);
+
+    kernel_ring->sq_head = 0;
+    kernel_ring->sq_tail = 0;
+    kernel_ring->cq_head = 0;
+    kernel_ring->cq_tail = 0;
+    kernel_ring->flags = 0;
+
+    proc->ioring = ctx;
+
+    if (flags & IORING_SETUP_SQPOLL) {
+        StartPolling(ctx);
+    }
+
+    return 0;
+}
+
+int64_t IORingEnter(Process *proc,
+                    uint32_t to_submit,
+                    uint32_t min_complete,
+                    uint32_t flags)
+{
+    IORingContext *ctx = proc->ioring;
+    IORing *ring = NULL;
+    uint32_t pending = 0;
+    uint32_t budget = 0;
+
+    if (ctx == NULL) {
+        return -EINVAL;
+    }
+
+    ring = ctx->ring;
+
+    if ((flags & IORING_ENTER_SQ_WAKEUP)
+        && (ctx->setup_flags & IORING_SETUP_SQPOLL)
+        && !ctx->polling) {
+        StartPolling(ctx);
+    }
+
+    pending = ring->sq_tail - ring->sq_head;
+    if (pending > IORING_ENTRIES) {
+        pending = IORING_ENTRIES;
+    }
+
+    /* Entries accepted by an earlier call count against the pending ones,
+     * the worker takes exactly the budget. */
+    budget = ctx->submit_budget;
+    if (budget > pending) {
+        budget = pending;
+    }
+
+    if (to_submit > pending - budget) {
+        to_submit = pending - budget;
+    }
+
+    ctx->submit_budget = budget + to_submit;
+
+    if (ctx->submit_budget > 0) {
+        QueueWork(&ctx->work);
+    }
+
+    if (min_complete > IORING_ENTRIES) {
+        min_complete = IORING_ENTRIES;
+    }
+
+    /* Wait while an operation can still complete. */
+    while ((uint32_t)(ring->cq_tail - ring->cq_head) < min_complete
+           && (ctx->work.pending
+               || ctx->work.running
+               || ctx->inflight > 0)) {
+        Sleep(&ctx->cq_wait);
+    }
+
+    return to_submit;
+}
+
+void IORingRelease(Process *proc)
+{
+    IORingContext *ctx = proc->ioring;
+    List *link = NULL;
+
+    if (ctx == NULL) {
+        return;
+    }
+
+    DeleteTimer(&ctx->poll_timer);
+    ctx->polling = false;
+
+    while ((link = ListPopFront(&ctx->sleeps)) != NULL) {
+        IORingSleep *sleep = (IORingSleep *)((char *)link
+                                             - offsetof(IORingSleep, link));
+
+        DeleteTimer(&sleep->timer);
+        SlabFree(&s_sleep_cache, sleep);
+    }
+
+    /* The worker may be using the memory and the files of the process. */
+    FlushWork(&ctx->work);
+
+    proc->ioring = NULL;
+    SlabFree(&s_context_cache, ctx);
+}
+
+/* Private function ----------------------------------------------------------*/
+static void IORingWork(Work *work)
+{
+    IORingContext *ctx = CONTEXT_OF(work, work);
+    IORing *ring = ctx->ring;
+    IORingSQE sqe;
+
+    /* SQ polling takes everything, otherwise only what IORingEnter
+     * accepted. */
+    while ((ctx->submit_budget > 0
+            || (ctx->setup_flags & IORING_SETUP_SQPOLL))
+           && CanTakeSubmission(ctx)) {
+        COMPILER_BARRIER();
+
+        /* Copy the entry, the program may change the slot after we move the
+         * head. */
+        sqe = ring->sqes[ring->sq_head & IORING_MASK];
+
+        COMPILER_BARRIER();
+        ring->sq_head++;
+
+        if (ctx->submit_budget > 0) {
+            ctx->submit_budget--;
+        }
+
+        ctx->last_submission = GetUptimeUS();
+        RunSubmission(ctx, &sqe);
+    }
+
+    /* Waiters check the work state again, it may have posted nothing. */
+    Wakeup(&ctx->cq_wait);
+}
+
+static void IORingPollTimer(Timer *timer)
+{
+    IORingContext *ctx = CONTEXT_OF(timer, poll_timer);
+    uint64_t now = GetUptimeUS();
+
+    if (ctx->ring->sq_head != ctx->ring->sq_tail) {
+        ctx->last_submission = now;
+        QueueWork(&ctx->work);
+    } else if (now - ctx->last_submission >= IORING_SQPOLL_IDLE_US) {
+        /* Idle, the program has to wake us up with the next submission. */
+        ctx->polling = false;
+        ctx->ring->flags |= IORING_SQ_NEED_WAKEUP;
+        return;
+    }
+
+    AddTimer(&ctx->poll_timer, now + IORING_SQPOLL_INTERVAL_US);
+}
+
+static void IORingSleepExpired(Timer *timer)
+{
+    IORingSleep *sleep = (IORingSleep *)timer;
+    IORingContext *ctx = sleep->ctx;
+
+    ListRemove(&ctx->sleeps, &sleep->link);
+    ctx->inflight--;
+    PostCompletion(ctx, sleep->user_data, 0);
+
+    SlabFree(&s_sleep_cache, sleep);
+
+    /* The completion slot is free again. */
+    if (ctx->ring->sq_head != ctx->ring->sq_tail) {
+        QueueWork(&ctx->work);
+    }
+}
+
+static void StartPolling(IORingContext *ctx)
+{
+    ctx->ring->flags &= ~IORING_SQ_NEED_WAKEUP;
+    ctx->polling = true;
+    ctx->last_submission = GetUptimeUS();
+    AddTimer(&ctx->poll_timer,
+             ctx->last_submission + IORING_SQPOLL_INTERVAL_US);
+}
+
+static void RunSubmission(IORingContext *ctx, const IORingSQE *sqe)
+{
+    int64_t result = 0;
+
+    switch (sqe->opcode) {
+    case IORING_OP_NOP:
+        result = 0;
+        break;
+    case IORING_OP_READ:
+        result = RingRead(ctx, sqe);
+        break;
+    case IORING_OP_WRITE:
+        result = RingWrite(ctx, sqe);
+        break;
+    case IORING_OP_OPEN:
+        result = RingOpen(ctx, sqe);
+        break;
+    case IORING_OP_CLOSE:
+        if (sqe->fd < USER_START_FD
+            || sqe->fd >= PROCESS_MAXIMUM_FILE_DESCRIPTOR) {
+            result = -EBADF;
+        } else {
+            Close(ctx->proc, sqe->fd);
+        }
+        break;
+    case IORING_OP_SLEEP:
+        result = RingSleep(ctx, sqe);
+        if (result == 0) {
+            /* The timer posts the completion. */
+            return;
+        }
+        break;
+    default:
+        result = -EINVAL;
+        break;
+    }
+
+    PostCompletion(ctx, sqe->user_data, result);
+}
+
+static void PostCompletion(IORingContext *ctx,
+                           uint64_t user_data,
+                           int64_t result)
+{
+    IORing *ring = ctx->ring;
+    IORingCQE *cqe = &ring->cqes[ring->cq_tail & IORING_MASK];
+
+    cqe->user_data = user_data;
+    cqe->result = result;
+
+    COMPILER_BARRIER();
+    ring->cq_tail++;
+
+    Wakeup(&ctx->cq_wait);
+}
+
+static bool CanTakeSubmission(IORingContext *ctx)
+{
+    IORing *ring = ctx->ring;
+    uint32_t used = ring->cq_tail - ring->cq_head;
+
+    if (ring->sq_head == ring->sq_tail) {
+        return false;
+    }
+
+    /* The program didn't reap enough completions yet. */
+    return used <= IORING_ENTRIES
+           && IORING_ENTRIES - used > ctx->inflight;
+}
+
+static int64_t RingRead(IORingContext *ctx, const IORingSQE *sqe)
+{
+    uint64_t buffer = 0;
+
+    if (sqe->fd < USER_START_FD
+        || sqe->fd >= PROCESS_MAXIMUM_FILE_DESCRIPTOR) {
+        return -EBADF;
+    }
+
+    buffer = UserToKernelAddress(ctx->proc->vm->page_map, sqe->addr, sqe->len);
+    if (buffer == 0) {
+        return -EFAULT;
+    }
+
+    return Read(ctx->proc, sqe->fd, (void *)buffer, sqe->len);
+}
+
+static int64_t RingWrite(IORingContext *ctx, const IORingSQE *sqe)
+{
+    char chunk[IORING_WRITE_CHUNK_SIZE + 1];
+    const char *buffer = NULL;
+    uint64_t size = 0;
+
+    /* Only the console can be written, like SysWrite. */
+    if (sqe->fd != STANDARD_OUTPUT && sqe->fd != STANDARD_ERROR) {
+        return -EBADF;
+    }
+
+    buffer = (const char *)UserToKernelAddress(ctx->proc->vm->page_map,
+                                               sqe->addr,
+                                               sqe->len);
+    if (buffer == NULL) {
+        return -EFAULT;
+    }
+
+    for (uint64_t i = 0; i < sqe->len; i += size) {
+        size = sqe->len - i;
+        if (size > IORING_WRITE_CHUNK_SIZE) {
+            size = IORING_WRITE_CHUNK_SIZE;
+        }
+
+        memcpy(chunk, buffer + i, size);
+        chunk[size] = '\0';
+        printk("%s", chunk);
+    }
+
+    return sqe->len;
+}
+
+static int64_t RingOpen(IORingContext *ctx, const IORingSQE *sqe)
+{
+    uint64_t end = USER_VIRTUAL_ADDRESS_BASE + PAGE_SIZE;
+    const char *path = NULL;
+
+    path = (const char *)UserToKernelAddress(ctx->proc->vm->page_map,
+                                             sqe->addr,
+                                             1);
+    if (path == NULL) {
+        return -EFAULT;
+    }
+
+    /* The path has to end in the user memory. */
+    for (uint64_t i = 0; path[i] != '\0'; i++) {
+        if (sqe->addr + i + 1 >= end) {
+            return -EFAULT;
+        }
+    }
+
+    return Open(ctx->proc, path);
+}
+
+static int64_t RingSleep(IORingContext *ctx, const IORingSQE *sqe)
+{
+    IORingSleep *sleep = SlabAlloc(&s_sleep_cache);
+
+    if (sleep == NULL) {
+        return -ENOMEM;
+    }
+
+    sleep->ctx = ctx;
+    sleep->user_data = sqe->user_data;
+    InitTimerEntry(&sleep->timer, IORingSleepExpired);
+    ListPushBack(&ctx->sleeps, &sleep->link);
+
+    ctx->inflight++;
+    AddTimer(&sleep->timer, GetUptimeUS() + sqe->len);
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file    ioring.h
+ * @author  Cong Nguyen (congnt264@gmail.com)
+ * @brief   Asynchronous I/O with a submission ring and a completion ring per
+ *          process (the layout is in libc ioring.h). A program queues many
+ *          operations and starts them with one ioring_enter system call, the
+ *          operations run in a kernel worker of the workqueue, and the results
+ *          are posted to the completion ring. The same call can also wait for
+ *          completions, so submitting and reaping a batch costs one kernel
+ *          entry.
+ *
+ *          With IORING_SETUP_SQPOLL the kernel polls the submission ring with
+ *          a timer, the program doesn't enter the kernel to submit. After the
+ *          ring has been idle for a while, polling stops and the kernel sets
+ *          IORING_SQ_NEED_WAKEUP, the program then restarts it with
+ *          IORING_ENTER_SQ_WAKEUP.
+ *
+ *          Sleep operations don't block the worker, they are kernel timers
+ *          which post the completion when they expire.
+ *
+ * @version 0.1
+ * @date 2023-09-23
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+#include <stdint.h>
+#include <ioring.h>
+
+#include "process.h"
+
+/* Public function prototype -------------------------------------------------*/
+/**
+ * @brief       Initialize the object caches of rings.
+ */
+void InitIORing(void);
+
+/**
+ * @brief       Register the ring of the process.
+ *
+ * @param[in]   proc        - Process.
+ * @param[in]   ring        - User address of the ring (IORing).
+ * @param[in]   flags       - IORING_SETUP_*.
+ * @return      int         - 0 on success.
+ *                          - -EBUSY if the process has a ring already.
+ *                          - -EFAULT if the ring is not in user memory.
+ *                          - -ENOMEM if there is no memory.
+ */
+int IORingSetup(Process *proc, uint64_t ring, uint32_t flags);
+
+/**
+ * @brief       Start the queued submissions and wait for completions.
+ *
+ * @param[in]   proc        - Process.
+ * @param[in]   to_submit   - Maximum number of submissions to start.
+ * @param[in]   min_complete - Wait until there are this many completions in
+ *                            the completion ring, unless no operation is left
+ *                            to complete.
+ * @param[in]   flags       - IORING_ENTER_*.
+ * @return      int64_t     - Number of submissions accepted, the worker
+ *                            takes exactly this many from the ring.
+ *                          - -EINVAL if the process has no ring.
+ */
+int64_t IORingEnter(Process *proc,
+                    uint32_t to_submit,
+                    uint32_t min_complete,
+                    uint32_t flags);
+
+/**
+ * @brief       Cancel pending sleeps, wait for the running operations and
+ *              unregister the ring. It is called when the process exits or
+ *              replaces its memory.
+ *
+ * @param[in]   proc        - Process.
+ */
+void IORingRelease(Process *proc);
@@ -22,12 +22,18 @@ GDT64:
     dq 0            ; First entry is NULL.
 CodeSegDes64:       ; Next entry is Code Segment Descriptor.
     dq 0x0020980000000000
+DataSegDes64:               ; Kernel data segment descriptor, it is loaded to SS
+    dq 0x0000920000000000   ; by the SYSCALL instruction.
+
+; SYSRET loads the user SS from the selector in STAR + 8 and the user CS from
+; the selector in STAR + 16, so the user data descriptor has to be followed by
+; the user code descriptor.
+DataSegDes64Ring3:
+    dq 0x0000F20000000000   ; Make data segment descriptor that run with
+                            ; privilege level 3 and writable.
 CodeSegDes64Ring3:
     dq 0x0020F80000000000   ; DPL is ring 3, we make new code segment descriptor
                             ; that run with privilege level 3.
-DataSegDes64Ring3:
-    dq 0x0000F20000000000   ; And make data segment descriptor that run with
-                            ; privilege level 3 also and writable.
 TaskStateSegDes64:          ; Task state segment descriptor.
     dw TssLen - 1           ; First two bytes are the lower 16 bits of TSS limit
     dw 0                    ; Lower 24 bits of base address is set to 0.
@@ -73,7 +79,7 @@ SetTSS:
     mov [rdi + 7], al
     shr rax, 8
     mov [rdi + 8], eax
-    mov ax, 0x20                    ; Tss des is 5th entry, so we move 0x20.
+    mov ax, 0x28                    ; Tss des is 6th entry, so we move 0x28.
     ltr ax                          ; Load TSS.
 
     ; 3. Initialize PIT - Programable Interval Timer.
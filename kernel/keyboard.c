@@ -2,6 +2,7 @@
 #include "printk.h"
 #include "process.h"
 #include "io.h"
+#include "softirq.h"
 /* Private define ------------------------------------------------------------*/
 
 #define E0_SIGN                 (1 << 0)
@@ -9,6 +10,7 @@
 #define CAPS_LOCK               (1 << 2)
 
 #define SENT_SCAN_CODE_PORT     0x60
+#define SCAN_CODE_QUEUE_SIZE    64      /* Power of two.                      */
 
 /* Private type --------------------------------------------------------------*/
 /**
@@ -20,6 +22,7 @@ static struct KeyboardBuffer {
     int front;
     int end;
     int size;
+    WaitQueue wait_queue;   /* Processes waiting for a key. */
 } s_keyboard_controller = {{0}, 0, 0, 500}; 
 
 /* Private variable ----------------------------------------------------------*/
@@ -35,6 +38,12 @@ static unsigned char s_lock_code[256] = {
 };
 
 static unsigned int s_flag = 0;
+
+/* Scan codes from the top half to the softirq. The top half only writes
+ * `s_scan_code_tail`, the softirq only writes `s_scan_code_head`. */
+static uint8_t s_scan_codes[SCAN_CODE_QUEUE_SIZE];
+static volatile uint32_t s_scan_code_head = 0;
+static volatile uint32_t s_scan_code_tail = 0;
 /**
  * @brief   These are the characters we have in the keyboard. The data sent from
  *          keyboard to the handler is not the data here. The data is called
@@ -83,32 +92,47 @@ static char s_shift_key_map[256] = {
  * 
  * @return char 
  */
-static char ReadCharacter(void);
+static char ReadCharacter(unsigned char scan_code);
 
 static void WriteKeyBuffer(char ch);
 
+/**
+ * @brief   Bottom half: decode the queued scan codes.
+ */
+static void KeyboardSoftirq(void);
+
 /* Public function -----------------------------------------------------------*/
-void KeyboardHandler(void)
+void InitKeyboard(void)
 {
-    char ch[2] = {0};
-    ch[0] = ReadCharacter();
-    if (ch[0] > 0) {
-        WriteKeyBuffer(ch[0]);
-        /* Wakeup the process waiting for the keyboard. */
-        Wakeup(WAITING_KEYBOARD_PROCESS_WAIT_ID);
+    OpenSoftirq(SOFTIRQ_KEYBOARD, KeyboardSoftirq);
+}
+
+void KeyboardInterrupt(void)
+{
+    /* We read scan code from port 0x60, the controller doesn't send the next
+     * one before that. If the queue is full, the key is lost. */
+    uint8_t scan_code = InByte(SENT_SCAN_CODE_PORT);
+
+    if (s_scan_code_tail - s_scan_code_head < SCAN_CODE_QUEUE_SIZE) {
+        s_scan_codes[s_scan_code_tail % SCAN_CODE_QUEUE_SIZE] = scan_code;
+        s_scan_code_tail++;
     }
+
+    RaiseSoftirq(SOFTIRQ_KEYBOARD);
 }
 
 char ReadKeyBuffer(void)
 {
-    int front = s_keyboard_controller.front;
+    int front = 0;
 
-    if (front == s_keyboard_controller.end) {
+    while (s_keyboard_controller.front == s_keyboard_controller.end) {
         /* When a program wants to read a key, and there is no key in the buffer
          * , we will put it into sleep. */
-        Sleep(WAITING_KEYBOARD_PROCESS_WAIT_ID);
+        Sleep(&s_keyboard_controller.wait_queue);
     }
 
+    front = s_keyboard_controller.front;
+
     s_keyboard_controller.front = (s_keyboard_controller.front + 1)
                                     % s_keyboard_controller.size;
 
@@ -116,13 +140,28 @@ char ReadKeyBuffer(void)
 }
 
 /* Private function ----------------------------------------------------------*/
-static char ReadCharacter(void)
+static void KeyboardSoftirq(void)
 {
-    unsigned char scan_code;
-    char c;
+    char ch = 0;
+
+    while (s_scan_code_head != s_scan_code_tail) {
+        ch = ReadCharacter(s_scan_codes[s_scan_code_head
+                                        % SCAN_CODE_QUEUE_SIZE]);
+        s_scan_code_head++;
+
+        if (ch > 0) {
+            WriteKeyBuffer(ch);
+            /* One key is enough for one reader, so we only wakeup the
+             * process which has been waiting for the keyboard for the
+             * longest time. */
+            WakeupOne(&s_keyboard_controller.wait_queue);
+        }
+    }
+}
 
-    /* We read scan code from port 0x60. */
-    scan_code = InByte(SENT_SCAN_CODE_PORT);
+static char ReadCharacter(unsigned char scan_code)
+{
+    char c;
 
     /* Multiple-byte code used for function keys which be sent one byte at a
      * time. Most of the multiple-byte key code comes with E0 first. So here we
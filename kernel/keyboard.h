@@ -2,5 +2,14 @@
 #include <stdint.h>
 
 /* Public function prototype -------------------------------------------------*/
-void KeyboardHandler(void);
+/**
+ * @brief       Set up the keyboard softirq.
+ */
+void InitKeyboard(void);
+
+/**
+ * @brief       Top half of the keyboard interrupt, it queues the scan code.
+ */
+void KeyboardInterrupt(void);
+
 char ReadKeyBuffer(void);
\ No newline at end of file
@@ -0,0 +1,159 @@
+#include <stddef.h>
+
+#include "lapic.h"
+#include "memory.h"
+#include "trap.h"
+#include "pit.h"
+#include "printk.h"
+
+/* Private define ------------------------------------------------------------*/
+#define IA32_APIC_BASE_MSR              0x1B
+#define IA32_APIC_BASE_ENABLE           (1 << 11)
+#define IA32_APIC_BASE_ADDRESS_MASK     0xFFFFFFFFFF000ULL
+#define CPUID_1_EDX_APIC                (1 << 9)
+
+#define LAPIC_REGISTERS_SIZE            0x1000
+#define LAPIC_ID                        0x020
+#define LAPIC_EOI                       0x0B0
+#define LAPIC_SPURIOUS                  0x0F0
+#define LAPIC_ERROR_STATUS              0x280
+#define LAPIC_LVT_TIMER                 0x320
+#define LAPIC_LVT_ERROR                 0x370
+#define LAPIC_TIMER_INITIAL_COUNT       0x380
+#define LAPIC_TIMER_CURRENT_COUNT       0x390
+#define LAPIC_TIMER_DIVIDE              0x3E0
+
+#define LAPIC_SOFTWARE_ENABLE           (1 << 8)
+#define LAPIC_LVT_MASKED                (1 << 16)
+#define LAPIC_TIMER_DIVIDE_BY_16        0x3
+#define LAPIC_ID_SHIFT                  24
+
+/* Private variable ----------------------------------------------------------*/
+static volatile uint32_t *s_lapic = NULL;
+static uint64_t s_timer_frequency = 0;
+
+/* Private function prototypes -----------------------------------------------*/
+static uint32_t ReadLAPIC(uint32_t reg);
+
+static void WriteLAPIC(uint32_t reg, uint32_t value);
+
+/**
+ * @brief   Count timer ticks for PIT_CALIBRATION_MS, measured by the PIT.
+ */
+static void CalibrateTimer(void);
+
+/* Public function -----------------------------------------------------------*/
+bool InitLAPIC(void)
+{
+    uint32_t regs[4] = {0};
+    uint64_t base = 0;
+
+    CPUID(1, 0, regs);
+    if ((regs[3] & CPUID_1_EDX_APIC) == 0) {
+        return false;
+    }
+
+    base = ReadMSR(IA32_APIC_BASE_MSR);
+    WriteMSR(IA32_APIC_BASE_MSR, base | IA32_APIC_BASE_ENABLE);
+
+    s_lapic = (volatile uint32_t *)MapMMIO(base & IA32_APIC_BASE_ADDRESS_MASK,
+                                           LAPIC_REGISTERS_SIZE);
+    if (s_lapic == NULL) {
+        return false;
+    }
+
+    WriteLAPIC(LAPIC_SPURIOUS, LAPIC_SOFTWARE_ENABLE | LAPIC_SPURIOUS_VECTOR);
+
+    /* Errors of the APIC (illegal vectors, lost messages) raise an interrupt.
+     * The error status register is updated by a write, clear the old errors
+     * before unmasking. */
+    WriteLAPIC(LAPIC_ERROR_STATUS, 0);
+    WriteLAPIC(LAPIC_ERROR_STATUS, 0);
+    WriteLAPIC(LAPIC_LVT_ERROR, LAPIC_ERROR_VECTOR);
+
+    WriteLAPIC(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_BY_16);
+
+    CalibrateTimer();
+
+    /* One-shot mode is mode 0 of the LVT timer register. */
+    WriteLAPIC(LAPIC_LVT_TIMER, LAPIC_TIMER_VECTOR);
+
+    printk("LAPIC timer: %uKHz.\n", s_timer_frequency / 1000);
+
+    return true;
+}
+
+bool LAPICIsEnabled(void)
+{
+    return s_lapic != NULL;
+}
+
+uint8_t LAPICGetID(void)
+{
+    return (uint8_t)(ReadLAPIC(LAPIC_ID) >> LAPIC_ID_SHIFT);
+}
+
+void LAPICEOI(void)
+{
+    WriteLAPIC(LAPIC_EOI, 0);
+}
+
+void LAPICErrorInterrupt(void)
+{
+    uint32_t status = 0;
+
+    /* Latch the errors into the register, then read them. */
+    WriteLAPIC(LAPIC_ERROR_STATUS, 0);
+    status = ReadLAPIC(LAPIC_ERROR_STATUS);
+
+    printk("LAPIC error: %x.\n", status);
+
+    LAPICEOI();
+}
+
+void LAPICTimerOneShot(uint32_t count)
+{
+    WriteLAPIC(LAPIC_TIMER_INITIAL_COUNT, count);
+}
+
+uint32_t LAPICTimerCurrentCount(void)
+{
+    return ReadLAPIC(LAPIC_TIMER_CURRENT_COUNT);
+}
+
+uint64_t LAPICTimerFrequency(void)
+{
+    return s_timer_frequency;
+}
+
+/* Private function ----------------------------------------------------------*/
+static uint32_t ReadLAPIC(uint32_t reg)
+{
+    return s_lapic[reg / sizeof(uint32_t)];
+}
+
+static void WriteLAPIC(uint32_t reg, uint32_t value)
+{
+    s_lapic[reg / sizeof(uint32_t)] = value;
+}
+
+static void CalibrateTimer(void)
+{
+    PITCalibrationPrepare();
+
+    /* Mask the timer, so the calibration doesn't fire an interrupt. */
+    WriteLAPIC(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED | LAPIC_TIMER_VECTOR);
+
+    /* Start both counters. */
+    PITCalibrationStart();
+    WriteLAPIC(LAPIC_TIMER_INITIAL_COUNT, LAPIC_TIMER_MAXIMUM_COUNT);
+
+    PITCalibrationWait();
+
+    s_timer_frequency = (uint64_t)(LAPIC_TIMER_MAXIMUM_COUNT
+                                   - ReadLAPIC(LAPIC_TIMER_CURRENT_COUNT))
+                        * (1000 / PIT_CALIBRATION_MS);
+
+    /* Stop the timer. */
+    WriteLAPIC(LAPIC_TIMER_INITIAL_COUNT, 0);
+}
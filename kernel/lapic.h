@@ -0,0 +1,77 @@
+/**
+ * @file    lapic.h
+ * @author  Cong Nguyen (congnt264@gmail.com)
+ * @brief   Local APIC driver. Each CPU has a local APIC, it receives interrupts
+ *          for the CPU (from the I/O APIC and other CPUs) and has a timer. We use the timer in one-shot mode: it
+ *          counts down from the initial count once and fires one interrupt, so
+ *          the timer code can program the exact time of the next event instead
+ *          of taking a periodic tick.
+ *
+ *          The timer frequency is not architectural, it is calibrated against
+ *          channel 2 of the PIT, the channel which is not connected to an IRQ.
+ *
+ * @version 0.1
+ * @date 2023-09-20
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Public define -------------------------------------------------------------*/
+#define LAPIC_TIMER_VECTOR          32
+#define LAPIC_ERROR_VECTOR          0xFE
+#define LAPIC_SPURIOUS_VECTOR       0xFF
+#define LAPIC_TIMER_MAXIMUM_COUNT   0xFFFFFFFF
+
+/* Public function prototype -------------------------------------------------*/
+/**
+ * @brief       Enable the local APIC of the current CPU and calibrate its
+ *              timer. The timer is stopped after this.
+ *
+ * @return      true        - The local APIC is ready.
+ * @return      false       - The CPU has no local APIC.
+ */
+bool InitLAPIC(void);
+
+/**
+ * @brief       Check the local APIC of the current CPU is enabled.
+ */
+bool LAPICIsEnabled(void);
+
+/**
+ * @brief       Get the local APIC ID of the current CPU, interrupts are sent to
+ *              a CPU by this ID.
+ */
+uint8_t LAPICGetID(void);
+
+/**
+ * @brief       Send end of interrupt to the local APIC. It is a register write,
+ *              no port I/O.
+ */
+void LAPICEOI(void);
+
+/**
+ * @brief       Handle LAPIC_ERROR_VECTOR: report and clear the error status.
+ */
+void LAPICErrorInterrupt(void);
+
+/**
+ * @brief       Start the timer in one-shot mode, it fires LAPIC_TIMER_VECTOR
+ *              after `count` timer ticks. A new count replaces the running one.
+ *
+ * @param[in]   count       - Number of timer ticks, non-zero.
+ */
+void LAPICTimerOneShot(uint32_t count);
+
+/**
+ * @brief       Get the remaining count of the timer, zero if it has fired.
+ */
+uint32_t LAPICTimerCurrentCount(void);
+
+/**
+ * @brief       Number of timer ticks per second, it is measured in InitLAPIC().
+ */
+uint64_t LAPICTimerFrequency(void);
@@ -8,6 +8,15 @@
 #include "process.h"
 #include "syscall.h"
 #include "file.h"
+#include "fpu.h"
+#include "workqueue.h"
+#include "timer.h"
+#include "ioapic.h"
+#include "keyboard.h"
+#include "clock.h"
+#include "ioring.h"
+#include "preempt.h"
+#include "bcache.h"
 
 void KMain(void)
 {
@@ -15,8 +24,22 @@ void KMain(void)
     printk("Retrieve memory map:\n");
     RetrieveMemoryInfo();
     InitMemory();
-    InitFileSystem();
+    InitFPU();
+    InitTimer();
+    InitIOAPIC();
+    InitKeyboard();
+    InitClock();
+    InitBufferCache();
+    if (InitFileSystem() < 0) {
+        printk("Failed to index the file system, some files are missing.\n");
+    }
     InitSystemCall();
     InitProcess();
+    InitWorkQueue();
+    InitIORing();
     printk("Finished kernel initialization. Welcome to LARVA-OS.\n");
+
+    /* The boot code is done, we become the IDLE process, and the scheduler can
+     * preempt the kernel from now. */
+    PreemptEnable();
 }
\ No newline at end of file
@@ -1,8 +1,10 @@
 #include <stddef.h>
 #include <string.h>
 #include "memory.h"
+#include "slab.h"
 #include "printk.h"
 #include "assert.h"
+#include "preempt.h"
 
 /* Private define ------------------------------------------------------------*/
 #define MEMORY_MAX_FREE_REGIONS                 50
@@ -16,6 +18,14 @@
 #define MEMORY_REGION_COUNT_BASE_ADDR           0x9000
 #define MEMORY_REGION_STRUCTURES_BASE_ADDR      0x9008
 
+/* Tables of the 4KB page mappings are 4KB also. */
+#define PAGE_TABLE_SIZE                         SMALL_PAGE_SIZE
+#define KERNEL_STACK_POISON                     0x57A0C4ED57A0C4ED
+
+/* Clearing or copying a 2MB page takes long, it is done in chunks of this size
+ * with a preemption point between them. */
+#define MEMORY_PREEMPT_CHUNK_SIZE               (64 * 1024)
+
 /* Private variable ----------------------------------------------------------*/
 static FreeMemoryRegion s_free_memory_regions[MEMORY_MAX_FREE_REGIONS];
 extern char l_kernel_end;
@@ -23,6 +33,16 @@ static Page s_free_memory_page_head;
 static uint64_t s_free_memory_end_address = 0;
 static uint64_t s_total_mem = 0;
 
+static SlabCache s_page_table_cache;            /* 4KB paging tables.     */
+static SlabCache s_kernel_stack_cache;          /* Kernel stack memory.   */
+static PageDirPointerTable s_kernel_stack_pdpt; /* Shared by all maps.    */
+static PageDirPointerTable s_mmio_pdpt;         /* Shared by all maps.    */
+static uint64_t s_mmio_next = MMIO_AREA_BASE;   /* Never mapped MMIO.     */
+static PageDirPointerTable s_user_shared_pdpt;  /* Shared by all maps.    */
+static HeadList s_free_kernel_stacks;           /* Mapped, not used.      */
+static uint64_t s_kernel_stack_next_slot = 0;   /* Never mapped slots.    */
+static uint64_t s_kernel_stack_high_water_mark = 0;
+
 /* Private function prototypes -----------------------------------------------*/
 static void FreeRegion(uint64_t v_start, uint64_t v_end);
 
@@ -86,6 +106,30 @@ static void FreePDTable(uint64_t map);
 
 static void FreePDPTable(uint64_t map);
 
+static void InitKernelStackRegion(void);
+
+/**
+ * @brief   Allocate a zero-filled 4KB paging table.
+ *
+ * @return  Virtual address of the table, NULL if failed.
+ */
+static void *AllocPageTable(void);
+
+/**
+ * @brief   Map a 4KB page in a shared region (kernel stacks, MMIO), the mapping
+ *          is seen by every page map, because they share the region's PDPT.
+ *
+ * @param pdpt          - Page directory pointer table of the region.
+ * @param v             - Virtual address, in the region.
+ * @param phys          - Physical address.
+ * @param attr          - Page attributes.
+ * @return true if success.
+ */
+static bool MapSharedPage(PageDirPointerTable pdpt,
+                          uint64_t v,
+                          uint64_t phys,
+                          uint64_t attr);
+
 /* Public function -----------------------------------------------------------*/
 void RetrieveMemoryInfo(void)
 {
@@ -146,6 +190,9 @@ void RetrieveMemoryInfo(void)
 
 void InitMemory(void)
 {
+    /* The kernel stack region must exist before we setup any page map. */
+    InitKernelStackRegion();
+
     uint64_t kernel_map = SetupKVM();
     ASSERT(kernel_map);
 
@@ -184,7 +231,7 @@ bool SetupUVM(uint64_t map, uint64_t start_location, int size)
         return false;
     }
 
-    memset(page, 0, PAGE_SIZE);
+    ZeroMemory(page, PAGE_SIZE);
 
     /* 2. Map the page to user virtual address. */
     status = MapPages(map,
@@ -244,7 +291,7 @@ uint64_t SetupKVM(void)
     uint64_t kernel_page_map = (uint64_t)kalloc();
 
     if (kernel_page_map != 0) {
-        memset((void *)kernel_page_map, 0, PAGE_SIZE);
+        ZeroMemory((void *)kernel_page_map, PAGE_SIZE);
 
         /* Map the kernel to the same physical address. */
         bool status =
@@ -257,6 +304,22 @@ uint64_t SetupKVM(void)
         if (!status) {
             FreeVM(kernel_page_map);
             kernel_page_map = 0;
+        } else {
+            /* All page maps share the same kernel stack, MMIO and user
+             * shared regions. */
+            ((PageDirPointerTable *)kernel_page_map)[KERNEL_STACK_PML4_INDEX] =
+                (PageDirPointerTable)(VIR_TO_PHY(s_kernel_stack_pdpt)
+                                      | TABLE_ENTRY_PRESENT_ATTRIBUTE
+                                      | TABLE_ENTRY_WRITABLE_ATTRIBUTE);
+            ((PageDirPointerTable *)kernel_page_map)[MMIO_PML4_INDEX] =
+                (PageDirPointerTable)(VIR_TO_PHY(s_mmio_pdpt)
+                                      | TABLE_ENTRY_PRESENT_ATTRIBUTE
+                                      | TABLE_ENTRY_WRITABLE_ATTRIBUTE);
+            ((PageDirPointerTable *)kernel_page_map)[USER_SHARED_PML4_INDEX] =
+                (PageDirPointerTable)(VIR_TO_PHY(s_user_shared_pdpt)
+                                      | TABLE_ENTRY_PRESENT_ATTRIBUTE
+                                      | TABLE_ENTRY_WRITABLE_ATTRIBUTE
+                                      | TABLE_ENTRY_USER_ATTRIBUTE);
         }
     }
 
@@ -268,6 +331,197 @@ uint64_t GetTotalMem(void)
     return s_total_mem;
 }
 
+bool IsUserRange(uint64_t addr, uint64_t size)
+{
+    /* Every process has one user page. */
+    uint64_t end = USER_VIRTUAL_ADDRESS_BASE + PAGE_SIZE;
+
+    return addr >= USER_VIRTUAL_ADDRESS_BASE
+           && addr < end
+           && size <= end - addr;
+}
+
+uint64_t UserToKernelAddress(uint64_t map, uint64_t addr, uint64_t size)
+{
+    unsigned int index = (USER_VIRTUAL_ADDRESS_BASE >> 21) & 0x1FF;
+    PageDir pd = NULL;
+
+    if (!IsUserRange(addr, size)) {
+        return 0;
+    }
+
+    /* The user memory is one 2MB page, so the buffer is contiguous in the
+     * kernel mapping of the physical memory too. */
+    pd = FindPageDirPointerTableEntry(map, USER_VIRTUAL_ADDRESS_BASE, 0, 0);
+    if (pd == NULL || (pd[index] & TABLE_ENTRY_PRESENT_ATTRIBUTE) == 0) {
+        return 0;
+    }
+
+    return PHY_TO_VIR(PAGE_ADDRESS(pd[index]))
+           + (addr - USER_VIRTUAL_ADDRESS_BASE);
+}
+
+bool IsUserString(const char *str)
+{
+    uint64_t end = USER_VIRTUAL_ADDRESS_BASE + PAGE_SIZE;
+
+    if (!IsUserRange((uint64_t)str, 1)) {
+        return false;
+    }
+
+    for (; (uint64_t)str < end; str++) {
+        if (*str == '\0') {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+uint64_t AllocKernelStack(void)
+{
+    uint64_t stack = 0;
+    uint64_t phys = 0;
+
+    if (!ListIsEmpty(&s_free_kernel_stacks)) {
+        /* Reuse a stack which is mapped already. */
+        stack = (uint64_t)ListPopFront(&s_free_kernel_stacks);
+    } else if (s_kernel_stack_next_slot < KERNEL_STACK_MAX_COUNT) {
+        void *memory = SlabAlloc(&s_kernel_stack_cache);
+        if (memory == NULL) {
+            return 0;
+        }
+
+        /* Skip the guard page at the bottom of the slot, it is never mapped. */
+        stack = KERNEL_STACK_AREA_BASE
+                + s_kernel_stack_next_slot * KERNEL_STACK_SLOT_SIZE
+                + KERNEL_STACK_GUARD_SIZE;
+        phys = VIR_TO_PHY(memory);
+
+        for (uint64_t offset = 0;
+             offset < KERNEL_STACK_SIZE;
+             offset += SMALL_PAGE_SIZE) {
+
+            if (!MapSharedPage(s_kernel_stack_pdpt,
+                               stack + offset,
+                               phys + offset,
+                               TABLE_ENTRY_PRESENT_ATTRIBUTE
+                               | TABLE_ENTRY_WRITABLE_ATTRIBUTE)) {
+                /* Stale mappings of this slot are overwritten by the next
+                 * allocation of the slot. */
+                SlabFree(&s_kernel_stack_cache, memory);
+                return 0;
+            }
+        }
+
+        s_kernel_stack_next_slot++;
+    } else {
+        return 0;
+    }
+
+    /* Fill the stack with poison, so we can find the deepest used address. */
+    for (uint64_t *p = (uint64_t *)stack;
+         p < (uint64_t *)(stack + KERNEL_STACK_SIZE);
+         p++) {
+        *p = KERNEL_STACK_POISON;
+    }
+
+    return stack;
+}
+
+void FreeKernelStack(uint64_t stack)
+{
+    uint64_t *p = (uint64_t *)stack;
+    uint64_t used = 0;
+
+    ASSERT(stack >= KERNEL_STACK_AREA_BASE && stack < KERNEL_STACK_AREA_END);
+    ASSERT(!IsKernelStackGuard(stack));
+
+    /* The stack grows downward, the first overwritten poison from the bottom
+     * is the deepest usage of the stack. */
+    while (p < (uint64_t *)(stack + KERNEL_STACK_SIZE)
+           && *p == KERNEL_STACK_POISON) {
+        p++;
+    }
+
+    used = stack + KERNEL_STACK_SIZE - (uint64_t)p;
+    if (used > s_kernel_stack_high_water_mark) {
+        s_kernel_stack_high_water_mark = used;
+    }
+
+    ListPushBack(&s_free_kernel_stacks, (List *)stack);
+}
+
+bool IsKernelStackGuard(uint64_t addr)
+{
+    if (addr < KERNEL_STACK_AREA_BASE || addr >= KERNEL_STACK_AREA_END) {
+        return false;
+    }
+
+    return (addr - KERNEL_STACK_AREA_BASE) % KERNEL_STACK_SLOT_SIZE
+           < KERNEL_STACK_GUARD_SIZE;
+}
+
+uint64_t MapMMIO(uint64_t phys, uint64_t size)
+{
+    uint64_t offset = phys & (SMALL_PAGE_SIZE - 1);
+    uint64_t start = phys - offset;
+    uint64_t end = (phys + size + SMALL_PAGE_SIZE - 1)
+                   & ~(uint64_t)(SMALL_PAGE_SIZE - 1);
+    uint64_t v = s_mmio_next;
+
+    if (v + (end - start) > MMIO_AREA_BASE + MMIO_AREA_SIZE) {
+        return 0;
+    }
+
+    for (uint64_t p = start; p < end; p += SMALL_PAGE_SIZE) {
+        if (!MapSharedPage(s_mmio_pdpt,
+                           v + (p - start),
+                           p,
+                           TABLE_ENTRY_PRESENT_ATTRIBUTE
+                           | TABLE_ENTRY_WRITABLE_ATTRIBUTE
+                           | TABLE_ENTRY_WRITE_THROUGH_ATTRIBUTE
+                           | TABLE_ENTRY_CACHE_DISABLE_ATTRIBUTE)) {
+            return 0;
+        }
+    }
+
+    s_mmio_next += end - start;
+
+    return v + offset;
+}
+
+uint64_t MapUserSharedPage(uint64_t v)
+{
+    void *page = NULL;
+
+    ASSERT(v >= USER_SHARED_AREA_BASE
+           && v < USER_SHARED_AREA_BASE + USER_SHARED_AREA_SIZE
+           && (v & (SMALL_PAGE_SIZE - 1)) == 0);
+
+    page = AllocPageTable();
+    if (page == NULL) {
+        return 0;
+    }
+
+    /* No writable bit, user programs can only read the page. */
+    if (!MapSharedPage(s_user_shared_pdpt,
+                       v,
+                       VIR_TO_PHY(page),
+                       TABLE_ENTRY_PRESENT_ATTRIBUTE
+                       | TABLE_ENTRY_USER_ATTRIBUTE)) {
+        SlabFree(&s_page_table_cache, page);
+        return 0;
+    }
+
+    return (uint64_t)page;
+}
+
+uint64_t GetKernelStackHighWaterMark(void)
+{
+    return s_kernel_stack_high_water_mark;
+}
+
 bool CopyUVM(uint64_t new_page, uint64_t current_page, int size)
 {
     bool status = false;
@@ -277,7 +531,6 @@ bool CopyUVM(uint64_t new_page, uint64_t current_page, int size)
 
     void * page = kalloc();
     if (page != NULL) {
-        memset(page, 0, PAGE_SIZE);
         status = MapPages(new_page,
                             USER_VIRTUAL_ADDRESS_BASE,
                             USER_VIRTUAL_ADDRESS_BASE + PAGE_SIZE,
@@ -298,7 +551,8 @@ bool CopyUVM(uint64_t new_page, uint64_t current_page, int size)
 
                 start = PHY_TO_VIR(PAGE_ADDRESS(pd[index]));
 
-                memcpy(page, (void*)start, size);
+                CopyMemory(page, (void*)start, size);
+                ZeroMemory((char *)page + size, PAGE_SIZE - size);
             } else {
                 kfree((uint64_t)page);
                 FreeVM(new_page);
@@ -314,6 +568,61 @@ bool CopyUVM(uint64_t new_page, uint64_t current_page, int size)
     return status;
 }
 
+uint64_t MapUserPage(uint64_t map)
+{
+    void *page = kalloc();
+    if (page == NULL) {
+        return 0;
+    }
+
+    if (!MapPages(map,
+                  USER_VIRTUAL_ADDRESS_BASE,
+                  USER_VIRTUAL_ADDRESS_BASE + PAGE_SIZE,
+                  VIR_TO_PHY(page),
+                  TABLE_ENTRY_PRESENT_ATTRIBUTE
+                  | TABLE_ENTRY_WRITABLE_ATTRIBUTE
+                  | TABLE_ENTRY_USER_ATTRIBUTE)) {
+        kfree((uint64_t)page);
+        return 0;
+    }
+
+    return (uint64_t)page;
+}
+
+void ZeroMemory(void *addr, uint64_t size)
+{
+    char *p = (char *)addr;
+    uint64_t chunk = 0;
+
+    while (size > 0) {
+        chunk = size < MEMORY_PREEMPT_CHUNK_SIZE ? size
+                                                 : MEMORY_PREEMPT_CHUNK_SIZE;
+        memset(p, 0, chunk);
+        p += chunk;
+        size -= chunk;
+
+        PreemptionPoint();
+    }
+}
+
+void CopyMemory(void *dst, const void *src, uint64_t size)
+{
+    char *d = (char *)dst;
+    const char *s = (const char *)src;
+    uint64_t chunk = 0;
+
+    while (size > 0) {
+        chunk = size < MEMORY_PREEMPT_CHUNK_SIZE ? size
+                                                 : MEMORY_PREEMPT_CHUNK_SIZE;
+        memcpy(d, s, chunk);
+        d += chunk;
+        s += chunk;
+        size -= chunk;
+
+        PreemptionPoint();
+    }
+}
+
 /* Private function ----------------------------------------------------------*/
 static void FreeRegion(uint64_t v_start, uint64_t v_end)
 {
@@ -465,6 +774,13 @@ static void FreePDTable(uint64_t map)
 
     /* Each memory map have 512 page directory pointer tables. */
     for (int i = 0; i < TOTAL_PAGE_DIR_POINTER_TABLE; i++) {
+        if (i == KERNEL_STACK_PML4_INDEX
+            || i == MMIO_PML4_INDEX
+            || i == USER_SHARED_PML4_INDEX) {
+            /* The shared regions are never freed. */
+            continue;
+        }
+
         if ((uint64_t)map_entry[i] & TABLE_ENTRY_PRESENT_ATTRIBUTE) {
             PageDir *pdptr = (PageDir *)
                          PHY_TO_VIR(PAGE_DIRECTORY_TABLE_ADDRESS(map_entry[i]));
@@ -485,9 +801,88 @@ static void FreePDPTable(uint64_t map)
 {
     PageDirPointerTable *map_entry = (PageDirPointerTable *)map;
     for (int i = 0; i < TOTAL_PAGE_DIR_POINTER_TABLE; i++) {
+        if (i == KERNEL_STACK_PML4_INDEX
+            || i == MMIO_PML4_INDEX
+            || i == USER_SHARED_PML4_INDEX) {
+            map_entry[i] = 0;
+            continue;
+        }
+
         if ((uint64_t)map_entry[i] & TABLE_ENTRY_PRESENT_ATTRIBUTE) {
             kfree(PHY_TO_VIR(PAGE_DIRECTORY_TABLE_ADDRESS(map_entry[i])));
             map_entry[i] = 0;
         }
     }
+}
+
+static void InitKernelStackRegion(void)
+{
+    InitSlabCache(&s_page_table_cache, PAGE_TABLE_SIZE);
+    InitSlabCache(&s_kernel_stack_cache, KERNEL_STACK_SIZE);
+
+    s_kernel_stack_pdpt = (PageDirPointerTable)AllocPageTable();
+    ASSERT(s_kernel_stack_pdpt != NULL);
+
+    s_mmio_pdpt = (PageDirPointerTable)AllocPageTable();
+    ASSERT(s_mmio_pdpt != NULL);
+
+    s_user_shared_pdpt = (PageDirPointerTable)AllocPageTable();
+    ASSERT(s_user_shared_pdpt != NULL);
+}
+
+static void *AllocPageTable(void)
+{
+    void *table = SlabAlloc(&s_page_table_cache);
+
+    if (table != NULL) {
+        memset(table, 0, PAGE_TABLE_SIZE);
+    }
+
+    return table;
+}
+
+static bool MapSharedPage(PageDirPointerTable pdpt,
+                          uint64_t v,
+                          uint64_t phys,
+                          uint64_t attr)
+{
+    PageDir pd = NULL;
+    PageDirEntry *pt = NULL;
+    unsigned int pdpt_index = (v >> 30) & 0x1FF;
+    unsigned int pd_index = (v >> 21) & 0x1FF;
+    unsigned int pt_index = (v >> 12) & 0x1FF;
+    /* The user bit has to be set in every level for a user page. */
+    uint64_t table_attr = TABLE_ENTRY_PRESENT_ATTRIBUTE
+                          | TABLE_ENTRY_WRITABLE_ATTRIBUTE
+                          | (attr & TABLE_ENTRY_USER_ATTRIBUTE);
+
+    /* Page directory pointer table entry -> page directory. */
+    if ((uint64_t)pdpt[pdpt_index] & TABLE_ENTRY_PRESENT_ATTRIBUTE) {
+        pd = (PageDir)PHY_TO_VIR(
+                PAGE_DIRECTORY_TABLE_ADDRESS(pdpt[pdpt_index]));
+    } else {
+        pd = (PageDir)AllocPageTable();
+        if (pd == NULL) {
+            return false;
+        }
+        pdpt[pdpt_index] = (PageDir)(VIR_TO_PHY(pd) | table_attr);
+    }
+
+    /* Page directory entry -> page table, the entry bit is not set, so this
+     * entry points to a table of 4KB pages instead of a 2MB page. */
+    if (pd[pd_index] & TABLE_ENTRY_PRESENT_ATTRIBUTE) {
+        pt = (PageDirEntry *)PHY_TO_VIR(PAGE_TABLE_ADDRESS(pd[pd_index]));
+    } else {
+        pt = (PageDirEntry *)AllocPageTable();
+        if (pt == NULL) {
+            return false;
+        }
+        pd[pd_index] = (PageDirEntry)(VIR_TO_PHY(pt) | table_attr);
+    }
+
+    /* Page table entry -> 4KB physical page. A page which is mapped already
+     * belongs to this slot from an earlier failed allocation. */
+    pt[pt_index] = (PageDirEntry)(phys | attr);
+
+    return true;
 }
\ No newline at end of file
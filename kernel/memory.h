@@ -133,6 +133,33 @@
 #define PHYSICAL_MEMORY_SIZE        0x40000000    /* 1GB. TODO: extend RAM.   */
 #define VIRTUAL_ADDRESS_END         (KERNEL_VIRTUAL_ADDRESS_BASE + \
                                      PHYSICAL_MEMORY_SIZE)
+#define SMALL_PAGE_SIZE             (4 * 1024)          /* 4KB.               */
+
+/**
+ * @def Kernel stacks don't live in the kernel heap, they are mapped with 4KB
+ * pages in their own region, the region is shared by every page map. Each slot
+ * of the region is a guard page that is never mapped, followed by the stack.
+ * So a kernel stack overflow hits the guard page and causes a page fault
+ * instead of silently overwriting memory.
+ */
+#define KERNEL_STACK_SIZE           (16 * 1024)         /* 16KB.              */
+#define KERNEL_STACK_GUARD_SIZE     SMALL_PAGE_SIZE
+#define KERNEL_STACK_SLOT_SIZE      (KERNEL_STACK_GUARD_SIZE + KERNEL_STACK_SIZE)
+#define KERNEL_STACK_AREA_BASE      0xFFFFFF0000000000
+#define KERNEL_STACK_MAX_COUNT      (128 * 1024)
+#define KERNEL_STACK_AREA_END       (KERNEL_STACK_AREA_BASE + \
+                                     (uint64_t)KERNEL_STACK_MAX_COUNT * \
+                                     KERNEL_STACK_SLOT_SIZE)
+
+/* Device registers (LAPIC, IOAPIC, etc.) are mapped in this region of every
+ * page map, with caching disabled. */
+#define MMIO_AREA_BASE              0xFFFFFE8000000000
+#define MMIO_AREA_SIZE              (1024 * 1024 * 1024)  /* 1GB.             */
+
+/* Pages the kernel shares read-only with every user address space (the time
+ * page) are mapped in this region of the lower half. */
+#define USER_SHARED_AREA_BASE       0x7F8000000000
+#define USER_SHARED_AREA_SIZE       (1024 * 1024 * 1024)  /* 1GB.             */
 /**
  * @def Macro align the address to the next 2MB boundary if it is not align. We
  * simply add a page size and shift right 21 bits and then shift left. Which
@@ -157,6 +184,8 @@
 #define TABLE_ENTRY_PRESENT_ATTRIBUTE       BIT(0)
 #define TABLE_ENTRY_WRITABLE_ATTRIBUTE      BIT(1)
 #define TABLE_ENTRY_USER_ATTRIBUTE          BIT(2)
+#define TABLE_ENTRY_WRITE_THROUGH_ATTRIBUTE BIT(3)
+#define TABLE_ENTRY_CACHE_DISABLE_ATTRIBUTE BIT(4)
 #define TABLE_ENTRY_ENTRY_ATTRIBUTE         BIT(7)
 
 /**
@@ -166,6 +195,7 @@
 #define PAGE_DIRECTORY_POINTER_TABLE_ADDRESS(p)     (((uint64_t)p >> 12) << 12)
 #define PAGE_DIRECTORY_TABLE_ADDRESS(p)             (((uint64_t)p >> 12) << 12)
 #define PAGE_ADDRESS(p)                             (((uint64_t)p >> 21) << 21)
+#define PAGE_TABLE_ADDRESS(p)                       (((uint64_t)p >> 12) << 12)
 
 #define ADDR_IS_ALIGNED(a)              (((uint64_t)a % PAGE_SIZE) == 0)
 #define ASSERT_ADDR_IS_ALIGNED(a)       ASSERT(ADDR_IS_ALIGNED(a))
@@ -175,6 +205,12 @@
 /* Each PDP table also include 512 entries which point to page directory tables.
  */
 #define TOTAL_PAGE_DIR_TABLE_OF_EACH_PDPT           512
+/* The kernel stack region uses this entry of every PML4 table. */
+#define KERNEL_STACK_PML4_INDEX     ((KERNEL_STACK_AREA_BASE >> 39) & 0x1FF)
+/* The MMIO region uses this entry of every PML4 table. */
+#define MMIO_PML4_INDEX             ((MMIO_AREA_BASE >> 39) & 0x1FF)
+/* The user shared region uses this entry of every PML4 table. */
+#define USER_SHARED_PML4_INDEX      ((USER_SHARED_AREA_BASE >> 39) & 0x1FF)
 
 /* Public type ---------------------------------------------------------------*/
 /**
@@ -248,6 +284,16 @@ uint64_t SetupKVM(void);
 
 bool CopyUVM(uint64_t new_page, uint64_t current_page, int size);
 
+/**
+ * @brief Allocate a user page and map it to the user virtual address of the
+ *        page map. The page is not cleared, the caller fills it. On failure
+ *        the page map is left as it is.
+ * 
+ * @param map           - Page map level 4 table.
+ * @return uint64_t     - Kernel virtual address of the page, 0 if failed.
+ */
+uint64_t MapUserPage(uint64_t map);
+
 void FreeVM(uint64_t map);
 
 void kfree(uint64_t addr);
@@ -261,4 +307,107 @@ void kfree(uint64_t addr);
  */
 void* kalloc(void);
 
-uint64_t GetTotalMem(void);
\ No newline at end of file
+uint64_t GetTotalMem(void);
+
+/**
+ * @brief Check that a buffer a system call got from user mode is in the user
+ *        memory of the process, so the kernel doesn't read or write kernel
+ *        memory on behalf of the user.
+ *
+ * @param addr          - User address.
+ * @param size          - Size in bytes.
+ * @return bool         - true if the whole buffer is user memory.
+ */
+bool IsUserRange(uint64_t addr, uint64_t size);
+
+/**
+ * @brief Check that a string from user mode ends before the end of the user
+ *        memory.
+ *
+ * @param str           - User string.
+ * @return bool         - true if the string and its null terminator are user
+ *                        memory.
+ */
+bool IsUserString(const char *str);
+
+/**
+ * @brief Get the kernel address of a user buffer of a page map, so the kernel
+ *        can reach it while another page map is loaded (in a kernel thread).
+ *
+ * @param map           - Page map of the user process.
+ * @param addr          - User address.
+ * @param size          - Size in bytes.
+ * @return uint64_t     - Kernel address of `addr`, 0 if the buffer is not user
+ *                        memory.
+ */
+uint64_t UserToKernelAddress(uint64_t map, uint64_t addr, uint64_t size);
+
+/**
+ * @brief Allocate a kernel stack (KERNEL_STACK_SIZE bytes) in the kernel stack
+ *        region. The page below the stack is a guard page which is not mapped.
+ *        The stack is filled with a poison pattern, that is used to measure
+ *        the deepest usage of the stack when it is freed.
+ *
+ * @return uint64_t     - Lowest address of the stack, the stack top is this
+ *                        address + KERNEL_STACK_SIZE.
+ *                      - 0 if failed.
+ */
+uint64_t AllocKernelStack(void);
+
+/**
+ * @brief Give the kernel stack back to the kernel stack allocator, and update
+ *        the stack high-water mark.
+ *
+ * @param stack         - Lowest address of the stack.
+ */
+void FreeKernelStack(uint64_t stack);
+
+/**
+ * @brief Check the address is in a guard page of the kernel stack region.
+ */
+bool IsKernelStackGuard(uint64_t addr);
+
+/**
+ * @brief Get the deepest kernel stack usage in bytes, of all freed stacks.
+ */
+uint64_t GetKernelStackHighWaterMark(void);
+
+/**
+ * @brief Map device registers to the MMIO region, the mapping is uncached and
+ *        is seen by every page map.
+ *
+ * @param phys          - Physical address of the registers.
+ * @param size          - Size of the registers in bytes.
+ * @return uint64_t     - Virtual address of `phys`, 0 if failed.
+ */
+uint64_t MapMMIO(uint64_t phys, uint64_t size);
+
+/**
+ * @brief Allocate a zeroed 4KB page and map it read-only at `v` of every user
+ *        address space. The kernel writes the page through the returned
+ *        address.
+ *
+ * @param v             - 4KB aligned address in the user shared region.
+ * @return uint64_t     - Kernel address of the page, 0 if failed.
+ */
+uint64_t MapUserSharedPage(uint64_t v);
+
+/**
+ * @brief Clear memory in chunks with a preemption point between them, for big
+ *        areas such as a 2MB page. The caller must not keep shared state half
+ *        updated, or must disable preemption.
+ *
+ * @param addr          - Start address.
+ * @param size          - Size in bytes.
+ */
+void ZeroMemory(void *addr, uint64_t size);
+
+/**
+ * @brief Copy memory in chunks with a preemption point between them, like
+ *        ZeroMemory().
+ *
+ * @param dst           - Destination address.
+ * @param src           - Source address.
+ * @param size          - Size in bytes.
+ */
+void CopyMemory(void *dst, const void *src, uint64_t size);
\ No newline at end of file
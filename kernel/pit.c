@@ -0,0 +1,43 @@
+#include "pit.h"
+#include "io.h"
+
+/* Private define ------------------------------------------------------------*/
+/* PIT channel 2 is gated by bit 0 of port 0x61, its output is bit 5. */
+#define PIT_FREQUENCY                   1193182
+#define PIT_CHANNEL_2_DATA              0x42
+#define PIT_COMMAND                     0x43
+#define PIT_CHANNEL_2_ONE_SHOT          0xB0    /* Channel 2, lo/hi, mode 0.  */
+#define PIT_CHANNEL_2_GATE_PORT         0x61
+#define PIT_CHANNEL_2_GATE              (1 << 0)
+#define PIT_SPEAKER                     (1 << 1)
+#define PIT_CHANNEL_2_OUTPUT            (1 << 5)
+
+/* Private variable ----------------------------------------------------------*/
+static uint8_t s_gate = 0;
+
+/* Public function -----------------------------------------------------------*/
+void PITCalibrationPrepare(void)
+{
+    uint16_t pit_count = PIT_FREQUENCY / (1000 / PIT_CALIBRATION_MS);
+
+    /* Disable the speaker, close the gate while we load the count. */
+    s_gate = InByte(PIT_CHANNEL_2_GATE_PORT);
+    s_gate &= ~(PIT_SPEAKER | PIT_CHANNEL_2_GATE);
+    OutByte(PIT_CHANNEL_2_GATE_PORT, s_gate);
+
+    OutByte(PIT_COMMAND, PIT_CHANNEL_2_ONE_SHOT);
+    OutByte(PIT_CHANNEL_2_DATA, pit_count & 0xFF);
+    OutByte(PIT_CHANNEL_2_DATA, pit_count >> 8);
+}
+
+void PITCalibrationStart(void)
+{
+    OutByte(PIT_CHANNEL_2_GATE_PORT, s_gate | PIT_CHANNEL_2_GATE);
+}
+
+void PITCalibrationWait(void)
+{
+    while ((InByte(PIT_CHANNEL_2_GATE_PORT) & PIT_CHANNEL_2_OUTPUT) == 0);
+
+    OutByte(PIT_CHANNEL_2_GATE_PORT, s_gate);
+}
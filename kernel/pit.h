@@ -0,0 +1,37 @@
+/**
+ * @file    pit.h
+ * @author  Cong Nguyen (congnt264@gmail.com)
+ * @brief   PIT channel 2 as a reference clock. Channel 2 is not connected to an
+ *          IRQ, its output can be polled from port 0x61. The frequency of the
+ *          PIT is architectural (1.193182MHz), so counters with an unknown
+ *          frequency (the local APIC timer, the TSC) are calibrated by reading
+ *          them before and after a short PIT interval.
+ *
+ * @version 0.1
+ * @date 2023-09-21
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+#include <stdint.h>
+
+/* Public define -------------------------------------------------------------*/
+#define PIT_CALIBRATION_MS          10
+
+/* Public function prototype -------------------------------------------------*/
+/**
+ * @brief       Load channel 2 with PIT_CALIBRATION_MS, the count doesn't start
+ *              until PITCalibrationStart() opens the gate.
+ */
+void PITCalibrationPrepare(void);
+
+/**
+ * @brief       Open the gate of channel 2, the interval starts now.
+ */
+void PITCalibrationStart(void);
+
+/**
+ * @brief       Busy wait until the interval ends, then close the gate.
+ */
+void PITCalibrationWait(void);
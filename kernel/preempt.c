@@ -0,0 +1,109 @@
+#include <stddef.h>
+#include <errno.h>
+
+#include "preempt.h"
+#include "softirq.h"
+#include "process.h"
+#include "trap.h"
+#include "assert.h"
+
+/* Private type --------------------------------------------------------------*/
+/**
+ * @brief   Preemption state of a CPU.
+ *
+ * @property count          - Preempt count, the boot code starts with 1.
+ * @property need_resched   - Switch process at the next opportunity.
+ * @property section_start  - TSC when the current non-preemptible section
+ *                            started.
+ * @property stats          - Statistics.
+ */
+typedef struct {
+    int count;
+    bool need_resched;
+    uint64_t section_start;
+    PreemptStats stats;
+} PreemptCPU;
+
+/* Private variable ----------------------------------------------------------*/
+static PreemptCPU s_preempt_cpu = {.count = 1};     /* One CPU.               */
+
+/* Public function -----------------------------------------------------------*/
+void PreemptDisable(void)
+{
+    s_preempt_cpu.count++;
+}
+
+void PreemptEnable(void)
+{
+    ASSERT(s_preempt_cpu.count > 0);
+    s_preempt_cpu.count--;
+}
+
+int PreemptCount(void)
+{
+    return s_preempt_cpu.count;
+}
+
+void SetNeedResched(void)
+{
+    s_preempt_cpu.need_resched = true;
+}
+
+bool TestAndClearNeedResched(void)
+{
+    bool need_resched = s_preempt_cpu.need_resched;
+
+    s_preempt_cpu.need_resched = false;
+
+    return need_resched;
+}
+
+void PreemptionPoint(void)
+{
+    if (s_preempt_cpu.count != 0 || InSoftirq()) {
+        return;
+    }
+
+    PreemptSectionEnd(PREEMPT_SECTION_POINT, 0);
+
+    /* The interrupt handler runs the softirqs, they may ask for a switch, but
+     * the handler doesn't switch a kernel context, we do it here. */
+    EnableInterrupts();
+    DisableInterrupts();
+
+    if (TestAndClearNeedResched()) {
+        s_preempt_cpu.stats.preemptions++;
+        Yield();
+    }
+
+    PreemptSectionStart();
+}
+
+void PreemptSectionStart(void)
+{
+    s_preempt_cpu.section_start = ReadTSC();
+}
+
+void PreemptSectionEnd(uint64_t kind, uint64_t number)
+{
+    PreemptCPU *cpu = &s_preempt_cpu;
+    uint64_t cycles = ReadTSC() - cpu->section_start;
+
+    cpu->stats.sections++;
+    if (cycles > cpu->stats.max_cycles) {
+        cpu->stats.max_cycles = cycles;
+        cpu->stats.max_kind = kind;
+        cpu->stats.max_number = number;
+    }
+}
+
+int GetPreemptStats(int cpu, PreemptStats *stats)
+{
+    if (cpu != 0) {
+        return -EINVAL;
+    }
+
+    *stats = s_preempt_cpu.stats;
+
+    return 0;
+}
@@ -0,0 +1,112 @@
+/**
+ * @file    preempt.h
+ * @author  Cong Nguyen (congnt264@gmail.com)
+ * @brief   Kernel preemption. The kernel runs with interrupts off and has no
+ *          locks, it relies on not being interrupted in the middle of an
+ *          update. So the kernel is preempted at preemption points only:
+ *          places in long operations (disk transfers, clearing a 2MB page)
+ *          where no shared structure is half updated. A preemption point opens
+ *          a short interrupt window, so a pending timer interrupt runs its
+ *          softirq there, and switches process if a reschedule is needed.
+ *
+ *          Code which calls a long operation while it keeps shared state
+ *          inconsistent disables preemption around it with PreemptDisable() and
+ *          PreemptEnable(), the preemption points inside are skipped then. The
+ *          count is per CPU, and the boot code runs with preemption disabled
+ *          until the scheduler starts.
+ *
+ *          The longest stretch the CPU could not be preempted (from the kernel
+ *          entry, or the last preemption point, to the return to user mode or
+ *          the next preemption point) is recorded, to find latency outliers.
+ *
+ * @version 0.1
+ * @date 2023-09-26
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Public define -------------------------------------------------------------*/
+/* Where the longest non-preemptible section ended. */
+#define PREEMPT_SECTION_SYSCALL     0   /* Return of a system call.         */
+#define PREEMPT_SECTION_INTERRUPT   1   /* Return of an interrupt.          */
+#define PREEMPT_SECTION_POINT       2   /* A preemption point.              */
+
+/* Public type ---------------------------------------------------------------*/
+/**
+ * @brief   Preemption statistics of a CPU, times are TSC cycles.
+ *
+ * @property sections       - Number of measured sections.
+ * @property preemptions    - Process switches at preemption points.
+ * @property max_cycles     - Length of the longest section.
+ * @property max_kind       - PREEMPT_SECTION_* of the longest section.
+ * @property max_number     - System call number or vector of the longest
+ *                            section, 0 for preemption points.
+ */
+typedef struct {
+    uint64_t sections;
+    uint64_t preemptions;
+    uint64_t max_cycles;
+    uint64_t max_kind;
+    uint64_t max_number;
+} PreemptStats;
+
+/* Public function prototype -------------------------------------------------*/
+/**
+ * @brief       Disable preemption points on this CPU, calls nest.
+ */
+void PreemptDisable(void);
+
+/**
+ * @brief       Enable preemption points again, after PreemptDisable().
+ */
+void PreemptEnable(void);
+
+/**
+ * @brief       Get the preempt count of this CPU, 0 if preemption is enabled.
+ */
+int PreemptCount(void);
+
+/**
+ * @brief       Ask for a process switch at the next preemption opportunity:
+ *              the return of the interrupt handler or a preemption point.
+ */
+void SetNeedResched(void);
+
+/**
+ * @brief       Get and clear the process switch request.
+ */
+bool TestAndClearNeedResched(void);
+
+/**
+ * @brief       Preemption point: let pending interrupts in, and switch process
+ *              if a reschedule is needed. It does nothing if preemption is
+ *              disabled or the CPU runs a softirq.
+ */
+void PreemptionPoint(void);
+
+/**
+ * @brief       The CPU enters the kernel from a preemptible context (user mode,
+ *              the IDLE process), a non-preemptible section starts.
+ */
+void PreemptSectionStart(void);
+
+/**
+ * @brief       The CPU leaves the kernel, record the length of the section.
+ *
+ * @param[in]   kind        - PREEMPT_SECTION_*.
+ * @param[in]   number      - System call number or vector.
+ */
+void PreemptSectionEnd(uint64_t kind, uint64_t number);
+
+/**
+ * @brief       Get the preemption statistics.
+ *
+ * @param[in]   cpu         - CPU index.
+ * @param[out]  stats       - Statistics.
+ * @return      int         - 0 on success, -EINVAL if there is no such CPU.
+ */
+int GetPreemptStats(int cpu, PreemptStats *stats);
@@ -206,6 +206,13 @@ int sprintk(char *str, const char *format, ...)
 }
 
 
+int WriteConsole(const char *buffer, int size)
+{
+    WriteVGA(buffer, size);
+
+    return size;
+}
+
 void ClrSrc(void)
 {
     memset(screen_buffer.buffer, 0 , ROW_LENGTH * COLUMN_LENGTH * 2);
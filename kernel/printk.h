@@ -6,4 +6,7 @@ int printk(const char *format, ...);
 
 int sprintk(char *str, const char *format, ...);
 
+/* Write `size` characters to the screen as they are, without formatting. */
+int WriteConsole(const char *buffer, int size);
+
 void ClrSrc(void);
\ No newline at end of file
@@ -2,29 +2,217 @@
 #include <string.h>
 
 #include "process.h"
+#include "slab.h"
 #include "file.h"
+#include "fpu.h"
+#include "timer.h"
+#include "syscall.h"
+#include "ioring.h"
 #include "printk.h"
 #include "assert.h"
 
 /* Private Define ------------------------------------------------------------*/
-#define IDLE_PROCESS_PID                0
 #define USER_INIT_PROCESS_ADDRESS_BASE  0x20000         /* Our shell program. */
 #define SIZE_OF_INIT_PROCCESS           (512 * 20)      /* 20 sectors.        */
 
+/* The PID table fits in one page, the generation uses the rest bits of a
+ * positive PID. */
+#define PID_TABLE_SIZE                  (1 << PID_INDEX_BITS)
+#define PID_INDEX_MASK                  (PID_TABLE_SIZE - 1)
+#define PID_GENERATION_MASK             ((1 << (31 - PID_INDEX_BITS)) - 1)
+#define PID_INDEX(pid)                  ((pid) & PID_INDEX_MASK)
+#define PID_GENERATION(pid)             (((pid) >> PID_INDEX_BITS) \
+                                         & PID_GENERATION_MASK)
+#define MAKE_PID(generation, index)     (((generation) << PID_INDEX_BITS) \
+                                         | (index))
+#define PID_ENTRY_NONE                  0           /* Entry 0 is IDLE's.     */
+
+#define IA32_FS_BASE_MSR                0xC0000100
+#define USER_CODE_SELECTOR              (0x20 | 3)
+#define USER_DATA_SELECTOR              (0x18 | 3)
+#define USER_DEFAULT_RFLAGS             0x202       /* Interrupt enabled.     */
+
+#define REAPER_URGENT_COUNT             16  /* Boost reaper at this many.  */
+
+#define PROCESS_OF(link, member)        ((Process *)((char *)(link)           \
+                                        - offsetof(Process, member)))
+
+/* Private type --------------------------------------------------------------*/
+/**
+ * @brief   PID table entry.
+ *
+ * @property proc       - The process owns this entry, NULL if it is free.
+ * @property generation - Generation of the entry, the high bits of the PID.
+ * @property next_free  - Index of the next free entry, if this entry is free.
+ */
+typedef struct {
+    Process *proc;
+    uint32_t generation;
+    uint32_t next_free;
+} PIDEntry;
+
+/**
+ * @brief   Arguments of Spawn() copied from the caller. Spawn() can be
+ *          preempted, and other threads of the caller may change its memory
+ *          meanwhile, so the caller memory is read only once.
+ *
+ * @property argc       - Number of arguments.
+ * @property length     - Bytes of the strings, with their terminators.
+ * @property strings    - Argument strings, one after another.
+ * @property action_count - Number of file actions.
+ * @property actions    - File actions.
+ */
+typedef struct {
+    int argc;
+    uint64_t length;
+    char strings[SPAWN_MAXIMUM_ARGUMENTS_SIZE];
+    int action_count;
+    SpawnFileAction actions[PROCESS_MAXIMUM_FILE_DESCRIPTOR];
+} SpawnArguments;
+
 /* Private variable ----------------------------------------------------------*/
 
 extern TSS TaskStateSegment; /* Extern from ASM. */
-static Process s_process_manager[MAXIMUM_NUMBER_OF_PROCESS];
-static int s_pid_num = 1;
+static SlabCache s_process_cache;
+static SlabCache s_address_space_cache;
+static SlabCache s_file_table_cache;
+static SlabCache s_spawn_cache;
+static PIDEntry *s_pid_table = NULL;
+static uint32_t s_pid_free_head = PID_ENTRY_NONE;  /* Released entries.      */
+static uint32_t s_pid_next_unused = 1;              /* Never used entries.    */
+static Process *s_idle_process = NULL;
+static Process *s_init_process = NULL;
+static Process *s_reaper = NULL;
+static HeadList s_reap_list;                /* Processes to teardown.         */
+static uint64_t s_reap_pending = 0;
+static WaitQueue s_reaper_wait_queue;
 static Scheduler s_scheduler;
 
 /* Private function prototypes -----------------------------------------------*/
 
-static Process *FindFreeProcessSlot(void);
-static Process *CreateNewProcess(void);
+/**
+ * @brief   Create a new process object with its own kernel stack.
+ * 
+ * @param   vm          - Address space to share, NULL to setup a new one.
+ * @param   files       - File descriptor table to share, NULL to create a new
+ *                        empty one.
+ * @return  The new process, NULL if failed.
+ */
+static Process *CreateNewProcess(AddressSpace *vm, FileTable *files);
+
+/**
+ * @brief   Release the PID and free all resources of the process immediately.
+ */
+static void DestroyProcess(Process *proc);
+
+/**
+ * @brief   Free all resources of the process. Shared address space and file
+ *          table are only freed by the last process using them. The PID must
+ *          be released already.
+ */
+static void FreeProcess(Process *proc);
+
+/**
+ * @brief   Release the PID of a collected process, and queue the process to
+ *          the reaper which frees its resources later.
+ */
+static void ReapProcess(Process *proc);
+
+/**
+ * @brief   Reaper kernel thread, it frees queued processes in batches.
+ */
+static void ReaperThread(void);
+
+/**
+ * @brief   First function of every kernel thread, it is the return address of
+ *          the initial context.
+ */
+static void KernelThreadStart(void);
+
+/**
+ * @brief   Mark the process as ready, and push it to the ready list of its
+ *          priority.
+ */
+static void MakeReady(Process *proc);
+
+static void ReleaseAddressSpace(AddressSpace *vm);
+
+static void ReleaseFileTable(FileTable *files);
+
+/**
+ * @brief   Reset the trap frame, so the process returns to user mode at `rip`
+ *          with the user stack pointer `rsp`.
+ */
+static void InitUserTrapFrame(TrapFrame *tf, uint64_t rip, uint64_t rsp);
+
+/**
+ * @brief   Give all children of the exiting process to the INIT process.
+ */
+static void ReparentChildren(Process *proc);
+
+/**
+ * @brief   The first thread of a program exited, give the thread zombies to the
+ *          reaper, the running threads exit at CheckThreadGroupExit().
+ */
+static void EndThreadGroup(Process *leader);
+
+/**
+ * @brief   Find a zombie child of the process.
+ * 
+ * @param   proc        - Parent process.
+ * @param   pid         - PID of the child, or WAIT_ANY_CHILD.
+ * @return  The zombie, NULL if there is no zombie to collect.
+ */
+static Process *FindZombieChild(Process *proc, int pid);
+
+/**
+ * @brief   Copy the arguments and the file actions of Spawn() from the caller
+ *          memory, and check them.
+ *
+ * @return  0 on success, -EFAULT, -E2BIG, -EBADF or -EINVAL if they are wrong.
+ */
+static int LoadSpawnArguments(SpawnArguments *args,
+                              char *const argv[],
+                              const SpawnFileAction *actions,
+                              int action_count);
+
+/**
+ * @brief   Create the child process of Spawn() from the copied arguments.
+ *
+ * @return  PID of the child, or a negative error code.
+ */
+static int SpawnProgram(const char *path, const SpawnArguments *args);
+
+/**
+ * @brief   Copy arguments to the top of the user stack of the new process, and
+ *          set its entry registers (rdi = argc, rsi = argv, rsp).
+ * 
+ * @param   proc        - New process.
+ * @param   page        - Kernel address of the user page of the new process.
+ * @param   args        - Arguments copied from the caller.
+ */
+static void CopySpawnArguments(Process *proc,
+                               uint64_t page,
+                               const SpawnArguments *args);
+
+static void InitPIDTable(void);
+
+/**
+ * @brief   Bind the process to a free entry of the PID table. Released entries
+ *          are reused first, their generation was increased when they were
+ *          released, so the new PID is different from the old one.
+ * 
+ * @param   proc 
+ * @return  PID of the process, or -1 if the PID table is full.
+ */
+static int AllocatePID(Process *proc);
+
+static void ReleasePID(int pid);
+
 /**
  * @brief   Set TaskStateSegment point to top of the process's kernel stack. So
  *          when we jump from ring 3 to ring 0, the kernel stack will be used.
+ *          The SYSCALL entry gets the same stack from its per-CPU data.
  * 
  * @param   proc 
  * @return  none
@@ -35,10 +223,6 @@ static void Schedule(void);
 
 static void SwitchProcess(Process *prev, Process *new);
 
-List *WaitListRemoveReadyProcess(HeadList *list, int wait_id);
-
-List *RemoveProcessWithPID(HeadList *list, int pid);
-
 /**
  * @brief   This function initialize the IDLE task. If the ready process list is
  *          empty, we run IDLE task. And the IDLE do nothing, just jump loop in
@@ -53,9 +237,20 @@ static void InitShellProcess(void);
 /* Public function -----------------------------------------------------------*/
 void InitProcess(void)
 {
+    InitSlabCache(&s_process_cache, sizeof(Process));
+    InitSlabCache(&s_address_space_cache, sizeof(AddressSpace));
+    InitSlabCache(&s_file_table_cache, sizeof(FileTable));
+    InitSlabCache(&s_spawn_cache, sizeof(SpawnArguments));
+    InitPIDTable();
+
     /* Init IDLE process first. */
     InitIDLEProcess();
 
+    /* The reaper frees exited processes in the background. */
+    InitWaitQueue(&s_reaper_wait_queue);
+    s_reaper = CreateKernelThread(ReaperThread, PROCESS_PRIORITY_LOW);
+    ASSERT(s_reaper != NULL);
+
     /* Run INIT process (Shell). */
     InitShellProcess();
 }
@@ -69,172 +264,259 @@ void Yield(void)
 {
     Process *proc = NULL;
     Scheduler *scheduler = GetScheduler();
-    HeadList *list = &scheduler->ready_proc_list;
 
-    if (ListIsEmpty(list)) {
+    proc = scheduler->current_proc;
+
+    /* Low priority processes only take the CPU from IDLE or from each other. */
+    if (ListIsEmpty(&scheduler->ready_proc_list)
+        && (ListIsEmpty(&scheduler->low_priority_list)
+            || (proc->pid != IDLE_PROCESS_PID
+                && proc->priority != PROCESS_PRIORITY_LOW))) {
         return;
     }
 
     /* Get current process, set it as ready, and push it to back of the ready
-     * list. */
-    proc = scheduler->current_proc;
-    proc->state = PROCESS_SLOT_READY;
-
-    /* We don't push the IDLE task to the ready list. */
+     * list. We don't push the IDLE task to the ready list. */
     if (proc->pid != IDLE_PROCESS_PID) {
-        ListPushBack(list, (List *)proc);
+        MakeReady(proc);
+    } else {
+        proc->state = PROCESS_SLOT_READY;
     }
 
     /* Process switch. */
     Schedule();
 }
 
-void Sleep(int wait_id)
+void InitWaitQueue(WaitQueue *wq)
+{
+    wq->waiters.next = NULL;
+    wq->waiters.tail = NULL;
+}
+
+void Sleep(WaitQueue *wq)
 {
     Process *proc = NULL;
     Scheduler *scheduler = GetScheduler();
-    HeadList *list = &scheduler->wait_proc_list;
 
-    /* Push current process to sleep process list. */
+    /* Push current process to the tail of the wait queue. */
     proc = scheduler->current_proc;
     proc->state = PROCESS_SLOT_SLEEPING;
-    proc->wait_id = wait_id;
+    proc->wait_queue = wq;
 
-    ListPushBack(list, (List *)proc);
+    ListPushBack(&wq->waiters, (List *)proc);
 
     /* Re-schedule to run next process. */
     Schedule();
 }
 
-void Wakeup(int wait_id)
+void Wakeup(WaitQueue *wq)
+{
+    /* Every process in the queue is waiting for this event, so we move all of
+     * them to the ready list. */
+    while (!ListIsEmpty(&wq->waiters)) {
+        WakeupOne(wq);
+    }
+}
+
+void WakeupOne(WaitQueue *wq)
 {
     Process *proc = NULL;
-    Scheduler *scheduler = GetScheduler();
-    HeadList *wait_list = &scheduler->wait_proc_list;
-    HeadList *ready_list = &scheduler->ready_proc_list;
 
-    /* Find correct processes which are wake up time and remove it from wait
-     * list. */
-    proc = (Process *)WaitListRemoveReadyProcess(wait_list, wait_id);
+    proc = (Process *)ListPopFront(&wq->waiters);
+    if (proc == NULL) {
+        return;
+    }
 
-    while (proc != NULL)
-    {
-        /* Push the process to ready list if now is it's wakeup time. */
-        proc->state = PROCESS_SLOT_READY;
-        ListPushBack(ready_list, (List *)proc);
+    ASSERT(proc->state == PROCESS_SLOT_SLEEPING);
+    ASSERT(proc->wait_queue == wq);
 
-        /* Check another processes in the wait list. */
-        proc = (Process *)WaitListRemoveReadyProcess(wait_list, wait_id);
-    }
+    proc->wait_queue = NULL;
+    MakeReady(proc);
 }
 
-void Exit(void)
+void Exit(int64_t status)
 {
     Process *proc = NULL;
     Scheduler *scheduler = GetScheduler();
-    HeadList *list = &scheduler->kill_proc_list;
 
+    /* The killed process doesn't belong to any list, it is found by PID. */
     proc = scheduler->current_proc;
+    if (proc == s_init_process) {
+        panic("INIT process exited.");
+    }
+
+    /* Wait for the ring operations, they use our memory and files. */
+    IORingRelease(proc);
+
+    proc->exit_code = status;
     proc->state = PROCESS_SLOT_KILLED;
+    proc->vm->live_count--;
 
-    ListPushBack(list, (List *)proc);
+    ReparentChildren(proc);
 
-    /* We need to call Wakeup() function because the init process which is first
-     * process in this system is constantly calling Wait() function to do the
-     * cleaning up, and the process maybe is sleeping state. So we wake it up
-     * before we switch to another process.
-     */
-    Wakeup(INIT_PROCESS_WAIT_ID);
+    if (proc->kernel_entry == NULL && proc->pid == proc->tgid) {
+        EndThreadGroup(proc);
+    }
+
+    /* Wakeup the threads which are joining this thread. */
+    Wakeup(&proc->exit_wait_queue);
+
+    /* Only the parent is woken up, it collects the status in WaitPID() and
+     * cleanups our resources. */
+    if (proc->parent != NULL) {
+        ListPushBack(&proc->parent->zombies, &proc->zombie_link);
+        Wakeup(&proc->parent->child_exit_wait_queue);
+    } else if (proc->pid != proc->tgid) {
+        if (proc->vm->exiting) {
+            /* Nobody joins a thread of an ended program. The reaper only runs
+             * after we switch away from this stack. */
+            ReapProcess(proc);
+        } else {
+            ListPushBack(&proc->vm->zombies, &proc->zombie_link);
+        }
+    }
 
     /* We re-schedule, the current process will be pop from ready list. */
     Schedule();
 }
 
-void Wait(int pid)
+void CheckThreadGroupExit(void)
 {
-    Process *proc = NULL;
-    Scheduler *scheduler = GetScheduler();
-    HeadList *list = &scheduler->kill_proc_list;
+    Process *proc = GetScheduler()->current_proc;
 
-    /* Forever loop to cleanup resources of all killed process. */
-    while (1) {
-        if (!ListIsEmpty(list)) {
-            proc = (Process *)RemoveProcessWithPID(list, pid);
-            if (proc != NULL) {
-                ASSERT(proc->state == PROCESS_SLOT_KILLED);
-
-                /* Cleanup the process. */
-                kfree(proc->stack);
-                FreeVM(proc->page_map);
-                
-                /* Close opened files. */
-                for (int i = USER_START_FD;
-                     i < PROCESS_MAXIMUM_FILE_DESCRIPTOR;
-                     i++) {
-
-                    if (proc->file[i] != NULL) {
-                        proc->file[i]->fcb->open_count--;
-                        proc->file[i]->open_count--;
-
-                        if (proc->file[i]->open_count == 0) {
-                            proc->file[i]->fcb = NULL;
-                        }
-                    }
-                }
-
-                memset(proc, 0, sizeof(Process));
-                break;
-            }
-        } else {
-            /* Sleep if we don't have any killed process. */
-            Sleep(INIT_PROCESS_WAIT_ID);
+    if (proc->vm->exiting) {
+        Exit(PROCESS_EXIT_FAILURE);
+    }
+}
+
+int WaitPID(int pid, int *status, int options)
+{
+    Process *child = NULL;
+    Process *current_proc = GetScheduler()->current_proc;
+
+    if (pid != WAIT_ANY_CHILD) {
+        child = FindProcessByPID(pid);
+        if (child == NULL || child->parent != current_proc) {
+            return -ECHILD;
+        }
+    } else if (ListIsEmpty(&current_proc->children)) {
+        return -ECHILD;
+    }
+
+    /* Sleep until one of our children exits, exits of other processes don't
+     * wake us up. */
+    while ((child = FindZombieChild(current_proc, pid)) == NULL) {
+        if (options & WNOHANG) {
+            return 0;
+        }
+
+        Sleep(&current_proc->child_exit_wait_queue);
+    }
+
+    ListRemove(&current_proc->zombies, &child->zombie_link);
+    ListRemove(&current_proc->children, &child->sibling);
+
+    pid = child->pid;
+    if (status != NULL) {
+        *status = (int)child->exit_code;
+    }
+
+    /* The reaper cleanups the process, we return the status now. */
+    ReapProcess(child);
+
+    return pid;
+}
+
+int ThreadJoin(int tid, int64_t *exit_code)
+{
+    Process *thread = FindProcessByPID(tid);
+    Process *current_proc = GetScheduler()->current_proc;
+
+    /* Only threads of the same program can be joined. The first thread of the
+     * program is collected by its parent. */
+    if (thread == NULL
+        || thread == current_proc
+        || thread->tgid != current_proc->tgid
+        || thread->pid == thread->tgid) {
+        return -ESRCH;
+    }
+
+    /* Sleep until the thread is killed, only its exit wakes us up. */
+    while (thread->state != PROCESS_SLOT_KILLED) {
+        Sleep(&thread->exit_wait_queue);
+
+        if (FindProcessByPID(tid) != thread) {
+            /* Another thread has joined it already. */
+            return -ESRCH;
         }
     }
+
+    if (exit_code != NULL) {
+        *exit_code = thread->exit_code;
+    }
+
+    /* The reaper cleanups the thread. */
+    ListRemove(&thread->vm->zombies, &thread->zombie_link);
+    ReapProcess(thread);
+
+    return 0;
 }
 
 int Fork(void)
 {
     Process *proc = NULL;
     Scheduler *scheduler = GetScheduler();
-    HeadList *list = &scheduler->ready_proc_list;
     Process *current_proc = scheduler->current_proc;
 
-    proc = CreateNewProcess();
+    proc = CreateNewProcess(NULL, NULL);
     if (proc == NULL) {
         printk("DEBUG: Failed to create new process.\n");
         return -ENOMEM;
     }
 
-    if (!CopyUVM(proc->page_map, current_proc->page_map, PAGE_SIZE)) {
+    if (!CopyUVM(proc->vm->page_map, current_proc->vm->page_map, PAGE_SIZE)) {
+        /* The new page map is freed by CopyUVM(). */
         printk("DEBUG: Failed to copy virtual memory.\n");
+        proc->vm->page_map = 0;
+        DestroyProcess(proc);
         return -ENOMEM;
     }
 
     /* Copy FD table, so the new process will point to same FD entries. */
-    memcpy(proc->file,
-           current_proc->file,
+    memcpy(proc->files->file,
+           current_proc->files->file,
            sizeof(FD *) * PROCESS_MAXIMUM_FILE_DESCRIPTOR);
 
     /* Handling shared files. */
     for (int i = USER_START_FD; i < PROCESS_MAXIMUM_FILE_DESCRIPTOR; i++)
     {
-        if (proc->file[i] != NULL) {
+        if (proc->files->file[i] != NULL) {
             /* We increase counters, means the new process will use them also. */
-            proc->file[i]->fcb->open_count++;
-            proc->file[i]->open_count++;
+            proc->files->file[i]->fcb->open_count++;
+            proc->files->file[i]->open_count++;
         }
     }
 
     /* Copy the trap frame, therefore the new process will return to the same
-     * location as the current process does. */
+     * location as the current process does. The new process only has one
+     * thread, and it inherits the thread local storage of the current one. */
     memcpy(proc->tf, current_proc->tf, sizeof(TrapFrame));
+    proc->fs_base = current_proc->fs_base;
+
+    if (FPUCopyState(proc, current_proc) < 0) {
+        DestroyProcess(proc);
+        return -ENOMEM;
+    }
 
     /* This is return value in new process when it back to user mode. */
     proc->tf->rax = 0;
 
+    /* The new process is our child. */
+    proc->parent = current_proc;
+    ListPushBack(&current_proc->children, &proc->sibling);
+
     /* Append it to ready list. */
-    proc->state = PROCESS_SLOT_READY;
-    ListPushBack(list, (List *)proc);
+    MakeReady(proc);
 
     /* For current process, we return pid of new process. */
     return proc->pid;
@@ -245,15 +527,24 @@ int Exec(Process *proc, const char *filename)
     int fd = 0;
     int program_size = 0;
 
+    /* Other threads are still running in the memory we are going to replace.
+     * Exited threads don't count, the reaper may not have freed them yet. */
+    if (proc->vm->live_count > 1) {
+        return -EBUSY;
+    }
+
+    /* The ring lives in the memory we are going to replace. */
+    IORingRelease(proc);
+
     fd = Open(proc, filename);
     if (fd < 0) {
         /* If we cannot open the file, we exit current process. */
         printk("DEBUG: Cannot open file.\n");
-        Exit();
+        Exit(PROCESS_EXIT_FAILURE);
     }
 
     /* Clear all virtual memory. */
-    memset((void *)USER_VIRTUAL_ADDRESS_BASE, 0, PAGE_SIZE);
+    ZeroMemory((void *)USER_VIRTUAL_ADDRESS_BASE, PAGE_SIZE);
     program_size = GetFileSize(proc, fd);
 
     /* Copy all program file to virtual address base. */
@@ -264,43 +555,78 @@ int Exec(Process *proc, const char *filename)
 
     if (program_size < 0) {
         /* Exit if we can not read data file. */
-        Exit();
+        Exit(PROCESS_EXIT_FAILURE);
     }
 
     Close(proc, fd);
 
     /* Clear trap frame and set it to default mode. */
-    memset(proc->tf, 0, sizeof(TrapFrame));
-    proc->tf->cs = 0x10 | 3;
-    proc->tf->rip = USER_VIRTUAL_ADDRESS_BASE;
-    proc->tf->ss = 0x18 | 3;
-    proc->tf->rsp = USER_STACK_START;
-    proc->tf->rflags = 0x202;
+    InitUserTrapFrame(proc->tf, USER_VIRTUAL_ADDRESS_BASE, USER_STACK_START);
+    proc->fs_base = 0;
+
+    /* The new program starts with clean FPU registers. */
+    FPUReleaseState(proc);
 
     return 0;
 }
 
-/* Private function ----------------------------------------------------------*/
-static Process *FindFreeProcessSlot(void)
+int Spawn(const char *path,
+          char *const argv[],
+          const SpawnFileAction *actions,
+          int action_count)
+{
+    int status = 0;
+    SpawnArguments *args = SlabAlloc(&s_spawn_cache);
+
+    if (args == NULL) {
+        return -ENOMEM;
+    }
+
+    status = LoadSpawnArguments(args, argv, actions, action_count);
+    if (status == 0) {
+        status = SpawnProgram(path, args);
+    }
+
+    SlabFree(&s_spawn_cache, args);
+
+    return status;
+}
+
+int Clone(uint64_t entry, uint64_t stack, uint64_t arg, uint64_t tls)
 {
     Process *proc = NULL;
+    Scheduler *scheduler = GetScheduler();
+    Process *current_proc = scheduler->current_proc;
 
-    for (int i = 0; i < MAXIMUM_NUMBER_OF_PROCESS; i++)
-    {
-        if (s_process_manager[i].state == PROCESS_SLOT_UNUSED) {
-            proc = &s_process_manager[i];
-            break;
-        }
+    /* The thread runs in the same user memory, so the entry and the stack
+     * have to be there. */
+    if (entry < USER_VIRTUAL_ADDRESS_BASE || entry >= USER_STACK_START
+        || stack <= USER_VIRTUAL_ADDRESS_BASE || stack > USER_STACK_START) {
+        return -EINVAL;
     }
 
-    return proc;
+    proc = CreateNewProcess(current_proc->vm, current_proc->files);
+    if (proc == NULL) {
+        return -ENOMEM;
+    }
+
+    proc->tgid = current_proc->tgid;
+    proc->fs_base = tls;
+    InitUserTrapFrame(proc->tf, entry, stack);
+    proc->tf->rdi = arg;
+
+    MakeReady(proc);
+
+    return proc->pid;
 }
 
+/* Private function ----------------------------------------------------------*/
 static void SetTSS(Process *proc)
 {
     /* We set TSS structure by assigning the top of the kernel stack to rsp0 in
      * the TaskStateSegment. */
-    TaskStateSegment.rsp0 = proc->stack + STACK_SIZE;
+    TaskStateSegment.rsp0 = proc->stack + KERNEL_STACK_SIZE;
+    SetSyscallKernelStack(proc->stack + KERNEL_STACK_SIZE);
 }
 
 static void Schedule(void)
@@ -309,20 +635,26 @@ static void Schedule(void)
     Process *current_proc = NULL;
 
     Scheduler *scheduler = GetScheduler();
-    HeadList *list = &scheduler->ready_proc_list;
     prev_proc = scheduler->current_proc;
 
-    if (ListIsEmpty(list)) {
-        /* If the ready list is empty we run IDLE task next. */
-        current_proc = &s_process_manager[IDLE_PROCESS_PID];
+    if (!ListIsEmpty(&scheduler->ready_proc_list)) {
+        current_proc = (Process *)ListPopFront(&scheduler->ready_proc_list);
+    } else if (!ListIsEmpty(&scheduler->low_priority_list)) {
+        current_proc = (Process *)ListPopFront(&scheduler->low_priority_list);
     } else {
-        current_proc = (Process *)ListPopFront(list);
+        /* If the ready lists are empty we run IDLE task next. */
+        current_proc = s_idle_process;
     }
 
     /* Get head ready process and make it as running. */
     current_proc->state = PROCESS_SLOT_RUNNING;
     scheduler->current_proc = current_proc;
 
+    /* The time slice only ticks when other processes wait for the CPU. */
+    StartTimeSlice(current_proc != s_idle_process
+                   && (!ListIsEmpty(&scheduler->ready_proc_list)
+                       || !ListIsEmpty(&scheduler->low_priority_list)));
+
     /* Switch to new process. */
     SwitchProcess(prev_proc, current_proc);
 }
@@ -330,147 +662,583 @@ static void Schedule(void)
 static void SwitchProcess(Process *prev, Process *new)
 {
     SetTSS(new);
-    SwitchVM(new->page_map);
+    FPUSwitch(new);
+
+    /* Threads of the same program share the page map, we don't need to reload
+     * it and flush the TLB. */
+    if (prev->vm->page_map != new->vm->page_map) {
+        SwitchVM(new->vm->page_map);
+    }
+
+    if (prev->fs_base != new->fs_base) {
+        WriteMSR(IA32_FS_BASE_MSR, new->fs_base);
+    }
+
     ContextSwitch(&prev->context, new->context);
 }
 
-List *WaitListRemoveReadyProcess(HeadList *list, int wait_id)
+Process *FindProcessByPID(int pid)
 {
-    List *current = list->next;
-    List *prev = (List *)list;
-    List *item = NULL;
-
-    while(current !=NULL) {
-        /* Wakeup if matching id. */
-        if (((Process *)current)->wait_id == wait_id) {
-            /* If found a ready process return it. */
-            prev->next = current->next;
-            item = current;
-
-            if (list->next == NULL) {
-                /* Current list is empty. */
-                list->tail = NULL;
-            } else if (current->next == NULL) {
-                /* The last one item in the list. */
-                list->tail = prev;
-            }
+    PIDEntry *entry = NULL;
 
-            break;
-        }
+    if (pid < 0) {
+        return NULL;
+    }
 
-        /* Check next process in the list. */
-        prev = current;
-        current = current->next;
+    entry = &s_pid_table[PID_INDEX(pid)];
+    if (entry->proc == NULL || entry->generation != PID_GENERATION(pid)) {
+        return NULL;
     }
 
-    return item;
+    return entry->proc;
 }
 
-List *RemoveProcessWithPID(HeadList *list, int pid)
+static void InitPIDTable(void)
 {
-  List *current = list->next;
-    List *prev = (List *)list;
-    List *item = NULL;
+    ASSERT(sizeof(PIDEntry) * PID_TABLE_SIZE <= PAGE_SIZE);
 
-    while(current !=NULL) {
-        /* remove from list if matching pid. */
-        if (((Process *)current)->pid == pid) {
-            /* If found a ready process return it. */
-            prev->next = current->next;
-            item = current;
+    s_pid_table = (PIDEntry *)kalloc();
+    ASSERT(s_pid_table != NULL);
 
-            if (list->next == NULL) {
-                /* Current list is empty. */
-                list->tail = NULL;
-            } else if (current->next == NULL) {
-                /* The last one item in the list. */
-                list->tail = prev;
-            }
+    memset(s_pid_table, 0, PAGE_SIZE);
+}
 
-            break;
-        }
+static int AllocatePID(Process *proc)
+{
+    uint32_t index = PID_ENTRY_NONE;
 
-        /* Check next process in the list. */
-        prev = current;
-        current = current->next;
+    if (s_pid_free_head != PID_ENTRY_NONE) {
+        index = s_pid_free_head;
+        s_pid_free_head = s_pid_table[index].next_free;
+    } else if (s_pid_next_unused < PID_TABLE_SIZE) {
+        index = s_pid_next_unused++;
+    } else {
+        return -1;
     }
 
-    return item;
+    s_pid_table[index].proc = proc;
+    s_pid_table[index].next_free = PID_ENTRY_NONE;
+
+    return MAKE_PID(s_pid_table[index].generation, index);
 }
 
+static void ReleasePID(int pid)
+{
+    PIDEntry *entry = &s_pid_table[PID_INDEX(pid)];
+
+    ASSERT(entry->proc != NULL);
+    ASSERT(entry->generation == PID_GENERATION(pid));
+
+    entry->proc = NULL;
+    entry->generation = (entry->generation + 1) & PID_GENERATION_MASK;
+    entry->next_free = s_pid_free_head;
+    s_pid_free_head = PID_INDEX(pid);
+}
 
 static void InitIDLEProcess(void)
 {
-    Process *proc;
-    proc = FindFreeProcessSlot();
+    Process *proc = SlabAlloc(&s_process_cache);
+    ASSERT(proc != NULL);
+
+    /* The IDLE process owns the entry 0 of the PID table, it is never given to
+     * other processes. */
+    memset(proc, 0, sizeof(Process));
+    s_pid_table[IDLE_PROCESS_PID].proc = proc;
+    s_idle_process = proc;
+
+    proc->vm = SlabAlloc(&s_address_space_cache);
+    ASSERT(proc->vm != NULL);
+    proc->vm->page_map = PHY_TO_VIR(ReadCR3());
+    proc->vm->ref_count = 1;
+    proc->vm->live_count = 1;
+    proc->vm->exiting = false;
+    proc->vm->zombies.next = NULL;
+    proc->vm->zombies.tail = NULL;
+
     proc->pid = IDLE_PROCESS_PID;
-    proc->page_map = PHY_TO_VIR(ReadCR3());
     proc->state = PROCESS_SLOT_RUNNING;
     GetScheduler()->current_proc = proc;
 }
 
 static void InitShellProcess(void)
 {
-    Scheduler *scheduler = GetScheduler();
-    HeadList *list = &scheduler->ready_proc_list;
-
-    Process *proc = CreateNewProcess();
+    Process *proc = CreateNewProcess(NULL, NULL);
+    ASSERT(proc != NULL);
 
     /* Map user memory (2MB) to the kernel virtual memory we just made. */
-    ASSERT(SetupUVM(proc->page_map,
+    ASSERT(SetupUVM(proc->vm->page_map,
             (uint64_t)PHY_TO_VIR(USER_INIT_PROCESS_ADDRESS_BASE),
             SIZE_OF_INIT_PROCCESS));
 
-    proc->state = PROCESS_SLOT_READY;
-    ListPushBack(list, (List *)proc);
+    s_init_process = proc;
+    MakeReady(proc);
 }
 
-Process* CreateNewProcess(void)
+static Process *CreateNewProcess(AddressSpace *vm, FileTable *files)
 {
     uint64_t stack_top = 0;
-    Process * proc = FindFreeProcessSlot();
+    Process * proc = SlabAlloc(&s_process_cache);
     if (proc == NULL) {
         return NULL;
     }
 
-    /* Each process has 2MB its own kernel stack. */
-    proc->stack = (uint64_t)kalloc();
+    memset(proc, 0, sizeof(Process));
+
+    /* Each process has its own small kernel stack, with a guard page below. */
+    proc->stack = AllocKernelStack();
     if (proc->stack == 0) {
+        SlabFree(&s_process_cache, proc);
+        return NULL;
+    }
+
+    proc->pid = AllocatePID(proc);
+    if (proc->pid < 0) {
+        FreeKernelStack(proc->stack);
+        SlabFree(&s_process_cache, proc);
         return NULL;
     }
 
     proc->state = PROCESS_SLOT_INITIALIZED;
-    proc->pid = s_pid_num++;
-    proc->wait_id = 0;
+    proc->tgid = proc->pid;
+    proc->wait_queue = NULL;
+    InitWaitQueue(&proc->exit_wait_queue);
+    InitWaitQueue(&proc->child_exit_wait_queue);
 
-    memset((void *)proc->stack, 0, STACK_SIZE);
-    stack_top = proc->stack + STACK_SIZE;
+    stack_top = proc->stack + KERNEL_STACK_SIZE;
 
     /* Because the process is not run until now, so it don't have the context.
      * We make a empty context to it. That include 6 context registers, and
      * return address. So, we make context point to `rsp` - 7 * 8. */
     proc->context = stack_top - sizeof(TrapFrame) - 7*8;
+
+    /* Only the context and the trap frame are cleared, the rest of the stack
+     * keeps the poison of the kernel stack allocator. */
+    memset((void *)proc->context, 0, stack_top - proc->context);
+
     /* We save the address of `TrapReturn` to rsp + 6. The next value of stack
      * pointer will be return address. So we push `TrapReturn` to it. */
     *(uint64_t *)(proc->context + 6*8) = (uint64_t)TrapReturn;
 
     /* We save stack frame at top of kernel stack. */
     proc->tf = (TrapFrame *)(stack_top - sizeof(TrapFrame));
+    InitUserTrapFrame(proc->tf, USER_VIRTUAL_ADDRESS_BASE, USER_STACK_START);
+
+    if (vm != NULL) {
+        /* A thread shares the address space of its creator. */
+        vm->ref_count++;
+        vm->live_count++;
+        proc->vm = vm;
+    } else {
+        proc->vm = SlabAlloc(&s_address_space_cache);
+        if (proc->vm == NULL) {
+            DestroyProcess(proc);
+            return NULL;
+        }
+
+        /* We create a virtual memory that is mapped with kernel, so the kernel
+         * will reside at the same address in every user virtual memory. */
+        proc->vm->ref_count = 1;
+        proc->vm->live_count = 1;
+        proc->vm->exiting = false;
+        proc->vm->zombies.next = NULL;
+        proc->vm->zombies.tail = NULL;
+        proc->vm->page_map = SetupKVM();
+        if (proc->vm->page_map == 0) {
+            DestroyProcess(proc);
+            return NULL;
+        }
+    }
+
+    if (files != NULL) {
+        files->ref_count++;
+        proc->files = files;
+    } else {
+        proc->files = SlabAlloc(&s_file_table_cache);
+        if (proc->files == NULL) {
+            DestroyProcess(proc);
+            return NULL;
+        }
+
+        memset(proc->files, 0, sizeof(FileTable));
+        proc->files->ref_count = 1;
+    }
 
-    proc->tf->cs = 0x10 | 3;
-    proc->tf->rip = USER_VIRTUAL_ADDRESS_BASE;
-    proc->tf->ss = 0x18 | 3;
-    proc->tf->rsp = USER_STACK_START;
-    proc->tf->rflags = 0x202;
-
-    /* We create a virtual memory that is mapped with kernel, so the kernel will
-     * reside at the same address in every user virtual memory. */
-    proc->page_map = SetupKVM();
-    if (proc->page_map == 0) {
-        kfree(proc->stack);
-        memset(proc, 0, sizeof(Process));
+    return proc;
+}
+
+static void DestroyProcess(Process *proc)
+{
+    /* The process never ran, so it never exited. */
+    if (proc->vm != NULL) {
+        proc->vm->live_count--;
+    }
+
+    ReleasePID(proc->pid);
+    FreeProcess(proc);
+}
+
+static void FreeProcess(Process *proc)
+{
+    FreeKernelStack(proc->stack);
+    FPUReleaseState(proc);
+
+    if (proc->vm != NULL) {
+        ReleaseAddressSpace(proc->vm);
+    }
+
+    if (proc->files != NULL) {
+        ReleaseFileTable(proc->files);
+    }
+
+    SlabFree(&s_process_cache, proc);
+}
+
+static void ReapProcess(Process *proc)
+{
+    ReleasePID(proc->pid);
+
+    ListPushBack(&s_reap_list, (List *)proc);
+    s_reap_pending++;
+
+    /* Don't let exited processes pile up when the CPU is always busy. */
+    if (s_reap_pending >= REAPER_URGENT_COUNT) {
+        s_reaper->priority = PROCESS_PRIORITY_NORMAL;
+    }
+
+    WakeupOne(&s_reaper_wait_queue);
+}
+
+static void ReaperThread(void)
+{
+    HeadList batch;
+    Process *proc = NULL;
+
+    while (1) {
+        if (ListIsEmpty(&s_reap_list)) {
+            GetScheduler()->current_proc->priority = PROCESS_PRIORITY_LOW;
+            Sleep(&s_reaper_wait_queue);
+            continue;
+        }
+
+        /* Take all queued processes, new ones go to the next batch. */
+        batch = s_reap_list;
+        s_reap_list.next = NULL;
+        s_reap_list.tail = NULL;
+
+        while ((proc = (Process *)ListPopFront(&batch)) != NULL) {
+            FreeProcess(proc);
+            s_reap_pending--;
+        }
+
+        Yield();
+    }
+}
+
+Process *CreateKernelThread(void (*entry)(void), ProcessPriority priority)
+{
+    Process *proc = CreateNewProcess(s_idle_process->vm, NULL);
+    if (proc == NULL) {
         return NULL;
     }
 
+    /* The thread never goes to user mode, it returns from the first context
+     * switch to KernelThreadStart() instead of TrapReturn(). */
+    proc->kernel_entry = entry;
+    proc->priority = priority;
+    *(uint64_t *)(proc->context + 6*8) = (uint64_t)KernelThreadStart;
+
+    MakeReady(proc);
+
     return proc;
 }
+
+static void KernelThreadStart(void)
+{
+    GetScheduler()->current_proc->kernel_entry();
+    panic("Kernel thread returned.");
+}
+
+static void MakeReady(Process *proc)
+{
+    Scheduler *scheduler = GetScheduler();
+
+    proc->state = PROCESS_SLOT_READY;
+    if (proc->priority == PROCESS_PRIORITY_LOW) {
+        ListPushBack(&scheduler->low_priority_list, (List *)proc);
+    } else {
+        ListPushBack(&scheduler->ready_proc_list, (List *)proc);
+    }
+
+    /* The running process has to share the CPU now. */
+    if (scheduler->current_proc != s_idle_process
+        && scheduler->current_proc != proc) {
+        RequestTimeSlice();
+    }
+}
+
+static void ReleaseAddressSpace(AddressSpace *vm)
+{
+    ASSERT(vm->ref_count > 0);
+
+    if (--vm->ref_count > 0) {
+        return;
+    }
+
+    if (vm->page_map != 0) {
+        FreeVM(vm->page_map);
+    }
+
+    SlabFree(&s_address_space_cache, vm);
+}
+
+static void ReleaseFileTable(FileTable *files)
+{
+    ASSERT(files->ref_count > 0);
+
+    if (--files->ref_count > 0) {
+        return;
+    }
+
+    /* Close opened files. */
+    for (int i = USER_START_FD; i < PROCESS_MAXIMUM_FILE_DESCRIPTOR; i++) {
+        if (files->file[i] != NULL) {
+            files->file[i]->fcb->open_count--;
+            files->file[i]->open_count--;
+
+            if (files->file[i]->open_count == 0) {
+                files->file[i]->fcb = NULL;
+            }
+        }
+    }
+
+    SlabFree(&s_file_table_cache, files);
+}
+
+static void InitUserTrapFrame(TrapFrame *tf, uint64_t rip, uint64_t rsp)
+{
+    memset(tf, 0, sizeof(TrapFrame));
+    tf->cs = USER_CODE_SELECTOR;
+    tf->rip = rip;
+    tf->ss = USER_DATA_SELECTOR;
+    tf->rsp = rsp;
+    tf->rflags = USER_DEFAULT_RFLAGS;
+}
+
+static void ReparentChildren(Process *proc)
+{
+    List *link = NULL;
+    bool has_zombies = !ListIsEmpty(&proc->zombies);
+
+    while ((link = ListPopFront(&proc->children)) != NULL) {
+        PROCESS_OF(link, sibling)->parent = s_init_process;
+        ListPushBack(&s_init_process->children, link);
+    }
+
+    while ((link = ListPopFront(&proc->zombies)) != NULL) {
+        ListPushBack(&s_init_process->zombies, link);
+    }
+
+    if (has_zombies) {
+        Wakeup(&s_init_process->child_exit_wait_queue);
+    }
+}
+
+static void EndThreadGroup(Process *leader)
+{
+    List *link = NULL;
+
+    leader->vm->exiting = true;
+
+    while ((link = ListPopFront(&leader->vm->zombies)) != NULL) {
+        ReapProcess(PROCESS_OF(link, zombie_link));
+    }
+}
+
+static Process *FindZombieChild(Process *proc, int pid)
+{
+    for (List *link = proc->zombies.next; link != NULL; link = link->next) {
+        Process *zombie = PROCESS_OF(link, zombie_link);
+        if (pid == WAIT_ANY_CHILD || zombie->pid == pid) {
+            return zombie;
+        }
+    }
+
+    return NULL;
+}
+
+static int LoadSpawnArguments(SpawnArguments *args,
+                              char *const argv[],
+                              const SpawnFileAction *actions,
+                              int action_count)
+{
+    Process *current_proc = GetScheduler()->current_proc;
+    uint64_t arguments_size = 0;
+
+    if (action_count < 0
+        || action_count > PROCESS_MAXIMUM_FILE_DESCRIPTOR
+        || (action_count > 0 && actions == NULL)) {
+        return -EINVAL;
+    }
+
+    /* The handler checked the range of the actions. */
+    memcpy(args->actions, actions, action_count * sizeof(SpawnFileAction));
+    args->action_count = action_count;
+
+    for (int i = 0; i < action_count; i++) {
+        if (args->actions[i].fd < USER_START_FD
+            || args->actions[i].fd >= PROCESS_MAXIMUM_FILE_DESCRIPTOR
+            || current_proc->files->file[args->actions[i].fd] == NULL) {
+            return -EBADF;
+        }
+
+        if (args->actions[i].child_fd < USER_START_FD
+            || args->actions[i].child_fd >= PROCESS_MAXIMUM_FILE_DESCRIPTOR) {
+            return -EINVAL;
+        }
+    }
+
+    args->argc = 0;
+    args->length = 0;
+
+    while (argv != NULL) {
+        const char *arg = NULL;
+        uint64_t length = 0;
+
+        if (!IsUserRange((uint64_t)&argv[args->argc], sizeof(char *))) {
+            return -EFAULT;
+        }
+
+        arg = argv[args->argc];
+        if (arg == NULL) {
+            break;
+        }
+
+        if (!IsUserString(arg)) {
+            return -EFAULT;
+        }
+
+        length = strlen(arg) + 1;
+        arguments_size += length + sizeof(char *);
+
+        if (args->argc + 1 > SPAWN_MAXIMUM_ARGUMENTS
+            || arguments_size > SPAWN_MAXIMUM_ARGUMENTS_SIZE) {
+            return -E2BIG;
+        }
+
+        memcpy(&args->strings[args->length], arg, length);
+        args->length += length;
+        args->argc++;
+    }
+
+    return 0;
+}
+
+static int SpawnProgram(const char *path, const SpawnArguments *args)
+{
+    int fd = 0;
+    int program_size = 0;
+    uint64_t page = 0;
+    Process *proc = NULL;
+    Process *current_proc = GetScheduler()->current_proc;
+
+    fd = Open(current_proc, path);
+    if (fd < 0) {
+        return -ENOENT;
+    }
+
+    program_size = GetFileSize(current_proc, fd);
+    if (program_size <= 0
+        || program_size > PAGE_SIZE - 2 * SPAWN_MAXIMUM_ARGUMENTS_SIZE) {
+        Close(current_proc, fd);
+        return -ENOEXEC;
+    }
+
+    proc = CreateNewProcess(NULL, NULL);
+    if (proc == NULL) {
+        Close(current_proc, fd);
+        return -ENOMEM;
+    }
+
+    page = MapUserPage(proc->vm->page_map);
+    if (page == 0) {
+        Close(current_proc, fd);
+        DestroyProcess(proc);
+        return -ENOMEM;
+    }
+
+    /* Load the program straight to the new user page, only the rest of the
+     * page is cleared. */
+    if (Read(current_proc, fd, (void *)page, program_size) != program_size) {
+        Close(current_proc, fd);
+        DestroyProcess(proc);
+        return -EIO;
+    }
+
+    Close(current_proc, fd);
+    ZeroMemory((void *)(page + program_size), PAGE_SIZE - program_size);
+
+    CopySpawnArguments(proc, page, args);
+
+    /* Share the selected files, like Fork() does for all files. Another thread
+     * may have closed one while we were loading the program. */
+    for (int i = 0; i < args->action_count; i++) {
+        FD *file = current_proc->files->file[args->actions[i].fd];
+        FD **child_file = &proc->files->file[args->actions[i].child_fd];
+
+        if (file == NULL) {
+            DestroyProcess(proc);
+            return -EBADF;
+        }
+
+        if (*child_file != NULL) {
+            (*child_file)->fcb->open_count--;
+            (*child_file)->open_count--;
+        }
+
+        *child_file = file;
+        file->fcb->open_count++;
+        file->open_count++;
+    }
+
+    /* The new process is our child. */
+    proc->parent = current_proc;
+    ListPushBack(&current_proc->children, &proc->sibling);
+
+    MakeReady(proc);
+
+    return proc->pid;
+}
+
+static void CopySpawnArguments(Process *proc,
+                               uint64_t page,
+                               const SpawnArguments *args)
+{
+    /* Kernel address and user address of the stack top. */
+    uint64_t top = page + PAGE_SIZE;
+    uint64_t user_top = USER_STACK_START;
+    uint64_t *user_argv = NULL;
+    const char *arg = args->strings;
+    uint64_t length = 0;
+
+    /* Reserve the pointer array below the strings, it is aligned to 16 bytes
+     * and it is the stack top when the process starts. */
+    user_argv = (uint64_t *)((top - args->length
+                              - (args->argc + 1) * sizeof(uint64_t))
+                             & ~(uint64_t)0xF);
+
+    for (int i = 0; i < args->argc; i++) {
+        length = strlen(arg) + 1;
+        top -= length;
+        user_top -= length;
+
+        memcpy((void *)top, arg, length);
+        user_argv[i] = user_top;
+        arg += length;
+    }
+
+    user_argv[args->argc] = 0;
+
+    proc->tf->rdi = args->argc;
+    proc->tf->rsi = USER_STACK_START - (page + PAGE_SIZE - (uint64_t)user_argv);
+    proc->tf->rsp = proc->tf->rsi;
+}
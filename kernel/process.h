@@ -1,36 +1,41 @@
 /**
  * @file    process.h
  * @author  Cong Nguyen (congnt264@gmail.com)
- * @brief   A process is a program in execution. In our system we limit at 
- *          `MAXIMUM_NUMBER_OF_PROCESS` process. To schedule process, we create
+ * @brief   A process is a program in execution. A process control block is
+ *          also the schedulable thread of the program: threads which are
+ *          created by Clone() are processes that share the address space and
+ *          the file descriptor table of their creator. Process control blocks are
+ *          allocated from an object cache (see slab.h), so the number of
+ *          processes is only limited by free memory and the size of the PID
+ *          table. To schedule process, we create
  *          a structure that is Scheduler to manage them. We use the round-robin
  *          scheduling mechanism in our system, we achieved that by using the
  *          timer interrupt, the timer handler we be called every 10ms, so in
  *          this, we perform context switch between processes.
  * 
- *          The scheduler structure maintain three queues: ready queue, waiting
- *          queue and killed queue.
- *          + The ready queue to push and pop ready processes, so we can run
- *            them round robin. Particularly, when the context switch occurs, we
- *            make current task as ready and push it to queue tail. And pop the
- *            next task from queue head, run it, and mark it as running.
- *          + The waiting queue contains processes which are in sleeping state.
- *            We push current process to this queue when it call Sleep() system
- *            call and pop them when Wakeup() is called.
- *          + The kill queue contains killed processes. We push killed processes
- *            to it, and the init process will pop and cleanup their resource.
+ *          The scheduler structure maintain the ready queue. We push and pop
+ *          ready processes to it, so we can run them round robin.
+ *          Particularly, when the context switch occurs, we make current task
+ *          as ready and push it to queue tail. And pop the next task from queue
+ *          head, run it, and mark it as running.
+ *          Sleeping processes don't belong to the scheduler, they are pushed to
+ *          the wait queue (see wait.h) of the object they are waiting for, and
+ *          popped from it when Wakeup() is called on that object.
  * 
  *          In this section, we are going to analyze each state of process.
  *          Let's get started.
  *
- *          1. Every process object is also maintained by `s_process_manager`
- *          (that actually is array of processes). So, if user does not request
- *          to create new process, we mark them as `PROCESS_SLOT_UNUSED`.
+ *          1. Every process object is registered in the PID table. The PID
+ *          table is an array of one page, indexed by the low `PID_INDEX_BITS`
+ *          bits of the PID, so finding a process by PID is a single array
+ *          access. The high bits of the PID are the generation of the table
+ *          entry, the generation is increased every time the entry is released,
+ *          so a stale PID never finds the new process which reuses the entry.
  *
- *          2. When user request to create a new process, we find a free process
- *          slot using `FindFreeProcessSlot()`, initialize the process object
- *          (stack, virtual memory map, context, trap frame, etc.) and mark it
- *          as `PROCESS_SLOT_INITIALIZED`.
+ *          2. When user request to create a new process, we allocate a process
+ *          object from the process cache and a PID table entry, initialize the
+ *          process object (stack, virtual memory map, context, trap frame,
+ *          etc.) and mark it as `PROCESS_SLOT_INITIALIZED`.
  * 
  *          3. After that, we push it to the ready queue and mark it as
  *          `PROCESS_SLOT_READY` state.
@@ -48,7 +53,7 @@
  *
  *          6. If a process is running state, and it call sleep() system call,
  *          we will push it to the while loop until the time is achieved. And in
- *          the while loop, we push it to the sleep queue, mark it as
+ *          the while loop, we push it to the timer wait queue, mark it as
  *          `PROCESS_SLOT_SLEEPING`, and pop it out of ready queue, so this
  *          process will never be run until we call the Wakeup(). Every 10ms
  *          the timer handler is called, we wakeup it, check the time is reached
@@ -62,12 +67,30 @@
  *                segmentation fault, for example.)
  *          In this state we will not release process's resource intermediately,
  *          because, the process still running. So, we pop it out ready queue,
- *          and push it to the killed queue, by the way, the process will never
- *          be run again. And when init process wakeup, it call cleanup all
- *          resource of the process such as: kernel stack, virtual memory page
- *          map, etc. And finally, it marked the process as
- *          `PROCESS_SLOT_UNUSED`, to the next user create process request could
- *          reuse it's slot.
+ *          by the way, the process will never be run again, but it still can be
+ *          found by its PID. The process becomes a zombie: it is pushed to the
+ *          zombie list of its parent, and only its parent is woken up. When the
+ *          parent collects the exit code with WaitPID(), it releases the PID
+ *          table entry and hands the process to the reaper, a low priority
+ *          kernel thread. The reaper cleanups all resource of the process in
+ *          batches, such as: kernel stack, virtual memory page map, opened
+ *          files, etc. And finally, it gives the process object back to the
+ *          process cache. So the parent gets the exit status without paying
+ *          for the teardown.
+ *
+ *          Kernel threads are processes which run kernel code only, they share
+ *          the kernel address space of the IDLE process. Low priority processes
+ *          are only scheduled when there is no normal process ready to run.
+ *
+ *          Every process which is created by Fork() is a child of the process
+ *          which creates it, and it is linked to the children list of the
+ *          parent. When a parent exits before its children, the children (and
+ *          the zombies among them) are given to the INIT process (the shell).
+ *          Threads which are created by Clone() have no parent, they are
+ *          collected by ThreadJoin(). An exited thread waits in the zombie list
+ *          of its address space, and when the first thread of the program
+ *          exits, the program ends: the zombies are given to the reaper, and
+ *          the other threads exit when they return to user mode.
  * 
  * @version 0.1
  * @date 2023-08-07
@@ -82,16 +105,19 @@
 #include "common.h"
 #include "trap.h"
 #include "memory.h"
+#include "wait.h"
 
 /* Public define -------------------------------------------------------------*/
-#define STACK_SIZE                          PAGE_SIZE    /* 2MB. */
-#define MAXIMUM_NUMBER_OF_PROCESS           10
+#define IDLE_PROCESS_PID                    0
+#define PID_INDEX_BITS                      17
 #define USER_STACK_START                    (USER_VIRTUAL_ADDRESS_BASE \
-                                            + STACK_SIZE)
-#define NORMAL_PROCESS_WAIT_ID              -1
-#define INIT_PROCESS_WAIT_ID                1
-#define WAITING_KEYBOARD_PROCESS_WAIT_ID    -2
+                                            + PAGE_SIZE)
 #define PROCESS_MAXIMUM_FILE_DESCRIPTOR     100
+#define WAIT_ANY_CHILD                      -1  /* WaitPID() any child.       */
+#define WNOHANG                             1   /* Don't wait for a zombie.   */
+#define PROCESS_EXIT_FAILURE                -1  /* Killed by the kernel.      */
+#define SPAWN_MAXIMUM_ARGUMENTS             32
+#define SPAWN_MAXIMUM_ARGUMENTS_SIZE        4096
 /* Public type ---------------------------------------------------------------*/
 typedef enum  {
     PROCESS_SLOT_UNUSED = 0,
@@ -102,6 +128,11 @@ typedef enum  {
     PROCESS_SLOT_KILLED
 } ProcessState;
 
+typedef enum {
+    PROCESS_PRIORITY_NORMAL = 0,
+    PROCESS_PRIORITY_LOW
+} ProcessPriority;
+
 
 /**
  * @brief   Process Control Block structure. This structure is used to store the
@@ -110,29 +141,114 @@ typedef enum  {
  *
  * @property next       - Next process to run.
  * @property pid        - Process Identification number of a process.
- * @property wait_id    - Save the process wait id.
+ * @property wait_queue - The wait queue the process is sleeping on, NULL if
+ *                        the process is not sleeping.
  * @property state      - Current state of process
- * @property page_map   - Saves the address of page map level 4 table, when we
- *                        run the process, we use this to switch to the process
- *                        's virtual memory.
+ * @property tgid       - Thread group id, the PID of the first thread of the
+ *                        program. Threads of a program share `vm` and `files`.
+ * @property vm         - Address space of the process.
  * @property stack      - Stack pointer is used when enter the kernel mode. A
  *                        Process has two stack, one for user code, and one for
  *                        kernel code. The one for user code is saved in trap
- *                        frame.
+ *                        frame. The kernel stack is KERNEL_STACK_SIZE bytes
+ *                        from the kernel stack allocator (see memory.h), this
+ *                        field saves its lowest address.
  * @property tf         - 
+ * @property files      - File descriptor table of the process.
+ * @property fs_base    - FS segment base, the thread local storage pointer of
+ *                        the thread, it is loaded when we switch to the thread.
+ * @property exit_code  - Exit status of the process, it is passed to Exit().
+ * @property fpu_state  - FPU/SSE/AVX state area, NULL if the process has never
+ *                        used these registers.
+ * @property priority   - Scheduling priority.
+ * @property kernel_entry - Entry function of a kernel thread, NULL for user
+ *                        processes.
+ * @property parent     - Parent process, NULL for threads and the INIT process.
+ * @property sibling    - Link in the children list of the parent.
+ * @property zombie_link - Link in the zombie list of the parent, or of the
+ *                        address space for threads.
+ * @property children   - Children processes, include zombies.
+ * @property zombies    - Exited children, they are waiting to be collected.
+ * @property exit_wait_queue - Threads waiting for this thread to exit.
+ * @property child_exit_wait_queue - Threads of this process waiting for its
+ *                        children to exit.
+ * @property ioring     - Asynchronous I/O ring of the process, NULL if it is not
+ *                        set up (see ioring.h).
  */
 struct FD;
+struct IORingContext;
+
+/**
+ * @brief   Address space structure, it is shared by all threads of a program.
+ *
+ * @property page_map   - Saves the address of page map level 4 table, when we
+ *                        run the process, we use this to switch to the process
+ *                        's virtual memory.
+ * @property ref_count  - Number of processes are using the address space.
+ * @property live_count - Number of those processes which have not exited, a
+ *                        thread which is not joined yet still holds a
+ *                        reference until the reaper frees it.
+ * @property exiting    - The first thread of the program exited, the other
+ *                        threads exit too.
+ * @property zombies    - Exited threads which are not joined yet.
+ */
+typedef struct {
+    uint64_t page_map;
+    int ref_count;
+    int live_count;
+    bool exiting;
+    HeadList zombies;
+} AddressSpace;
+
+/**
+ * @brief   Spawn file action, the new process inherits a file descriptor of
+ *          the caller.
+ *
+ * @property fd         - File descriptor of the caller.
+ * @property child_fd   - File descriptor in the new process which refers to
+ *                        the same open file.
+ */
+typedef struct {
+    int fd;
+    int child_fd;
+} SpawnFileAction;
 
+/**
+ * @brief   File descriptor table structure, it is shared by all threads of a
+ *          program.
+ *
+ * @property file       - File descriptor entries, indexed by fd.
+ * @property ref_count  - Number of processes are using the table.
+ */
 typedef struct {
+    struct FD *file[PROCESS_MAXIMUM_FILE_DESCRIPTOR];
+    int ref_count;
+} FileTable;
+
+typedef struct Process {
     List *next;
     int pid;
-    int wait_id;
+    WaitQueue *wait_queue;
     ProcessState state;
-    uint64_t page_map;
+    int tgid;
+    AddressSpace *vm;
     uint64_t context;
     uint64_t stack;
     TrapFrame *tf;
-    struct FD *file[PROCESS_MAXIMUM_FILE_DESCRIPTOR];
+    FileTable *files;
+    uint64_t fs_base;
+    int64_t exit_code;
+    void *fpu_state;
+    ProcessPriority priority;
+    void (*kernel_entry)(void);
+    struct Process *parent;
+    List sibling;
+    List zombie_link;
+    HeadList children;
+    HeadList zombies;
+    WaitQueue exit_wait_queue;
+    WaitQueue child_exit_wait_queue;
+    struct IORingContext *ioring;
 } Process;
 
 /**
@@ -157,11 +273,18 @@ typedef struct {
     uint16_t iopb;
 } __attribute__ ((packed)) TSS;
 
+/**
+ * @brief   Scheduler structure.
+ *
+ * @property current_proc       - Running process.
+ * @property ready_proc_list    - Ready processes with normal priority.
+ * @property low_priority_list  - Ready processes with low priority, they run
+ *                                only when `ready_proc_list` is empty.
+ */
 typedef struct {
     Process *current_proc;
     HeadList ready_proc_list;
-    HeadList wait_proc_list;
-    HeadList kill_proc_list;
+    HeadList low_priority_list;
 } Scheduler;
 
 /* Public function prototype -------------------------------------------------*/
@@ -188,34 +311,99 @@ void Yield(void);
 void ContextSwitch(uint64_t *old, uint64_t new);
 
 /**
- * @brief       Add current process to wait list wih wait_id.
+ * @brief       Exit current process, remove it from ready list. The process
+ *              becomes a zombie until its parent collects the exit status. When
+ *              the first thread of a program exits, the whole program ends.
  * 
- * @param[in]   wait_id     - Current process wait id.
+ * @param[in]   status      - Exit status.
  */
-void Sleep(int wait_id);
+void Exit(int64_t status);
 
 /**
- * @brief       Wakeup processes which match wait_id.
+ * @brief       Exit the current thread if its program has ended. It is called
+ *              before returning to user mode.
+ */
+void CheckThreadGroupExit(void);
+
+/**
+ * @brief       Waiting for a child process exit, and cleanup its resources. The
+ *              caller sleeps on its child exit wait queue, so it is only woken
+ *              up when one of its children exits.
  * 
- * @param[in]   wait_id     - Wait id to wake up processes matching.
+ * @param[in]   pid         - PID of the child to wait for, or WAIT_ANY_CHILD.
+ * @param[out]  status      - Exit status of the child, could be NULL.
+ * @param[in]   options     - WNOHANG to return immediately if no child exited.
+ * @return      int         - PID of the collected child.
+ *                          - Zero if WNOHANG is set and no child exited.
+ *                          - -ECHILD if there is no such child.
  */
-void Wakeup(int wait_id);
+int WaitPID(int pid, int *status, int options);
+
+int Fork(void);
 
 /**
- * @brief       Exit current process, remove it from ready list.
+ * @brief       Find a process by PID.
  * 
+ * @param[in]   pid         - Process Identification number.
+ * @return      Process*    - The process.
+ *                          - NULL if the PID is not used or is stale.
  */
-void Exit(void);
+Process *FindProcessByPID(int pid);
 
 /**
- * @brief       Waiting for children process exit, the init process call this to
- *              cleanup exiting processes. This system call never return from
- *              kernel mode, so, this function should be called when the init
- *              process has done it's job in user space.
+ * @brief       Create a kernel thread, it runs `entry` in kernel mode with the
+ *              kernel address space. `entry` must never return.
  * 
+ * @param[in]   entry       - Thread function.
+ * @param[in]   priority    - Scheduling priority.
+ * @return      Process*    - The kernel thread, NULL if failed.
  */
-void Wait(int pid);
+Process *CreateKernelThread(void (*entry)(void), ProcessPriority priority);
 
-int Fork(void);
+int Exec(Process *proc, const char *filename);
 
-int Exec(Process *proc, const char *filename);
\ No newline at end of file
+/**
+ * @brief       Create a new thread in the current program. The thread shares
+ *              the address space and the file descriptor table with the current
+ *              process, and starts running in user mode at `entry`.
+ * 
+ * @param[in]   entry       - User address where the thread starts.
+ * @param[in]   stack       - Top of the user stack of the thread.
+ * @param[in]   arg         - Value is passed to the thread in `rdi`.
+ * @param[in]   tls         - FS segment base of the thread.
+ * @return      int         - PID (thread id) of the new thread.
+ *                          - Negative error code if failed.
+ */
+int Clone(uint64_t entry, uint64_t stack, uint64_t arg, uint64_t tls);
+
+/**
+ * @brief       Create a child process which runs the program `path`. Unlike
+ *              Fork() and Exec(), the address space of the child is built
+ *              directly from the program file, the memory of the caller is
+ *              never copied. The child starts with `argc` in `rdi` and `argv`
+ *              in `rsi`, the arguments are copied to the top of its stack. The
+ *              child only inherits the file descriptors listed in `actions`.
+ * 
+ * @param[in]   path        - Program file name.
+ * @param[in]   argv        - NULL terminated argument list, could be NULL.
+ * @param[in]   actions     - File actions, could be NULL.
+ * @param[in]   action_count- Number of file actions.
+ * @return      int         - PID of the new process.
+ *                          - Negative error code if failed.
+ */
+int Spawn(const char *path,
+          char *const argv[],
+          const SpawnFileAction *actions,
+          int action_count);
+
+/**
+ * @brief       Waiting for a thread of the current program exit, and cleanup
+ *              its resources. The caller sleeps on the exit wait queue of the
+ *              thread, so it is only woken up when that thread exits.
+ * 
+ * @param[in]   tid         - PID of the thread, it is returned by Clone().
+ * @param[out]  exit_code   - Exit code of the thread, could be NULL.
+ * @return      int         - Zero if success.
+ *                          - -ESRCH if there is no such thread to join.
+ */
+int ThreadJoin(int tid, int64_t *exit_code);
\ No newline at end of file
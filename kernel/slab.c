@@ -0,0 +1,84 @@
+#include <stddef.h>
+
+#include "slab.h"
+#include "memory.h"
+#include "assert.h"
+
+/* Private function prototypes -----------------------------------------------*/
+/**
+ * @brief   Allocate a new page and push all objects in the page to the free
+ *          list of the cache.
+ *
+ * @param   cache
+ * @return  true if the cache has new free objects.
+ */
+static bool SlabGrow(SlabCache *cache);
+
+/* Public function -----------------------------------------------------------*/
+void InitSlabCache(SlabCache *cache, uint64_t object_size)
+{
+    ASSERT(object_size > 0 && object_size <= PAGE_SIZE);
+
+    /* A free object needs space to save the free list link. */
+    if (object_size < sizeof(List)) {
+        object_size = sizeof(List);
+    }
+
+    cache->object_size = (object_size + SLAB_MINIMUM_ALIGNMENT - 1)
+                         / SLAB_MINIMUM_ALIGNMENT
+                         * SLAB_MINIMUM_ALIGNMENT;
+    cache->free_list.next = NULL;
+    cache->free_list.tail = NULL;
+    cache->total_objects = 0;
+    cache->used_objects = 0;
+}
+
+void *SlabAlloc(SlabCache *cache)
+{
+    List *object = NULL;
+
+    if (ListIsEmpty(&cache->free_list) && !SlabGrow(cache)) {
+        return NULL;
+    }
+
+    object = ListPopFront(&cache->free_list);
+    cache->used_objects++;
+
+    return (void *)object;
+}
+
+void SlabFree(SlabCache *cache, void *object)
+{
+    ASSERT(object != NULL);
+    ASSERT(cache->used_objects > 0);
+
+    /* Push it to the head, so the hottest object will be reused first. */
+    List *item = (List *)object;
+    item->next = cache->free_list.next;
+    cache->free_list.next = item;
+    if (cache->free_list.tail == NULL) {
+        cache->free_list.tail = item;
+    }
+
+    cache->used_objects--;
+}
+
+/* Private function ----------------------------------------------------------*/
+static bool SlabGrow(SlabCache *cache)
+{
+    uint64_t objects_per_page = PAGE_SIZE / cache->object_size;
+    char *page = (char *)kalloc();
+
+    if (page == NULL) {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < objects_per_page; i++) {
+        ListPushBack(&cache->free_list,
+                     (List *)(page + i * cache->object_size));
+    }
+
+    cache->total_objects += objects_per_page;
+
+    return true;
+}
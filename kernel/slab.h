@@ -0,0 +1,75 @@
+/**
+ * @file    slab.h
+ * @author  Cong Nguyen (congnt264@gmail.com)
+ * @brief   The page allocator kalloc() only gives memory in pages (2MB), that
+ *          is too big for small kernel objects such as process control blocks.
+ *          An object cache (slab cache) manages objects of one fixed size. When
+ *          the cache is empty, it allocates a new page with kalloc() and carves
+ *          the page into objects, these objects are pushed to the free list of
+ *          the cache. So allocating and freeing an object is only popping and
+ *          pushing the free list.
+ *
+ *          Objects are never given back to the page allocator, a freed object
+ *          stays in the free list of its cache to be reused by the next
+ *          allocation.
+ *
+ *          The object size is rounded up to `SLAB_MINIMUM_ALIGNMENT`. If it is
+ *          a power of two, every object is also aligned to its size, because
+ *          pages are 2MB aligned.
+ *
+ * @version 0.1
+ * @date 2023-09-04
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+#include <stdint.h>
+#include <list.h>
+
+/* Public define -------------------------------------------------------------*/
+#define SLAB_MINIMUM_ALIGNMENT      16
+
+/* Public type ---------------------------------------------------------------*/
+/**
+ * @brief   Object cache structure.
+ *
+ * @property object_size    - Size of each object, after alignment.
+ * @property free_list      - Free objects, each free object stores the link to
+ *                            the next free object in its first bytes.
+ * @property total_objects  - Number of objects the cache carved from pages.
+ * @property used_objects   - Number of objects are allocated now.
+ */
+typedef struct {
+    uint64_t object_size;
+    HeadList free_list;
+    uint64_t total_objects;
+    uint64_t used_objects;
+} SlabCache;
+
+/* Public function prototype -------------------------------------------------*/
+/**
+ * @brief       Initialize an empty object cache, no page is allocated until the
+ *              first allocation.
+ *
+ * @param[in]   cache       - Object cache.
+ * @param[in]   object_size - Size of objects in bytes, at most PAGE_SIZE.
+ */
+void InitSlabCache(SlabCache *cache, uint64_t object_size);
+
+/**
+ * @brief       Allocate an object from the cache. The object is not cleared.
+ *
+ * @param[in]   cache       - Object cache.
+ * @return      void*       - Object address.
+ *                          - NULL if there is no free memory.
+ */
+void *SlabAlloc(SlabCache *cache);
+
+/**
+ * @brief       Give an object back to the cache which it was allocated from.
+ *
+ * @param[in]   cache       - Object cache.
+ * @param[in]   object      - Object address.
+ */
+void SlabFree(SlabCache *cache, void *object);
@@ -0,0 +1,118 @@
+#include <stddef.h>
+#include <errno.h>
+
+#include "softirq.h"
+#include "trap.h"
+#include "assert.h"
+
+/* Private define ------------------------------------------------------------*/
+/* Softirqs raised again while they run are run again, up to this many rounds.
+ * The rest waits for the next interrupt, so an interrupt storm can't keep the
+ * CPU in softirqs forever. */
+#define SOFTIRQ_MAXIMUM_ROUNDS      8
+
+/* Private type --------------------------------------------------------------*/
+/**
+ * @brief   Softirq state of a CPU.
+ *
+ * @property pending        - Bit mask of raised softirqs.
+ * @property in_softirq     - The softirq loop is running.
+ * @property hardirq_start  - TSC at the start of the top half.
+ * @property stats          - Statistics.
+ */
+typedef struct {
+    volatile uint32_t pending;
+    bool in_softirq;
+    uint64_t hardirq_start;
+    InterruptStats stats;
+} SoftirqCPU;
+
+/* Private variable ----------------------------------------------------------*/
+static SoftirqFunction s_softirq_functions[SOFTIRQ_COUNT];
+static SoftirqCPU s_softirq_cpu;                /* One CPU.                   */
+
+/* Private function prototypes -----------------------------------------------*/
+/**
+ * @brief   Run the pending softirqs with interrupts on.
+ */
+static void DoSoftirq(SoftirqCPU *cpu);
+
+/* Public function -----------------------------------------------------------*/
+void OpenSoftirq(int nr, SoftirqFunction func)
+{
+    ASSERT(nr >= 0 && nr < SOFTIRQ_COUNT);
+    s_softirq_functions[nr] = func;
+}
+
+void RaiseSoftirq(int nr)
+{
+    ASSERT(nr >= 0 && nr < SOFTIRQ_COUNT);
+    s_softirq_cpu.pending |= 1 << nr;
+}
+
+void IRQEnter(void)
+{
+    s_softirq_cpu.hardirq_start = ReadTSC();
+}
+
+void IRQExit(void)
+{
+    SoftirqCPU *cpu = &s_softirq_cpu;
+
+    cpu->stats.hardirq_count++;
+    cpu->stats.hardirq_cycles += ReadTSC() - cpu->hardirq_start;
+
+    if (!cpu->in_softirq && cpu->pending != 0) {
+        DoSoftirq(cpu);
+    }
+}
+
+bool InSoftirq(void)
+{
+    return s_softirq_cpu.in_softirq;
+}
+
+int GetInterruptStats(int cpu, InterruptStats *stats)
+{
+    if (cpu != 0) {
+        return -EINVAL;
+    }
+
+    *stats = s_softirq_cpu.stats;
+
+    return 0;
+}
+
+/* Private function ----------------------------------------------------------*/
+static void DoSoftirq(SoftirqCPU *cpu)
+{
+    uint32_t pending = 0;
+    uint64_t start = 0;
+
+    cpu->in_softirq = true;
+
+    for (int round = 0;
+         round < SOFTIRQ_MAXIMUM_ROUNDS && cpu->pending != 0;
+         round++) {
+        /* Take the mask with interrupts off, top halves raise new bits. */
+        pending = cpu->pending;
+        cpu->pending = 0;
+
+        EnableInterrupts();
+
+        for (int nr = 0; nr < SOFTIRQ_COUNT; nr++) {
+            if ((pending & (1 << nr)) == 0 || s_softirq_functions[nr] == NULL) {
+                continue;
+            }
+
+            start = ReadTSC();
+            s_softirq_functions[nr]();
+            cpu->stats.softirq_count[nr]++;
+            cpu->stats.softirq_cycles[nr] += ReadTSC() - start;
+        }
+
+        DisableInterrupts();
+    }
+
+    cpu->in_softirq = false;
+}
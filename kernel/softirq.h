@@ -0,0 +1,97 @@
+/**
+ * @file    softirq.h
+ * @author  Cong Nguyen (congnt264@gmail.com)
+ * @brief   Interrupts are handled in two stages. The top half runs in the
+ *          interrupt handler with interrupts off: it only acknowledges the
+ *          device, saves the data the device gives (a scan code) and raises a
+ *          softirq. The softirqs run when the handler exits, with interrupts
+ *          on, so the long work (decoding keys, running timers, waking up
+ *          processes) doesn't delay other interrupts.
+ *
+ *          The kernel code runs with interrupts off, so an interrupt only
+ *          arrives in user mode, in the IDLE process or in a softirq. An
+ *          interrupt which arrives in a softirq only runs its top half and
+ *          raises its softirq, the running softirq loop picks it up. So the
+ *          softirqs never run nested, and they only share the pending mask and
+ *          the data of the top halves with them.
+ *
+ *          The handler never switches process inside a softirq, a softirq
+ *          asks for it with SetNeedResched() (preempt.h), and the switch
+ *          happens after the softirqs, with interrupts off again.
+ *
+ * @version 0.1
+ * @date 2023-09-25
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Public define -------------------------------------------------------------*/
+#define SOFTIRQ_TIMER               0
+#define SOFTIRQ_KEYBOARD            1
+#define SOFTIRQ_COUNT               2
+
+/* Public type ---------------------------------------------------------------*/
+typedef void (*SoftirqFunction)(void);
+
+/**
+ * @brief   Interrupt statistics of a CPU, times are TSC cycles.
+ *
+ * @property hardirq_count  - Number of top halves.
+ * @property hardirq_cycles - Time in the top halves.
+ * @property softirq_count  - Number of runs per softirq.
+ * @property softirq_cycles - Time per softirq, it includes the top halves of
+ *                            the interrupts which arrived meanwhile.
+ */
+typedef struct {
+    uint64_t hardirq_count;
+    uint64_t hardirq_cycles;
+    uint64_t softirq_count[SOFTIRQ_COUNT];
+    uint64_t softirq_cycles[SOFTIRQ_COUNT];
+} InterruptStats;
+
+/* Public function prototype -------------------------------------------------*/
+/**
+ * @brief       Set the function of a softirq.
+ *
+ * @param[in]   nr          - SOFTIRQ_*.
+ * @param[in]   func        - Function, it runs with interrupts on.
+ */
+void OpenSoftirq(int nr, SoftirqFunction func);
+
+/**
+ * @brief       Mark a softirq pending on the current CPU, it runs when the
+ *              interrupt handler exits.
+ *
+ * @param[in]   nr          - SOFTIRQ_*.
+ */
+void RaiseSoftirq(int nr);
+
+/**
+ * @brief       Start of a top half.
+ */
+void IRQEnter(void);
+
+/**
+ * @brief       End of a top half, run the pending softirqs unless a softirq is
+ *              already running on this CPU.
+ */
+void IRQExit(void);
+
+/**
+ * @brief       Check the CPU is running a softirq, switching process is not
+ *              allowed there.
+ */
+bool InSoftirq(void);
+
+/**
+ * @brief       Get the interrupt statistics.
+ *
+ * @param[in]   cpu         - CPU index.
+ * @param[out]  stats       - Statistics.
+ * @return      int         - 0 on success, -EINVAL if there is no such CPU.
+ */
+int GetInterruptStats(int cpu, InterruptStats *stats);
@@ -1,6 +1,7 @@
 
 #include <stddef.h>
 #include <errno.h>
+#include <string.h>
 
 #include "file.h"
 #include "process.h"
@@ -9,65 +10,133 @@
 #include "memory.h"
 #include "assert.h"
 #include "printk.h"
+#include "timer.h"
+#include "clock.h"
+#include "ioring.h"
+#include "softirq.h"
+#include "preempt.h"
+#include "bcache.h"
 
 /* Private define ------------------------------------------------------------*/
-#define MAXIMUM_SYSTEM_CALLS 20
+#define IA32_EFER_MSR               0xC0000080
+#define IA32_STAR_MSR               0xC0000081
+#define IA32_LSTAR_MSR              0xC0000082
+#define IA32_FMASK_MSR              0xC0000084
+#define IA32_KERNEL_GS_BASE_MSR     0xC0000102
+#define EFER_SYSCALL_ENABLE         (1 << 0)
+
+/* SYSCALL loads CS from STAR[47:32] and SS from STAR[47:32] + 8. SYSRET loads
+ * SS from STAR[63:48] + 8 and CS from STAR[63:48] + 16, both with RPL 3. */
+#define STAR_KERNEL_BASE_SELECTOR   0x08
+#define STAR_USER_BASE_SELECTOR     0x10
+
+/* Flags are cleared on the entry: IF, TF, DF and AC. */
+#define SYSCALL_FLAGS_MASK          ((1 << 9) | (1 << 8) | (1 << 10) | (1 << 18))
 
 /* Private variable ----------------------------------------------------------*/
 static SYSTEM_CALL s_syscall_table[MAXIMUM_SYSTEM_CALLS] = {0};
+static SyscallCPUData s_syscall_cpu;            /* One CPU, one TSS.      */
 
 /* Private function prototype ------------------------------------------------*/
-static int SysWrite(int64_t *arg);
-static int SysSleep(int64_t *arg);
-static int SysExit(int64_t *arg);
-static int SysWait(int64_t *arg);
-static int SysRead(int64_t *arg);
-static int SysOpen(int64_t *arg);
-static int SysClose(int64_t *arg);
-static int SysFork(int64_t *arg);
-static int SysExec(int64_t *arg);
-static int SysLstat(int64_t *arg);
-static int SysClrSrc(int64_t *arg);
-
-static int SysMemInfo(int64_t *arg);
+SYSCALL_DECLARE(Write);
+SYSCALL_DECLARE(Sleep);
+SYSCALL_DECLARE(Exit);
+SYSCALL_DECLARE(Wait);
+SYSCALL_DECLARE(Read);
+SYSCALL_DECLARE(Open);
+SYSCALL_DECLARE(Close);
+SYSCALL_DECLARE(Fork);
+SYSCALL_DECLARE(Exec);
+SYSCALL_DECLARE(Lstat);
+SYSCALL_DECLARE(ClrSrc);
+
+SYSCALL_DECLARE(MemInfo);
+SYSCALL_DECLARE(Clone);
+SYSCALL_DECLARE(ThreadExit);
+SYSCALL_DECLARE(ThreadJoin);
+SYSCALL_DECLARE(Spawn);
+SYSCALL_DECLARE(ClockGetTime);
+SYSCALL_DECLARE(NanoSleep);
+SYSCALL_DECLARE(GetPID);
+SYSCALL_DECLARE(Multicall);
+SYSCALL_DECLARE(IORingSetup);
+SYSCALL_DECLARE(IORingEnter);
+SYSCALL_DECLARE(SyscallStat);
+SYSCALL_DECLARE(IRQStat);
+SYSCALL_DECLARE(PreemptStat);
+SYSCALL_DECLARE(BufferCacheStat);
 
 static void RegisterSystemCall(uint16_t num, SYSTEM_CALL call);
 
+/**
+ * @brief   Run a system call with the arguments in an array.
+ *
+ * @return  Return value of the system call, -ENOSYS if the number is invalid.
+ */
+static int64_t CallSystemCall(uint64_t number, const int64_t args[6]);
+
+/**
+ * @brief   Count a finished system call in the statistics of this CPU.
+ */
+static void RecordSystemCall(uint64_t number, uint64_t cycles);
+
 /* Public function -----------------------------------------------------------*/
 void InitSystemCall(void)
 {
-    RegisterSystemCall(0, SysWrite);
-    RegisterSystemCall(1, SysSleep);
-    RegisterSystemCall(2, SysExit);
-    RegisterSystemCall(3, SysWait);
-    RegisterSystemCall(4, SysRead);
-    RegisterSystemCall(5, SysMemInfo);
-    RegisterSystemCall(6, SysOpen);
-    RegisterSystemCall(7, SysClose);
-    RegisterSystemCall(8, SysFork);
-    RegisterSystemCall(9, SysExec);
-    RegisterSystemCall(10, SysLstat);
-    RegisterSystemCall(11, SysClrSrc);
+    RegisterSystemCall(SYS_WRITE, SYSCALL_ENTRY(Write));
+    RegisterSystemCall(SYS_SLEEP, SYSCALL_ENTRY(Sleep));
+    RegisterSystemCall(SYS_EXIT, SYSCALL_ENTRY(Exit));
+    RegisterSystemCall(SYS_WAIT, SYSCALL_ENTRY(Wait));
+    RegisterSystemCall(SYS_READ, SYSCALL_ENTRY(Read));
+    RegisterSystemCall(SYS_MEMINFO, SYSCALL_ENTRY(MemInfo));
+    RegisterSystemCall(SYS_OPEN, SYSCALL_ENTRY(Open));
+    RegisterSystemCall(SYS_CLOSE, SYSCALL_ENTRY(Close));
+    RegisterSystemCall(SYS_FORK, SYSCALL_ENTRY(Fork));
+    RegisterSystemCall(SYS_EXEC, SYSCALL_ENTRY(Exec));
+    RegisterSystemCall(SYS_LSTAT, SYSCALL_ENTRY(Lstat));
+    RegisterSystemCall(SYS_CLRSRC, SYSCALL_ENTRY(ClrSrc));
+    RegisterSystemCall(SYS_CLONE, SYSCALL_ENTRY(Clone));
+    RegisterSystemCall(SYS_THREAD_EXIT, SYSCALL_ENTRY(ThreadExit));
+    RegisterSystemCall(SYS_THREAD_JOIN, SYSCALL_ENTRY(ThreadJoin));
+    RegisterSystemCall(SYS_SPAWN, SYSCALL_ENTRY(Spawn));
+    RegisterSystemCall(SYS_CLOCK_GETTIME, SYSCALL_ENTRY(ClockGetTime));
+    RegisterSystemCall(SYS_NANOSLEEP, SYSCALL_ENTRY(NanoSleep));
+    RegisterSystemCall(SYS_GETPID, SYSCALL_ENTRY(GetPID));
+    RegisterSystemCall(SYS_MULTICALL, SYSCALL_ENTRY(Multicall));
+    RegisterSystemCall(SYS_IORING_SETUP, SYSCALL_ENTRY(IORingSetup));
+    RegisterSystemCall(SYS_IORING_ENTER, SYSCALL_ENTRY(IORingEnter));
+    RegisterSystemCall(SYS_SYSCALL_STAT, SYSCALL_ENTRY(SyscallStat));
+    RegisterSystemCall(SYS_IRQ_STAT, SYSCALL_ENTRY(IRQStat));
+    RegisterSystemCall(SYS_PREEMPT_STAT, SYSCALL_ENTRY(PreemptStat));
+    RegisterSystemCall(SYS_BCACHE_STAT, SYSCALL_ENTRY(BufferCacheStat));
+
+    /* Enable the SYSCALL/SYSRET instructions. */
+    WriteMSR(IA32_STAR_MSR,
+             ((uint64_t)STAR_USER_BASE_SELECTOR << 48)
+             | ((uint64_t)STAR_KERNEL_BASE_SELECTOR << 32));
+    WriteMSR(IA32_LSTAR_MSR, (uint64_t)SyscallEntry);
+    WriteMSR(IA32_FMASK_MSR, SYSCALL_FLAGS_MASK);
+    WriteMSR(IA32_KERNEL_GS_BASE_MSR, (uint64_t)&s_syscall_cpu);
+    WriteMSR(IA32_EFER_MSR, ReadMSR(IA32_EFER_MSR) | EFER_SYSCALL_ENABLE);
+}
 
+void SetSyscallKernelStack(uint64_t stack)
+{
+    s_syscall_cpu.kernel_stack = stack;
 }
 
 void SystemCall(TrapFrame *tf)
 {
-    /* `rax` is used to hold the index number of system call.
-     * `rdi` hold the param count.
-     * `rsi` points to the arguments we passed to the function.
-     * We return to the ring 3 user application via `rax`. */
-    int64_t syscall_number = tf->rax;
-    int64_t param_count = tf->rdi;
-    int64_t *arg = (int64_t *)tf->rsi;
+    /* `rax` holds the index number of system call, the arguments are in `rdi`,
+     * `rsi`, `rdx`, `r10`, `r8` and `r9`. `rcx` can't be used, SYSCALL saves
+     * the user `rip` in it. We return to the ring 3 user application via
+     * `rax`. */
+    int64_t args[6] = {tf->rdi, tf->rsi, tf->rdx, tf->r10, tf->r8, tf->r9};
+    uint64_t number = tf->rax;
 
-    if (param_count < 0
-        || syscall_number > MAXIMUM_SYSTEM_CALLS) {
-        tf->rax = -EINVAL;
-        return;
-    }
-    ASSERT(s_syscall_table[syscall_number] != NULL);
-    tf->rax = s_syscall_table[syscall_number](arg);
+    PreemptSectionStart();
+    tf->rax = CallSystemCall(number, args);
+    PreemptSectionEnd(PREEMPT_SECTION_SYSCALL, number);
 }
 
 /* Private function ----------------------------------------------------------*/
@@ -78,57 +147,92 @@ static void RegisterSystemCall(uint16_t num, SYSTEM_CALL call)
     s_syscall_table[num] = call;
 }
 
-static int SysWrite(int64_t *arg)
+static int64_t CallSystemCall(uint64_t number, const int64_t args[6])
 {
-    /* TODO: implement file descriptor manager. */
-    int16_t file_descriptor = arg[0];
-    char *buffer = (char *)arg[1];
-    int32_t length = arg[2];
-    printk(buffer);
-    return length;
+    uint64_t start = 0;
+    int64_t ret = 0;
+
+    if (number >= MAXIMUM_SYSTEM_CALLS || s_syscall_table[number] == NULL) {
+        return -ENOSYS;
+    }
+
+    start = ReadTSC();
+    ret = s_syscall_table[number](args[0],
+                                  args[1],
+                                  args[2],
+                                  args[3],
+                                  args[4],
+                                  args[5]);
+    RecordSystemCall(number, ReadTSC() - start);
+
+    return ret;
 }
 
-static int SysSleep(int64_t *arg)
+static void RecordSystemCall(uint64_t number, uint64_t cycles)
 {
-    uint64_t old_ticks = 0;
-    uint64_t ticks = 0;
-    uint64_t sleep_ticks = arg[0];
+    SyscallStats *stats = &s_syscall_cpu.stats[number];
+    int bucket = 0;
 
-    /* Get current ticks. */
-    ticks = GetTicks();
-    old_ticks = ticks;
+    /* Bucket is the index of the highest set bit. */
+    if (cycles > 0) {
+        bucket = 63 - __builtin_clzll(cycles);
+    }
 
-    /* Block current process here until wakeup time is retrieved. */
-    while (ticks - old_ticks < sleep_ticks) {
-        Sleep(NORMAL_PROCESS_WAIT_ID);
-        /* After wakeup from sleep, we get ticks again, and check process is
-         * ready to run or not. If the time is not achieved, we sleep again. */
-        ticks = GetTicks();
+    if (bucket >= SYSCALL_LATENCY_BUCKETS) {
+        bucket = SYSCALL_LATENCY_BUCKETS - 1;
     }
 
-    return 0;
+    stats->count++;
+    stats->cycles += cycles;
+    stats->histogram[bucket]++;
 }
 
-static int SysExit(int64_t *arg)
+SYSCALL_DEFINE3(Write, int, fd, const char *, buffer, int64_t, length)
 {
-    Exit();
+    /* Only the console can be written. */
+    if (fd != STANDARD_OUTPUT && fd != STANDARD_ERROR) {
+        return -EBADF;
+    }
+
+    if (length < 0 || !IsUserRange((uint64_t)buffer, length)) {
+        return -EFAULT;
+    }
+
+    /* The data is not a format string, and it doesn't need a terminator. */
+    return WriteConsole(buffer, length);
+}
+
+SYSCALL_DEFINE1(Sleep, uint64_t, sleep_ticks)
+{
+    /* The sleep unit is the old 10ms timer tick. The process sleeps on its own
+     * timer, it is only woken up once when the time is achieved. */
+    TimerSleep(sleep_ticks * TIMER_TICK_US);
+
     return 0;
 }
 
-static int SysWait(int64_t *arg)
+SYSCALL_DEFINE1(Exit, int64_t, status)
 {
-    int pid = arg[0];
-    Wait(pid);
+    Exit(status);
     return 0;
 }
 
-static int SysRead(int64_t *arg)
+SYSCALL_DEFINE3(Wait, int, pid, int *, status, int, options)
 {
-    int16_t file_descriptor = arg[0];
+    if (status != NULL && !IsUserRange((uint64_t)status, sizeof(int))) {
+        return -EFAULT;
+    }
+
+    return WaitPID(pid, status, options);
+}
+
+SYSCALL_DEFINE3(Read, int, fd, char *, buffer, int64_t, length)
+{
+    if (length < 0 || !IsUserRange((uint64_t)buffer, length)) {
+        return -EFAULT;
+    }
 
-    char *buffer = (char *)arg[1];
-    int32_t length = arg[2];
-    if (file_descriptor == STANDARD_INPUT) {
+    if (fd == STANDARD_INPUT) {
         /* Read from standard input. */
         for (int i = 0; i < length; i++) {
             buffer[i] = ReadKeyBuffer();
@@ -138,47 +242,236 @@ static int SysRead(int64_t *arg)
     }
 
     /* Read file. */
-    return Read(GetScheduler()->current_proc, file_descriptor, buffer, length);
+    return Read(GetScheduler()->current_proc, fd, buffer, length);
 }
 
-static int SysMemInfo(int64_t *arg)
+SYSCALL_DEFINE0(MemInfo)
 {
     return GetTotalMem();
 }
 
-static int SysOpen(int64_t *arg)
+SYSCALL_DEFINE1(Open, const char *, file_name)
 {
-    char *file_name = arg[0];
+    if (!IsUserString(file_name)) {
+        return -EFAULT;
+    }
+
     return Open(GetScheduler()->current_proc, file_name);
 }
 
-static int SysClose(int64_t *arg)
+SYSCALL_DEFINE1(Close, int, fd)
 {
-    int16_t file_descriptor = arg[0];
-    Close(GetScheduler()->current_proc, file_descriptor);
+    Close(GetScheduler()->current_proc, fd);
     return 0;
 }
 
-static int SysFork(int64_t *arg)
+SYSCALL_DEFINE0(Fork)
 {
     return Fork();
 }
 
-static int SysExec(int64_t *arg)
+SYSCALL_DEFINE1(Exec, const char *, file_name)
 {
-    char *file_name = arg[0];
+    if (!IsUserString(file_name)) {
+        return -EFAULT;
+    }
+
     return Exec(GetScheduler()->current_proc, file_name);
 }
 
-static int SysLstat(int64_t *arg)
+SYSCALL_DEFINE3(Lstat, const char *, path, DirEntry *, statbuf, int, count)
 {
-    char *path = arg[0];
-    DirEntry *statbuf = arg[1];
-    return Lstat(path, statbuf);
+    if (count < 0) {
+        return -EINVAL;
+    }
+
+    if (!IsUserString(path)
+        || !IsUserRange((uint64_t)statbuf,
+                        (uint64_t)count * sizeof(DirEntry))) {
+        return -EFAULT;
+    }
+
+    return Lstat(path, statbuf, count);
 }
 
-static int SysClrSrc(int64_t *arg)
+SYSCALL_DEFINE0(ClrSrc)
 {
     ClrSrc();
     return 0;
 }
+
+SYSCALL_DEFINE4(Clone,
+                uint64_t, entry,
+                uint64_t, stack,
+                uint64_t, arg,
+                uint64_t, tls)
+{
+    return Clone(entry, stack, arg, tls);
+}
+
+SYSCALL_DEFINE1(ThreadExit, int64_t, exit_code)
+{
+    Exit(exit_code);
+    return 0;
+}
+
+SYSCALL_DEFINE2(ThreadJoin, int, tid, int64_t *, exit_code)
+{
+    if (exit_code != NULL
+        && !IsUserRange((uint64_t)exit_code, sizeof(int64_t))) {
+        return -EFAULT;
+    }
+
+    return ThreadJoin(tid, exit_code);
+}
+
+SYSCALL_DEFINE4(Spawn,
+                const char *, path,
+                char *const *, argv,
+                const SpawnFileAction *, actions,
+                int, action_count)
+{
+    /* Spawn() checks each argument string, it knows where the array ends. */
+    if (!IsUserString(path)
+        || (action_count > 0
+            && !IsUserRange((uint64_t)actions,
+                            action_count * sizeof(SpawnFileAction)))) {
+        return -EFAULT;
+    }
+
+    return Spawn(path, argv, actions, action_count);
+}
+
+SYSCALL_DEFINE2(ClockGetTime, int, clock_id, TimeSpec *, ts)
+{
+    if (!IsUserRange((uint64_t)ts, sizeof(TimeSpec))) {
+        return -EFAULT;
+    }
+
+    return ClockGetTime(clock_id, ts);
+}
+
+SYSCALL_DEFINE2(NanoSleep, const TimeSpec *, req, TimeSpec *, rem)
+{
+    if (!IsUserRange((uint64_t)req, sizeof(TimeSpec))
+        || (rem != NULL && !IsUserRange((uint64_t)rem, sizeof(TimeSpec)))) {
+        return -EFAULT;
+    }
+
+    return NanoSleep(req, rem);
+}
+
+SYSCALL_DEFINE0(GetPID)
+{
+    return GetScheduler()->current_proc->tgid;
+}
+
+SYSCALL_DEFINE3(Multicall,
+                MulticallEntry *, entries,
+                int64_t, count,
+                int64_t, flags)
+{
+    int64_t i = 0;
+
+    if (count < 0 || count > MULTICALL_MAXIMUM_ENTRIES) {
+        return -EINVAL;
+    }
+
+    if (!IsUserRange((uint64_t)entries, count * sizeof(MulticallEntry))) {
+        return -EFAULT;
+    }
+
+    for (i = 0; i < count; i++) {
+        switch (entries[i].number) {
+        case SYS_FORK:
+        case SYS_EXEC:
+        case SYS_CLONE:
+        case SYS_MULTICALL:
+            /* These work on the trap frame of the caller, the frame doesn't
+             * belong to an entry of the batch. */
+            entries[i].result = -EINVAL;
+            break;
+        default:
+            entries[i].result = CallSystemCall(entries[i].number,
+                                               entries[i].args);
+            break;
+        }
+
+        if (entries[i].result < 0 && (flags & MULTICALL_STOP_ON_ERROR)) {
+            i++;
+            break;
+        }
+    }
+
+    /* Number of entries which were run. */
+    return i;
+}
+
+SYSCALL_DEFINE2(IORingSetup, IORing *, ring, uint32_t, flags)
+{
+    return IORingSetup(GetScheduler()->current_proc, (uint64_t)ring, flags);
+}
+
+SYSCALL_DEFINE3(IORingEnter,
+                uint32_t, to_submit,
+                uint32_t, min_complete,
+                uint32_t, flags)
+{
+    return IORingEnter(GetScheduler()->current_proc,
+                       to_submit,
+                       min_complete,
+                       flags);
+}
+
+SYSCALL_DEFINE3(SyscallStat,
+                int, cpu,
+                SyscallStats *, stats,
+                int64_t, count)
+{
+    /* One CPU, one SYSCALL data. */
+    if (cpu != 0 || count < 0) {
+        return -EINVAL;
+    }
+
+    if (count > MAXIMUM_SYSTEM_CALLS) {
+        count = MAXIMUM_SYSTEM_CALLS;
+    }
+
+    if (!IsUserRange((uint64_t)stats, count * sizeof(SyscallStats))) {
+        return -EFAULT;
+    }
+
+    memcpy(stats, s_syscall_cpu.stats, count * sizeof(SyscallStats));
+
+    /* Number of entries which were copied. */
+    return count;
+}
+
+SYSCALL_DEFINE2(IRQStat, int, cpu, InterruptStats *, stats)
+{
+    if (!IsUserRange((uint64_t)stats, sizeof(InterruptStats))) {
+        return -EFAULT;
+    }
+
+    return GetInterruptStats(cpu, stats);
+}
+
+SYSCALL_DEFINE2(PreemptStat, int, cpu, PreemptStats *, stats)
+{
+    if (!IsUserRange((uint64_t)stats, sizeof(PreemptStats))) {
+        return -EFAULT;
+    }
+
+    return GetPreemptStats(cpu, stats);
+}
+
+SYSCALL_DEFINE1(BufferCacheStat, BufferCacheStats *, stats)
+{
+    if (!IsUserRange((uint64_t)stats, sizeof(BufferCacheStats))) {
+        return -EFAULT;
+    }
+
+    GetBufferCacheStats(stats);
+
+    return 0;
+}
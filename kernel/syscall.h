@@ -20,13 +20,12 @@
  *          Step 1: User prepare for requesting service:
  *              + When the user program want to request a kernel service, it
  *                have to prepare argument by itself.
- *              + Step 1.1: Create a stack frame (number of arguments * 8) bytes
- *                to save arguments.
- *              + Step 1.2: Set system call number to `eax` register.
- *              + Step 1.3: Set arguments to the stack frame.
- *              + Step 1.4: set number of arguments to `rdi`.
- *              + Step 1.5: Set stack pointer (User stack frame) to `rsi`.
- *              + Step 1.6: Calling interrupt 0x80, so from now we run in
+ *              + Step 1.1: Set system call number to `rax` register.
+ *              + Step 1.2: Set arguments to `rdi`, `rsi`, `rdx`, `r10`, `r8`
+ *                and `r9`, in order. It is the x86-64 calling convention,
+ *                except `r10` replaces `rcx`, because SYSCALL overwrites
+ *                `rcx`.
+ *              + Step 1.3: Calling interrupt 0x80, so from now we run in
  *                kernel mode.
  *          Step 2: Kernel catch the interrupt and handle it.
  *              + Normally, all interrupts are only fired in ring 0, so for 0x80
@@ -58,10 +57,10 @@
  *                  + So when we have stack frame, we can get arguments which
  *                    user set before they call `int 0x80` (step 1).
  *                  + We get system call number from trap frame -> `rax`.
- *                  + We get param count via trap frame -> `rdi`.
- *                  + we get params via trap frame -> `rsi` that is the user
- *                    stack frame address.
- *                  + Calling corresponding service.
+ *                  + We get params from the saved registers of the trap
+ *                    frame, so the kernel doesn't read them from user memory.
+ *                  + Calling corresponding service, the service checks every
+ *                    user pointer it gets before it uses the pointer.
  *                  + Set return code to trap frame -> `rax`.
  *                  + Return to the `Trap`.
  *          Step 3: Return to the trap, restore CPU state and back to user mode.
@@ -75,14 +74,19 @@
  *                send error code back to user.
  *              + Call `iretq` to return from IRQ, so from now we run in user
  *                mode.
- *          Step 4: After back from kernel, we clear user stack frame, we make
- *          in Step 1.1.
- *              + The `rax` still hold return from kernel, so if we call this
- *                function in C, this will be returned automatically by x86
- *                calling conventions.
+ *          Step 4: After back from kernel, `rax` holds the return value. The
+ *          user wrappers are inline functions (usr/runtime syscall.h), so a
+ *          system call is only a few register moves and the instruction.
  *
  *          So that is the way we request a kernel service from user, the kernel
  *          service actually run in interrupt 0x80 context.
+ *
+ *          The runtime uses the SYSCALL instruction instead of `int 0x80`, with
+ *          the same registers. SYSCALL doesn't go through the IDT and the TSS,
+ *          and SYSRET is much cheaper than `iretq`. The entry `SyscallEntry`
+ *          switches to the kernel stack with SWAPGS and builds the same trap
+ *          frame, so handlers don't know how they were called. `int 0x80` is
+ *          still supported.
  *          And also note that when we switch to kernel mode, the stack we use
  *          actually is the process's kernel stack.
  * 
@@ -96,15 +100,147 @@
 #pragma once
 #include "trap.h"
 
+/* Public define -------------------------------------------------------------*/
+/**
+ * @def Define a system call handler with typed parameters. The macro defines
+ * the table entry `SysEntry<name>`, which gets the six argument registers and
+ * casts them to the parameter types of the handler `Sys<name>`. For example:
+ *
+ *      SYSCALL_DEFINE2(Open, const char *, path, int, flags)
+ *      {
+ *          ...
+ *      }
+ */
+#define SYSCALL_ENTRY(name)     SysEntry##name
+#define SYSCALL_DECLARE(name)                                                  \
+    static int64_t SYSCALL_ENTRY(name)(int64_t, int64_t, int64_t,              \
+                                       int64_t, int64_t, int64_t)
+
+#define SYSCALL_DEFINE_ENTRY(name, params, args)                               \
+    static int64_t Sys##name params;                                           \
+    static int64_t SYSCALL_ENTRY(name)(int64_t a0, int64_t a1, int64_t a2,     \
+                                       int64_t a3, int64_t a4, int64_t a5)     \
+    {                                                                          \
+        return Sys##name args;                                                 \
+    }                                                                          \
+    static int64_t Sys##name params
+
+#define SYSCALL_DEFINE0(name)                                                  \
+    SYSCALL_DEFINE_ENTRY(name, (void), ())
+#define SYSCALL_DEFINE1(name, t0, p0)                                          \
+    SYSCALL_DEFINE_ENTRY(name, (t0 p0), ((t0)a0))
+#define SYSCALL_DEFINE2(name, t0, p0, t1, p1)                                  \
+    SYSCALL_DEFINE_ENTRY(name, (t0 p0, t1 p1), ((t0)a0, (t1)a1))
+#define SYSCALL_DEFINE3(name, t0, p0, t1, p1, t2, p2)                          \
+    SYSCALL_DEFINE_ENTRY(name,                                                 \
+                         (t0 p0, t1 p1, t2 p2),                                \
+                         ((t0)a0, (t1)a1, (t2)a2))
+#define SYSCALL_DEFINE4(name, t0, p0, t1, p1, t2, p2, t3, p3)                  \
+    SYSCALL_DEFINE_ENTRY(name,                                                 \
+                         (t0 p0, t1 p1, t2 p2, t3 p3),                         \
+                         ((t0)a0, (t1)a1, (t2)a2, (t3)a3))
+
+#define MAXIMUM_SYSTEM_CALLS        32
+#define SYSCALL_LATENCY_BUCKETS     32  /* Bucket i: [2^i, 2^(i+1)) cycles.   */
+
+#define MULTICALL_MAXIMUM_ENTRIES   64
+#define MULTICALL_STOP_ON_ERROR     1   /* Stop after a negative result.      */
+
 /* Public type ---------------------------------------------------------------*/
 /**
- * @brief       - System call handlers.
- * 
- * @param arg   - Data on the stack in user mode.
+ * @brief   System call numbers, they are shared with usr/runtime syscall.h.
+ */
+typedef enum {
+    SYS_WRITE = 0,
+    SYS_SLEEP = 1,
+    SYS_EXIT = 2,
+    SYS_WAIT = 3,
+    SYS_READ = 4,
+    SYS_MEMINFO = 5,
+    SYS_OPEN = 6,
+    SYS_CLOSE = 7,
+    SYS_FORK = 8,
+    SYS_EXEC = 9,
+    SYS_LSTAT = 10,
+    SYS_CLRSRC = 11,
+    SYS_CLONE = 12,
+    SYS_THREAD_EXIT = 13,
+    SYS_THREAD_JOIN = 14,
+    SYS_SPAWN = 15,
+    SYS_CLOCK_GETTIME = 16,
+    SYS_NANOSLEEP = 17,
+    SYS_GETPID = 18,
+    SYS_MULTICALL = 19,
+    SYS_IORING_SETUP = 20,
+    SYS_IORING_ENTER = 21,
+    SYS_SYSCALL_STAT = 22,
+    SYS_IRQ_STAT = 23,
+    SYS_PREEMPT_STAT = 24,
+    SYS_BCACHE_STAT = 25
+} SystemCallNumber;
+
+/**
+ * @brief       - System call table entry.
+ *
+ * @param a0-a5 - Argument registers: `rdi`, `rsi`, `rdx`, `r10`, `r8`, `r9`.
  * @return      - Error code to return to the user.
  */
-typedef int (*SYSTEM_CALL)(int64_t *arg);
+typedef int64_t (*SYSTEM_CALL)(int64_t a0, int64_t a1, int64_t a2,
+                               int64_t a3, int64_t a4, int64_t a5);
+
+/**
+ * @brief   One system call of a multicall batch, the layout is shared with
+ *          usr/runtime multicall.h.
+ *
+ * @property number     - System call number.
+ * @property args       - Arguments, in register order.
+ * @property result     - Return value, it is written by the kernel.
+ */
+typedef struct {
+    int64_t number;
+    int64_t args[6];
+    int64_t result;
+} MulticallEntry;
+
+/**
+ * @brief   Counters of one system call on one CPU, the layout is shared with
+ *          usr/runtime scstat.h. Times are TSC cycles, they include the time
+ *          the caller slept in the call.
+ *
+ * @property count      - Number of calls.
+ * @property cycles     - Total time of the calls.
+ * @property histogram  - Number of calls per log2 time bucket, the last bucket
+ *                        also counts the longer calls.
+ */
+typedef struct {
+    uint64_t count;
+    uint64_t cycles;
+    uint64_t histogram[SYSCALL_LATENCY_BUCKETS];
+} SyscallStats;
+
+/**
+ * @brief   Per-CPU data of the SYSCALL entry, the kernel GS base points to it.
+ *          The offsets are used in `SyscallEntry`, new fields go to the end.
+ *
+ * @property kernel_stack   - Top of the kernel stack of current process.
+ * @property user_stack     - Saved user stack pointer while we switch stacks.
+ * @property stats          - Counters of the system calls which ran on this
+ *                            CPU, indexed by number. They are only written by
+ *                            this CPU, so they need no lock.
+ */
+typedef struct {
+    uint64_t kernel_stack;
+    uint64_t user_stack;
+    SyscallStats stats[MAXIMUM_SYSTEM_CALLS];
+} SyscallCPUData;
 
 /* Public function prototype -------------------------------------------------*/
 void InitSystemCall(void);
-void SystemCall(TrapFrame *tf);
\ No newline at end of file
+void SystemCall(TrapFrame *tf);
+
+/**
+ * @brief   Set the kernel stack the SYSCALL entry switches to.
+ *
+ * @param   stack   - Top of the kernel stack.
+ */
+void SetSyscallKernelStack(uint64_t stack);
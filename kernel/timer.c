@@ -0,0 +1,276 @@
+#include <stddef.h>
+
+#include "timer.h"
+#include "lapic.h"
+#include "process.h"
+#include "trap.h"
+#include "ioapic.h"
+#include "softirq.h"
+#include "preempt.h"
+#include "printk.h"
+
+/* Private define ------------------------------------------------------------*/
+#define TIMER_NO_DEADLINE           UINT64_MAX
+#define US_PER_SECOND               1000000
+
+/* Private type --------------------------------------------------------------*/
+/**
+ * @brief   A timer which wakes up a sleeping process.
+ */
+typedef struct {
+    Timer timer;
+    bool fired;
+    WaitQueue wait_queue;
+} SleepTimer;
+
+/* Private variable ----------------------------------------------------------*/
+static bool s_use_lapic = false;
+static HeadList s_timer_list;               /* Sorted by expiry time.         */
+static uint64_t s_slice_deadline = TIMER_NO_DEADLINE;
+
+/* PIT mode: uptime in ticks. LAPIC mode: elapsed timer ticks before the
+ * current one-shot period started, and the count of the period. */
+static uint64_t s_pit_ticks = 0;
+static uint64_t s_clock_ticks = 0;
+static uint32_t s_programmed_count = 0;
+
+/* Private function prototypes -----------------------------------------------*/
+/**
+ * @brief   Program the LAPIC timer for the nearest event.
+ */
+static void ProgramNextEvent(void);
+
+/**
+ * @brief   Elapsed LAPIC timer ticks since boot.
+ */
+static uint64_t GetClockTicks(void);
+
+static void SleepTimerExpired(Timer *timer);
+
+/**
+ * @brief   Bottom half of the timer interrupt: runs expired timers, ends the
+ *          time slice and programs the next event.
+ */
+static void TimerSoftirq(void);
+
+/* Public function -----------------------------------------------------------*/
+void InitTimer(void)
+{
+    s_timer_list.next = NULL;
+    s_timer_list.tail = NULL;
+
+    OpenSoftirq(SOFTIRQ_TIMER, TimerSoftirq);
+
+    s_use_lapic = InitLAPIC();
+    if (!s_use_lapic) {
+        printk("Timer: no local APIC, using the 100Hz PIT tick.\n");
+        return;
+    }
+
+    /* The local APIC timer uses the vector of the PIT, the PIT is masked. */
+    DisableIRQ(PIT_IRQ);
+
+    ProgramNextEvent();
+}
+
+void TimerInterrupt(void)
+{
+    if (s_use_lapic) {
+        LAPICEOI();
+    } else {
+        s_pit_ticks++;
+        EOI();
+    }
+
+    RaiseSoftirq(SOFTIRQ_TIMER);
+}
+
+uint64_t GetUptimeUS(void)
+{
+    uint64_t ticks = 0;
+    uint64_t frequency = 0;
+
+    if (!s_use_lapic) {
+        return s_pit_ticks * TIMER_TICK_US;
+    }
+
+    ticks = GetClockTicks();
+    frequency = LAPICTimerFrequency();
+
+    /* Split the division, so it doesn't overflow. */
+    return (ticks / frequency) * US_PER_SECOND
+           + (ticks % frequency) * US_PER_SECOND / frequency;
+}
+
+void InitTimerEntry(Timer *timer, TimerFunction func)
+{
+    timer->next = NULL;
+    timer->expires = 0;
+    timer->func = func;
+    timer->active = false;
+}
+
+void AddTimer(Timer *timer, uint64_t expires)
+{
+    List *prev = NULL;
+    List *current = NULL;
+
+    DeleteTimer(timer);
+
+    timer->expires = expires;
+    timer->active = true;
+
+    /* Find the first timer which expires later. */
+    current = s_timer_list.next;
+    while (current != NULL && ((Timer *)current)->expires <= expires) {
+        prev = current;
+        current = current->next;
+    }
+
+    timer->next = current;
+    if (prev == NULL) {
+        s_timer_list.next = (List *)timer;
+    } else {
+        prev->next = (List *)timer;
+    }
+
+    if (current == NULL) {
+        s_timer_list.tail = (List *)timer;
+    }
+
+    /* The new timer is the nearest event. */
+    if (prev == NULL && s_use_lapic) {
+        ProgramNextEvent();
+    }
+}
+
+void DeleteTimer(Timer *timer)
+{
+    if (timer->active) {
+        ListRemove(&s_timer_list, (List *)timer);
+        timer->active = false;
+    }
+}
+
+void TimerSleep(uint64_t us)
+{
+    SleepTimer sleep_timer;
+
+    InitTimerEntry(&sleep_timer.timer, SleepTimerExpired);
+    InitWaitQueue(&sleep_timer.wait_queue);
+    sleep_timer.fired = false;
+
+    AddTimer(&sleep_timer.timer, GetUptimeUS() + us);
+
+    while (!sleep_timer.fired) {
+        Sleep(&sleep_timer.wait_queue);
+    }
+}
+
+void StartTimeSlice(bool contended)
+{
+    if (!contended) {
+        /* Nobody is waiting, so the process runs without the tick. */
+        s_slice_deadline = TIMER_NO_DEADLINE;
+        return;
+    }
+
+    s_slice_deadline = GetUptimeUS() + SCHEDULER_TIME_SLICE_US;
+    if (s_use_lapic) {
+        ProgramNextEvent();
+    }
+}
+
+void RequestTimeSlice(void)
+{
+    if (s_slice_deadline == TIMER_NO_DEADLINE) {
+        StartTimeSlice(true);
+    }
+}
+
+/* Private function ----------------------------------------------------------*/
+static void TimerSoftirq(void)
+{
+    Timer *timer = NULL;
+    uint64_t now = 0;
+
+    /* The period has ended, move the clock forward by the whole period. */
+    if (s_use_lapic && LAPICTimerCurrentCount() == 0) {
+        s_clock_ticks += s_programmed_count;
+        s_programmed_count = 0;
+    }
+
+    now = GetUptimeUS();
+
+    while ((timer = (Timer *)s_timer_list.next) != NULL
+           && timer->expires <= now) {
+        ListPopFront(&s_timer_list);
+        timer->active = false;
+        timer->func(timer);
+    }
+
+    if (!s_use_lapic || now >= s_slice_deadline) {
+        /* Give the CPU to the next ready process, when the handler exits. */
+        s_slice_deadline = TIMER_NO_DEADLINE;
+        SetNeedResched();
+    }
+
+    if (s_use_lapic) {
+        ProgramNextEvent();
+    }
+}
+
+static void ProgramNextEvent(void)
+{
+    uint64_t now = 0;
+    uint64_t deadline = s_slice_deadline;
+    uint64_t count = LAPIC_TIMER_MAXIMUM_COUNT;
+    Timer *timer = (Timer *)s_timer_list.next;
+
+    /* Restart the period from now, the elapsed part goes to the clock. */
+    s_clock_ticks = GetClockTicks();
+    s_programmed_count = 0;
+    now = GetUptimeUS();
+
+    if (timer != NULL && timer->expires < deadline) {
+        deadline = timer->expires;
+    }
+
+    if (deadline != TIMER_NO_DEADLINE) {
+        if (deadline <= now) {
+            count = 1;
+        } else {
+            uint64_t us = deadline - now;
+            uint64_t maximum_us = LAPIC_TIMER_MAXIMUM_COUNT / LAPICTimerFrequency()
+                                  * US_PER_SECOND;
+
+            if (us < maximum_us) {
+                count = us * LAPICTimerFrequency() / US_PER_SECOND + 1;
+            }
+        }
+    }
+
+    if (count > LAPIC_TIMER_MAXIMUM_COUNT) {
+        count = LAPIC_TIMER_MAXIMUM_COUNT;
+    }
+
+    s_programmed_count = count;
+    LAPICTimerOneShot(count);
+}
+
+static uint64_t GetClockTicks(void)
+{
+    if (s_programmed_count == 0) {
+        return s_clock_ticks;
+    }
+
+    return s_clock_ticks + s_programmed_count - LAPICTimerCurrentCount();
+}
+
+static void SleepTimerExpired(Timer *timer)
+{
+    SleepTimer *sleep_timer = (SleepTimer *)timer;
+
+    sleep_timer->fired = true;
+    Wakeup(&sleep_timer->wait_queue);
+}
@@ -0,0 +1,113 @@
+/**
+ * @file    timer.h
+ * @author  Cong Nguyen (congnt264@gmail.com)
+ * @brief   Kernel timers and the time slice of the scheduler. The timer
+ *          interrupt is not periodic: the local APIC timer is programmed in
+ *          one-shot mode for the nearest event, that is the earliest pending
+ *          timer or the end of the time slice of the running process. The time
+ *          slice is only armed when another process is waiting for the CPU, so
+ *          a process which runs alone, and the IDLE process, are never
+ *          interrupted by the tick. With no event at all, the timer is
+ *          programmed for its longest period, only to keep the clock.
+ *
+ *          The clock counts elapsed local APIC timer ticks. If the CPU has no
+ *          local APIC, we fall back to the 100Hz PIT tick, the clock advances
+ *          10ms per tick and every tick ends the time slice.
+ *
+ *          Pending timers are kept in a list sorted by expiry time, so the
+ *          interrupt only looks at the head of the list.
+ *
+ * @version 0.1
+ * @date 2023-09-20
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <list.h>
+
+/* Public define -------------------------------------------------------------*/
+#define TIMER_TICK_US               10000   /* PIT tick, unit of SysSleep.    */
+#define SCHEDULER_TIME_SLICE_US     10000
+
+/* Public type ---------------------------------------------------------------*/
+struct Timer;
+typedef void (*TimerFunction)(struct Timer *timer);
+
+/**
+ * @brief   Timer structure, it is embedded in the object it works for.
+ *
+ * @property next       - Link in the sorted timer list.
+ * @property expires    - Uptime in microseconds when the timer fires.
+ * @property func       - Function is called in the timer interrupt.
+ * @property active     - The timer is in the timer list.
+ */
+typedef struct Timer {
+    List *next;
+    uint64_t expires;
+    TimerFunction func;
+    bool active;
+} Timer;
+
+/* Public function prototype -------------------------------------------------*/
+/**
+ * @brief       Select the clock event device (LAPIC timer or PIT) and start it.
+ */
+void InitTimer(void);
+
+/**
+ * @brief       Top half of the timer interrupt, the timers run in the
+ *              SOFTIRQ_TIMER softirq.
+ */
+void TimerInterrupt(void);
+
+/**
+ * @brief       Get time since boot in microseconds.
+ */
+uint64_t GetUptimeUS(void);
+
+/**
+ * @brief       Initialize a timer.
+ *
+ * @param[in]   timer       - Timer.
+ * @param[in]   func        - Function is called when the timer expires.
+ */
+void InitTimerEntry(Timer *timer, TimerFunction func);
+
+/**
+ * @brief       Start the timer, if it is active, it is restarted.
+ *
+ * @param[in]   timer       - Timer.
+ * @param[in]   expires     - Uptime in microseconds when the timer fires.
+ */
+void AddTimer(Timer *timer, uint64_t expires);
+
+/**
+ * @brief       Stop the timer if it is active.
+ *
+ * @param[in]   timer       - Timer.
+ */
+void DeleteTimer(Timer *timer);
+
+/**
+ * @brief       Put current process to sleep for at least `us` microseconds.
+ *
+ * @param[in]   us          - Duration in microseconds.
+ */
+void TimerSleep(uint64_t us);
+
+/**
+ * @brief       Start a new time slice for the process we switch to. The slice
+ *              is only armed if other processes are waiting for the CPU.
+ *
+ * @param[in]   contended   - Other processes are ready to run.
+ */
+void StartTimeSlice(bool contended);
+
+/**
+ * @brief       A process became ready, arm the time slice of the running
+ *              process if it is not armed yet.
+ */
+void RequestTimeSlice(void);
@@ -1,6 +1,14 @@
 section .text
 
 extern InterruptHandler
+extern SyscallHandler
+
+; Layout of the per-CPU data of the SYSCALL entry (SyscallCPUData in C), GS
+; base points to it between the two SWAPGS of the entry.
+SYSCALL_CPU_KERNEL_STACK:   equ 0x00
+SYSCALL_CPU_USER_STACK:     equ 0x08
+USER_DATA_SELECTOR:         equ 0x18 | 3
+USER_CODE_SELECTOR:         equ 0x20 | 3
 
 ; Interrupt handler WRAPPER, some vector numbers are reserved (9, 15, etc). 
 global Vector0      ; Divide by zero.
@@ -24,7 +32,10 @@ global Vector19
 global Vector32
 global Vector33
 global Vector39
+global Vector254
+global Vector255
 global Syscall
+global SyscallEntry
 
 global EOI          ; The end of interrupt.
 global ReadISR
@@ -32,6 +43,23 @@ global LoadIDT
 global LoadCR3
 global ReadCR2
 global ReadCR3
+global ReadMSR
+global WriteMSR
+global ReadCR0
+global WriteCR0
+global ReadCR4
+global WriteCR4
+global ClearTS
+global CPUID
+global WriteXCR0
+global ReadTSC
+global EnableInterrupts
+global DisableInterrupts
+global FInit
+global FXSave
+global FXRestore
+global XSave
+global XRestore
 global ProcessStart
 global TrapReturn
 global ContextSwitch
@@ -183,12 +211,89 @@ Vector39:
     push 39
     jmp Trap
 
+Vector254:          ; Local APIC error interrupt.
+    push 0
+    push 254
+    jmp Trap
+
+Vector255:          ; Local APIC spurious interrupt.
+    push 0
+    push 255
+    jmp Trap
+
 Syscall:
     push 0
     push 0x80       ; Push trap number 0x80, so we know it is software
     jmp Trap        ; interrupt.
 
 
+; Entry of the SYSCALL instruction. The CPU only saves `rip` to `rcx` and
+; `rflags` to `r11`, switches CS and SS and masks the flags in SFMASK (IF is
+; cleared), it doesn't switch the stack. So we get the kernel stack of current
+; process from the per-CPU data, and build the same trap frame as `int 0x80`
+; at the top of it. Fork(), Exec() and Clone() keep working on the trap frame
+; of either entry.
+SyscallEntry:
+    swapgs                                  ; GS base -> per-CPU data.
+    mov [gs:SYSCALL_CPU_USER_STACK], rsp
+    mov rsp, [gs:SYSCALL_CPU_KERNEL_STACK]
+
+    push USER_DATA_SELECTOR                 ; ss
+    push qword [gs:SYSCALL_CPU_USER_STACK]  ; rsp
+    swapgs                                  ; Restore the user GS base.
+    push r11                                ; rflags
+    push USER_CODE_SELECTOR                 ; cs
+    push rcx                                ; rip
+    push 0                                  ; Error code.
+    push 0x80                               ; Trap number of system calls.
+
+    push rax
+    push rbx
+    push rcx
+    push rdx
+    push rsi
+    push rdi
+    push rbp
+    push r8
+    push r9
+    push r10
+    push r11
+    push r12
+    push r13
+    push r14
+    push r15
+
+    mov rdi, rsp    ; Pass the trap frame to SyscallHandler().
+    call SyscallHandler
+
+    ; SYSRET can only return to a canonical address, the trap frame may have
+    ; been changed (by Exec(), etc.), so we return with `iretq` otherwise.
+    mov rcx, [rsp + 17 * 8]                 ; rip
+    shr rcx, 47
+    jnz TrapReturn
+
+    pop r15
+    pop r14
+    pop r13
+    pop r12
+    pop r11
+    pop r10
+    pop r9
+    pop r8
+    pop rbp
+    pop rdi
+    pop rsi
+    pop rdx
+    pop rcx
+    pop rbx
+    pop rax
+
+    add rsp, 0x10                           ; Trap number and error code.
+    mov rcx, [rsp]                          ; rip
+    mov r11, [rsp + 0x10]                   ; rflags
+    mov rsp, [rsp + 0x18]                   ; User rsp.
+    o64 sysret
+
 EOI:                ; Send EOI to PIC.
     mov al, 0x20
     out 0x20, al
@@ -217,6 +322,102 @@ ReadCR3:
     mov rax,cr3
     ret
 
+ReadMSR:
+    mov rcx, rdi        ; MSR index.
+    rdmsr               ; Value is returned in EDX:EAX.
+    shl rdx, 32
+    or rax, rdx
+    ret
+
+WriteMSR:
+    mov rcx, rdi        ; MSR index.
+    mov rax, rsi        ; Low 32 bits of value in EAX.
+    mov rdx, rsi        ; High 32 bits of value in EDX.
+    shr rdx, 32
+    wrmsr
+    ret
+
+ReadCR0:
+    mov rax, cr0
+    ret
+
+WriteCR0:
+    mov cr0, rdi
+    ret
+
+ReadCR4:
+    mov rax, cr4
+    ret
+
+WriteCR4:
+    mov cr4, rdi
+    ret
+
+ClearTS:
+    clts                ; Clear CR0.TS, FPU instructions don't trap anymore.
+    ret
+
+CPUID:
+    push rbx            ; RBX is callee-saved.
+    mov r8, rdx         ; Output array: EAX, EBX, ECX, EDX.
+    mov eax, edi        ; Leaf.
+    mov ecx, esi        ; Sub-leaf.
+    cpuid
+    mov [r8], eax
+    mov [r8 + 4], ebx
+    mov [r8 + 8], ecx
+    mov [r8 + 12], edx
+    pop rbx
+    ret
+
+WriteXCR0:
+    xor ecx, ecx        ; XCR0.
+    mov rax, rdi        ; Value in EDX:EAX.
+    mov rdx, rdi
+    shr rdx, 32
+    xsetbv
+    ret
+
+ReadTSC:
+    rdtsc               ; EDX:EAX.
+    shl rdx, 32
+    or rax, rdx
+    ret
+
+EnableInterrupts:
+    sti
+    ret
+
+DisableInterrupts:
+    cli
+    ret
+
+FInit:
+    fninit
+    ret
+
+FXSave:
+    fxsave64 [rdi]
+    ret
+
+FXRestore:
+    fxrstor64 [rdi]
+    ret
+
+XSave:
+    mov rax, rsi        ; Requested feature mask in EDX:EAX.
+    mov rdx, rsi
+    shr rdx, 32
+    xsave64 [rdi]
+    ret
+
+XRestore:
+    mov rax, rsi        ; Requested feature mask in EDX:EAX.
+    mov rdx, rsi
+    shr rdx, 32
+    xrstor64 [rdi]
+    ret
+
 ProcessStart:
     mov rsp, rdi        ; Set RSP point to process stack frame.
     jmp TrapReturn      ; After trap return, we we running in process code.
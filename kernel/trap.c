@@ -4,14 +4,29 @@
 #include "syscall.h"
 #include "process.h"
 #include "keyboard.h"
+#include "fpu.h"
+#include "timer.h"
+#include "lapic.h"
+#include "ioapic.h"
+#include "softirq.h"
+#include "preempt.h"
 
 /* Private define ------------------------------------------------------------*/
 #define MAXIMUM_IRQ_NUMBER 256
 #define KERNEL_CODE_SEGMENT_SELECTOR 0x08
+#define DOUBLE_FAULT_VECTOR 8
+#define DOUBLE_FAULT_IST 1
+#define DOUBLE_FAULT_STACK_SIZE 4096
 /* Private variable ----------------------------------------------------------*/
 static IDTPointer s_IDT_ptr;
 static IDTEntry s_interrupt_entries[MAXIMUM_IRQ_NUMBER];
-static uint64_t s_system_ticks = 0;
+
+/* A kernel stack overflow hits the guard page, and the CPU can't push the
+ * page fault frame to the same stack, so it raises a double fault. The double
+ * fault handler runs on this stack, via the interrupt stack table. */
+static uint8_t s_double_fault_stack[DOUBLE_FAULT_STACK_SIZE]
+    __attribute__ ((aligned (16)));
+extern TSS TaskStateSegment; /* Extern from ASM. */
 
 /* Private function prototypes -----------------------------------------------*/
 /**
@@ -32,6 +47,14 @@ static void InitIDTEntry(IDTEntry *entry, uint64_t address, uint8_t attribute);
  */
 void InterruptHandler(TrapFrame *tf);
 
+/**
+ * @brief    SYSCALL handler, called by `SyscallEntry` before SYSRET.
+ *
+ * @param[in] tf            - The stack pointer that point to trap frame.
+ * @return    none
+ */
+void SyscallHandler(TrapFrame *tf);
+
 /* Public function -----------------------------------------------------------*/
 void InitIDT(void)
 {
@@ -56,6 +79,14 @@ void InitIDT(void)
     InitIDTEntry(&s_interrupt_entries[32], (uint64_t)Vector32, 0x8E);
     InitIDTEntry(&s_interrupt_entries[33], (uint64_t)Vector33, 0x8E);
     InitIDTEntry(&s_interrupt_entries[39], (uint64_t)Vector39, 0x8E);
+    InitIDTEntry(&s_interrupt_entries[LAPIC_ERROR_VECTOR],
+                 (uint64_t)Vector254, 0x8E);
+    InitIDTEntry(&s_interrupt_entries[LAPIC_SPURIOUS_VECTOR],
+                 (uint64_t)Vector255, 0x8E);
+
+    TaskStateSegment.ist1 = (uint64_t)s_double_fault_stack
+                            + DOUBLE_FAULT_STACK_SIZE;
+    s_interrupt_entries[DOUBLE_FAULT_VECTOR].ist = DOUBLE_FAULT_IST;
     
     
     /* Init system call handler, DPL attribute is set to 3 instead of 0,
@@ -70,11 +101,6 @@ void InitIDT(void)
     LoadIDT(&s_IDT_ptr);
 }
 
-uint64_t GetTicks(void)
-{
-    return s_system_ticks;
-}
-
 /* Private function ----------------------------------------------------------*/
 static void InitIDTEntry(IDTEntry *entry, uint64_t address, uint8_t attribute)
 {
@@ -87,23 +113,38 @@ static void InitIDTEntry(IDTEntry *entry, uint64_t address, uint8_t attribute)
 
 void InterruptHandler(TrapFrame *tf)
 {
-    switch (tf->trapno) {
-    case 32: {      /* Timer interrupt which is called every 10ms. */
-        /* Increase system ticks and wakeup processes which have wait_id -1. */
-        s_system_ticks++;
-        Wakeup(NORMAL_PROCESS_WAIT_ID);
+    /* Device interrupts run their top half here, the rest of the work runs
+     * in softirqs at IRQExit(). */
+    bool irq = tf->trapno >= IRQ_VECTOR_BASE
+               && tf->trapno != SYSTEM_CALL_INTERRUPT_NUMBER;
 
-        EOI();
+    /* User mode and the IDLE process are preemptible, the kernel is not until
+     * we return there. An interrupt in the window of a preemption point is not
+     * measured, the point measures and switches itself. System calls are
+     * measured by SystemCall(). */
+    bool preemptible = (tf->cs & 3) == 3
+                || GetScheduler()->current_proc->pid == IDLE_PROCESS_PID;
+    bool measured = preemptible
+                    && tf->trapno != SYSTEM_CALL_INTERRUPT_NUMBER;
 
-        /* If the handler is called when running in the user mode, we Yield()
-         * to make current process give up the CPU resource, and choose another
-         * another process. */
-        Yield();
+    if (measured) {
+        PreemptSectionStart();
+    }
+
+    if (irq) {
+        IRQEnter();
+    }
+
+    switch (tf->trapno) {
+    case LAPIC_TIMER_VECTOR: {
+        /* One-shot timer interrupt: runs expired timers, and gives the CPU to
+         * another process when the time slice of current process is over. */
+        TimerInterrupt();
     }
     break;
-    case 33: {      /* Keyboard interrupt. */
-        KeyboardHandler();
-        EOI();
+    case IRQ_VECTOR_BASE + KEYBOARD_IRQ: {
+        KeyboardInterrupt();
+        IRQEOI();
     }
     break;
     case 39: {      /* Spurious interrupt. */
@@ -113,6 +154,24 @@ void InterruptHandler(TrapFrame *tf)
         }
     }
     break;
+    case DEVICE_NOT_AVAILABLE_VECTOR: {
+        /* User process uses the FPU/SSE/AVX registers first time after a
+         * context switch. The kernel never uses them. */
+        if ((tf->cs & 3) == 3) {
+            FPUHandleTrap();
+        } else {
+            panic("FPU is used in kernel mode");
+        }
+    }
+    break;
+    case LAPIC_ERROR_VECTOR: {
+        LAPICErrorInterrupt();
+    }
+    break;
+    case LAPIC_SPURIOUS_VECTOR: {
+        /* Spurious interrupts of the local APIC don't need an EOI. */
+    }
+    break;
     case SYSTEM_CALL_INTERRUPT_NUMBER: {
         SystemCall(tf);
     }
@@ -126,10 +185,16 @@ void InterruptHandler(TrapFrame *tf)
                     tf->trapno,
                     ReadCR2(),
                     tf->rip);
-            Exit();
+            Exit(PROCESS_EXIT_FAILURE);
         } else {
             /* If the exception is generated by kernel mode, we halt CPU. */
             char msg[70] = {0};
+
+            if (IsKernelStackGuard(ReadCR2())) {
+                sprintk(msg, "Kernel stack overflow at %x", tf->rip);
+                panic(msg);
+            }
+
             sprintk(msg,
                 "[Error %d at ring: %d] %d:%x %x",
                 tf->trapno,         /* Trap number. */
@@ -142,4 +207,44 @@ void InterruptHandler(TrapFrame *tf)
     }
     break;
     }
+
+    if (irq) {
+        IRQExit();
+    }
+
+    /* The interrupt arrived in a softirq, the softirq loop continues when we
+     * return, so we can't switch process here. */
+    if (InSoftirq() || !preemptible) {
+        return;
+    }
+
+    /* The IDLE process doesn't take the tick anymore. If the interrupt made a
+     * process ready (keyboard input, etc.), we switch to it now. */
+    if (PreemptCount() == 0
+        && (TestAndClearNeedResched()
+            || GetScheduler()->current_proc->pid == IDLE_PROCESS_PID)) {
+        Yield();
+    }
+
+    if (measured) {
+        PreemptSectionEnd(PREEMPT_SECTION_INTERRUPT, tf->trapno);
+    }
+
+    /* The program ended while the thread was running. */
+    if ((tf->cs & 3) == 3) {
+        CheckThreadGroupExit();
+    }
+}
+
+void SyscallHandler(TrapFrame *tf)
+{
+    SystemCall(tf);
+
+    /* Same as the `int 0x80` path in InterruptHandler(), a process made ready
+     * by the system call runs before we return to user. */
+    if (PreemptCount() == 0 && TestAndClearNeedResched()) {
+        Yield();
+    }
+
+    CheckThreadGroupExit();
 }
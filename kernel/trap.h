@@ -10,7 +10,7 @@
 typedef struct {
     uint16_t low;           /* Lower 16 bits of offset.     */
     uint16_t selector;      /* Selector.                    */
-    uint8_t res0;           /* Reserved.                    */
+    uint8_t ist;            /* Interrupt stack table index. */
     uint8_t attr;           /* Attributes.                  */
     uint16_t mid;           /* Mid 16 bits of offset.       */
     uint32_t high;          /* Higher 32 bits of offset.    */
@@ -63,8 +63,6 @@ typedef struct {
  */
 void InitIDT(void);
 
-uint64_t GetTicks(void);
-
 void Vector0(void);
 void Vector1(void);
 void Vector2(void);
@@ -86,7 +84,10 @@ void Vector19(void);
 void Vector32(void);
 void Vector33(void);
 void Vector39(void);
+void Vector254(void);
+void Vector255(void);
 void Syscall(void);
+void SyscallEntry(void);
 
 /**
  * @brief       Call this to send end of interrupt, so we can re-fire interrupt
@@ -97,4 +98,66 @@ uint8_t ReadISR(void);
 void LoadIDT(IDTPointer *ptr);
 uint64_t ReadCR2(void);
 uint64_t ReadCR3(void);
+
+/**
+ * @brief       Read a model specific register.
+ *
+ * @param[in]   msr         - MSR index.
+ * @return      uint64_t    - Value of the register.
+ */
+uint64_t ReadMSR(uint32_t msr);
+
+/**
+ * @brief       Write a model specific register.
+ *
+ * @param[in]   msr         - MSR index.
+ * @param[in]   value       - Value to write.
+ */
+void WriteMSR(uint32_t msr, uint64_t value);
+
+uint64_t ReadCR0(void);
+void WriteCR0(uint64_t value);
+uint64_t ReadCR4(void);
+void WriteCR4(uint64_t value);
+
+/**
+ * @brief       Clear CR0.TS flag.
+ */
+void ClearTS(void);
+
+/**
+ * @brief       Execute CPUID instruction.
+ *
+ * @param[in]   leaf        - Value of EAX.
+ * @param[in]   subleaf     - Value of ECX.
+ * @param[out]  regs        - Result: EAX, EBX, ECX, EDX.
+ */
+void CPUID(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]);
+
+/**
+ * @brief       Write the extended control register XCR0 (XSETBV).
+ */
+void WriteXCR0(uint64_t value);
+
+/**
+ * @brief       Read the time stamp counter (RDTSC).
+ */
+uint64_t ReadTSC(void);
+
+/**
+ * @brief       Set/clear the interrupt flag (STI/CLI).
+ */
+void EnableInterrupts(void);
+void DisableInterrupts(void);
+
+/**
+ * @brief       FPU state instructions, the state area of FXSave/FXRestore has
+ *              to be 16-byte aligned, the one of XSave/XRestore has to be
+ *              64-byte aligned.
+ */
+void FInit(void);
+void FXSave(void *area);
+void FXRestore(void *area);
+void XSave(void *area, uint64_t mask);
+void XRestore(void *area, uint64_t mask);
 void TrapReturn(void);
\ No newline at end of file
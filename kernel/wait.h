@@ -0,0 +1,61 @@
+/**
+ * @file    wait.h
+ * @author  Cong Nguyen (congnt264@gmail.com)
+ * @brief   A wait queue is a list of sleeping processes that are waiting for
+ *          the same event. The queue is embedded in the object that processes
+ *          are waiting for (the keyboard buffer, the timer, an exiting process,
+ *          etc.). So putting a process to sleep is only pushing it to the tail
+ *          of the queue, and waking up is only popping processes from the head
+ *          of the queue, we never scan processes which are waiting for other
+ *          events.
+ *
+ * @version 0.1
+ * @date 2023-09-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+#include <list.h>
+
+/* Public type ---------------------------------------------------------------*/
+/**
+ * @brief   Wait queue structure.
+ *
+ * @property waiters    - Sleeping processes, in the order they went to sleep.
+ */
+typedef struct {
+    HeadList waiters;
+} WaitQueue;
+
+/* Public function prototype -------------------------------------------------*/
+/**
+ * @brief       Initialize an empty wait queue. A zero-filled wait queue is also
+ *              a valid empty queue, so static queues don't need to call this.
+ *
+ * @param[in]   wq          - Wait queue.
+ */
+void InitWaitQueue(WaitQueue *wq);
+
+/**
+ * @brief       Put current process to sleep on the wait queue and re-schedule.
+ *              The function returns when the process is woken up.
+ *
+ * @param[in]   wq          - Wait queue to sleep on.
+ */
+void Sleep(WaitQueue *wq);
+
+/**
+ * @brief       Wakeup all processes which are sleeping on the wait queue.
+ *
+ * @param[in]   wq          - Wait queue.
+ */
+void Wakeup(WaitQueue *wq);
+
+/**
+ * @brief       Wakeup the process which has been sleeping on the wait queue for
+ *              the longest time.
+ *
+ * @param[in]   wq          - Wait queue.
+ */
+void WakeupOne(WaitQueue *wq);
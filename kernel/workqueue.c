@@ -0,0 +1,131 @@
+#include <stddef.h>
+
+#include "workqueue.h"
+#include "process.h"
+#include "assert.h"
+
+/* Private type --------------------------------------------------------------*/
+/**
+ * @brief   Worker pool structure, one per CPU.
+ *
+ * @property queue          - Pending work items.
+ * @property wait_queue     - Idle workers.
+ * @property flush_queue    - Processes waiting in FlushWork().
+ * @property stats          - Statistics.
+ */
+typedef struct {
+    HeadList queue;
+    WaitQueue wait_queue;
+    WaitQueue flush_queue;
+    WorkQueueStats stats;
+} WorkerPool;
+
+/* Private variable ----------------------------------------------------------*/
+static WorkerPool s_worker_pools[MAXIMUM_CPUS];
+
+/* Private function prototypes -----------------------------------------------*/
+/**
+ * @brief   Worker pool of the current CPU.
+ */
+static WorkerPool *GetCurrentPool(void);
+
+/**
+ * @brief   Worker thread, it runs work items of the pool of its CPU.
+ */
+static void WorkerThread(void);
+
+/* Public function -----------------------------------------------------------*/
+void InitWorkQueue(void)
+{
+    for (int cpu = 0; cpu < MAXIMUM_CPUS; cpu++) {
+        WorkerPool *pool = &s_worker_pools[cpu];
+
+        pool->queue.next = NULL;
+        pool->queue.tail = NULL;
+        InitWaitQueue(&pool->wait_queue);
+        InitWaitQueue(&pool->flush_queue);
+
+        for (int i = 0; i < WORKERS_PER_POOL; i++) {
+            Process *worker = CreateKernelThread(WorkerThread,
+                                                 PROCESS_PRIORITY_NORMAL);
+            ASSERT(worker != NULL);
+        }
+    }
+}
+
+void InitWork(Work *work, WorkFunction func)
+{
+    work->next = NULL;
+    work->func = func;
+    work->pending = false;
+    work->running = false;
+}
+
+bool QueueWork(Work *work)
+{
+    WorkerPool *pool = GetCurrentPool();
+
+    if (work->pending) {
+        return false;
+    }
+
+    work->pending = true;
+    ListPushBack(&pool->queue, (List *)work);
+
+    pool->stats.queued++;
+    pool->stats.depth++;
+    if (pool->stats.depth > pool->stats.max_depth) {
+        pool->stats.max_depth = pool->stats.depth;
+    }
+
+    WakeupOne(&pool->wait_queue);
+
+    return true;
+}
+
+void FlushWork(Work *work)
+{
+    WorkerPool *pool = GetCurrentPool();
+
+    while (work->pending || work->running) {
+        Sleep(&pool->flush_queue);
+    }
+}
+
+void GetWorkQueueStats(int cpu, WorkQueueStats *stats)
+{
+    ASSERT(cpu >= 0 && cpu < MAXIMUM_CPUS);
+    *stats = s_worker_pools[cpu].stats;
+}
+
+/* Private function ----------------------------------------------------------*/
+static WorkerPool *GetCurrentPool(void)
+{
+    /* There is only the boot CPU now. */
+    return &s_worker_pools[0];
+}
+
+static void WorkerThread(void)
+{
+    WorkerPool *pool = GetCurrentPool();
+    Work *work = NULL;
+
+    while (1) {
+        work = (Work *)ListPopFront(&pool->queue);
+        if (work == NULL) {
+            Sleep(&pool->wait_queue);
+            continue;
+        }
+
+        pool->stats.depth--;
+
+        /* The work may queue itself again while it is running. */
+        work->pending = false;
+        work->running = true;
+        work->func(work);
+        work->running = false;
+
+        pool->stats.completed++;
+        Wakeup(&pool->flush_queue);
+    }
+}
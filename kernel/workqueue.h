@@ -0,0 +1,105 @@
+/**
+ * @file    workqueue.h
+ * @author  Cong Nguyen (congnt264@gmail.com)
+ * @brief   A workqueue defers work to kernel worker threads. Interrupt handlers
+ *          and system calls queue a work item and return, a worker thread
+ *          runs the work function later in process context, where it can
+ *          sleep.
+ *
+ *          Each CPU has a worker pool: a queue of pending work and a few worker
+ *          threads sleeping on the wait queue of the pool. QueueWork() pushes
+ *          the work to the pool of the current CPU and wakes up one worker. A
+ *          work item is queued at most once, queueing a pending work does
+ *          nothing, so the item is embedded in the object it works on and
+ *          needs no allocation.
+ *
+ * @version 0.1
+ * @date 2023-09-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <list.h>
+#include "wait.h"
+
+/* Public define -------------------------------------------------------------*/
+#define MAXIMUM_CPUS                1
+#define WORKERS_PER_POOL            2
+
+/* Public type ---------------------------------------------------------------*/
+struct Work;
+typedef void (*WorkFunction)(struct Work *work);
+
+/**
+ * @brief   Work item structure.
+ *
+ * @property next       - Link in the queue of the pool.
+ * @property func       - Function the worker runs, it gets the work item, so
+ *                        it can find the object the item is embedded in.
+ * @property pending    - The item is in a queue, and not started yet.
+ * @property running    - A worker is running the item.
+ */
+typedef struct Work {
+    List *next;
+    WorkFunction func;
+    bool pending;
+    bool running;
+} Work;
+
+/**
+ * @brief   Worker pool statistics.
+ *
+ * @property depth      - Number of pending work items.
+ * @property max_depth  - The highest depth since boot.
+ * @property queued     - Number of work items are queued since boot.
+ * @property completed  - Number of work items are completed since boot.
+ */
+typedef struct {
+    uint64_t depth;
+    uint64_t max_depth;
+    uint64_t queued;
+    uint64_t completed;
+} WorkQueueStats;
+
+/* Public function prototype -------------------------------------------------*/
+/**
+ * @brief       Create worker pools and their worker threads.
+ */
+void InitWorkQueue(void);
+
+/**
+ * @brief       Initialize a work item.
+ *
+ * @param[in]   work        - Work item.
+ * @param[in]   func        - Function to run.
+ */
+void InitWork(Work *work, WorkFunction func);
+
+/**
+ * @brief       Queue the work to the worker pool of the current CPU. It is safe
+ *              to call from interrupt handlers.
+ *
+ * @param[in]   work        - Work item.
+ * @return      true        - The work is queued.
+ * @return      false       - The work was pending already.
+ */
+bool QueueWork(Work *work);
+
+/**
+ * @brief       Wait until the work is not pending and not running. The caller
+ *              must not be a worker thread.
+ *
+ * @param[in]   work        - Work item.
+ */
+void FlushWork(Work *work);
+
+/**
+ * @brief       Get statistics of the worker pool of a CPU.
+ *
+ * @param[in]   cpu         - CPU index.
+ * @param[out]  stats       - Statistics.
+ */
+void GetWorkQueueStats(int cpu, WorkQueueStats *stats);
@@ -0,0 +1,96 @@
+/**
+ * @file    ioring.h
+ * @author  Cong Nguyen (congnt264@gmail.com)
+ * @brief   Layout of the asynchronous I/O ring, it is shared by the kernel and
+ *          user programs. The ring lives in the memory of the user program, the
+ *          program registers it with the ioring_setup system call.
+ *
+ *          The program writes submission entries (SQE) to the submission queue
+ *          and moves `sq_tail`. A kernel worker consumes them, moves `sq_head`
+ *          and posts a completion entry (CQE) for each of them to the
+ *          completion queue, then moves `cq_tail`. The program reads the
+ *          completions and moves `cq_head`. Each index is written by one side
+ *          only, so no lock is needed. Indexes are free running, the slot of
+ *          an index is `index & (IORING_ENTRIES - 1)`.
+ *
+ *          The kernel doesn't take a new submission unless the completion
+ *          queue has room for it, so completions are never lost.
+ *
+ * @version 0.1
+ * @date 2023-09-23
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+#include <stdint.h>
+
+/* Public define -------------------------------------------------------------*/
+#define IORING_ENTRIES              64      /* Power of two.                  */
+
+/* Operations. */
+#define IORING_OP_NOP               0
+#define IORING_OP_READ              1       /* fd, addr = buffer, len.        */
+#define IORING_OP_WRITE             2       /* fd, addr = buffer, len.        */
+#define IORING_OP_OPEN              3       /* addr = path.                   */
+#define IORING_OP_CLOSE             4       /* fd.                            */
+#define IORING_OP_SLEEP             5       /* len = microseconds.            */
+
+/* ioring_setup flags. */
+#define IORING_SETUP_SQPOLL         1       /* The kernel polls the SQ.       */
+
+/* ioring_enter flags. */
+#define IORING_ENTER_SQ_WAKEUP      1       /* Restart SQ polling.            */
+
+/* Ring flags, written by the kernel. */
+#define IORING_SQ_NEED_WAKEUP       1       /* SQ polling stopped, call enter.*/
+
+/* Public type ---------------------------------------------------------------*/
+/**
+ * @brief   Submission queue entry.
+ *
+ * @property opcode     - IORING_OP_*.
+ * @property fd         - File descriptor.
+ * @property addr       - User address of the buffer or the path.
+ * @property len        - Length of the buffer, or the sleep time.
+ * @property user_data  - Copied to the completion, to identify the request.
+ */
+typedef struct {
+    uint32_t opcode;
+    int32_t fd;
+    uint64_t addr;
+    uint64_t len;
+    uint64_t user_data;
+} IORingSQE;
+
+/**
+ * @brief   Completion queue entry.
+ *
+ * @property user_data  - `user_data` of the submission.
+ * @property result     - Return value of the operation, negative errno.
+ */
+typedef struct {
+    uint64_t user_data;
+    int64_t result;
+} IORingCQE;
+
+/**
+ * @brief   Ring structure.
+ *
+ * @property sq_head    - Next submission the kernel takes, kernel writes.
+ * @property sq_tail    - Next free submission slot, user writes.
+ * @property cq_head    - Next completion the user reads, user writes.
+ * @property cq_tail    - Next free completion slot, kernel writes.
+ * @property flags      - IORING_SQ_*, kernel writes.
+ * @property sqes       - Submission queue.
+ * @property cqes       - Completion queue.
+ */
+typedef struct {
+    volatile uint32_t sq_head;
+    volatile uint32_t sq_tail;
+    volatile uint32_t cq_head;
+    volatile uint32_t cq_tail;
+    volatile uint32_t flags;
+    IORingSQE sqes[IORING_ENTRIES];
+    IORingCQE cqes[IORING_ENTRIES];
+} IORing;
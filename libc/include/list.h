@@ -22,4 +22,5 @@ typedef struct
 
 void ListPushBack(HeadList *list, List *item);
 List *ListPopFront(HeadList *list);
-bool ListIsEmpty(HeadList *list);
\ No newline at end of file
+bool ListIsEmpty(HeadList *list);
+bool ListRemove(HeadList *list, List *item);
\ No newline at end of file
@@ -0,0 +1,51 @@
+/**
+ * @file    vdso.h
+ * @author  Cong Nguyen (congnt264@gmail.com)
+ * @brief   Layout of the time page. The kernel maps the page read-only at the
+ *          same address of every user address space, so user programs read the
+ *          clock without a system call: they read the TSC and scale it with
+ *          the parameters of the page.
+ *
+ *          The page is protected by a sequence lock. The kernel makes the
+ *          sequence odd before it updates the page and even again after that.
+ *          A reader retries if the sequence is odd or changed while it read the
+ *          page, so it never sees a half updated page, and the kernel never
+ *          waits for readers.
+ *
+ * @version 0.1
+ * @date 2023-09-22
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+#include <stdint.h>
+
+/* Public define -------------------------------------------------------------*/
+#define VDSO_TIME_PAGE_ADDRESS      0x7F8000000000
+#define VDSO_CLOCK_NONE             0   /* Use the clock_gettime syscall.     */
+#define VDSO_CLOCK_TSC              1
+
+/* Public type ---------------------------------------------------------------*/
+/**
+ * @brief   Time page structure. The time since boot in nanoseconds is
+ *          `base_ns + ((tsc - base_cycles) * mult) >> shift`, the product is
+ *          128-bit.
+ *
+ * @property sequence       - Sequence lock, odd while the kernel writes.
+ * @property clock_mode     - VDSO_CLOCK_TSC if the TSC can be used.
+ * @property base_cycles    - TSC value at `base_ns`.
+ * @property base_ns        - Time since boot in nanoseconds at `base_cycles`.
+ * @property mult           - Nanoseconds per cycle, scaled by 2^shift.
+ * @property shift          - Scale of `mult`.
+ * @property tick_ns        - Length of a sleep() tick in nanoseconds.
+ */
+typedef struct {
+    volatile uint32_t sequence;
+    uint32_t clock_mode;
+    uint64_t base_cycles;
+    uint64_t base_ns;
+    uint64_t mult;
+    uint32_t shift;
+    uint64_t tick_ns;
+} VDSOTimeData;
@@ -36,3 +36,31 @@ bool ListIsEmpty(HeadList *list)
     return (list->next == NULL);
 }
 
+bool ListRemove(HeadList *list, List *item)
+{
+    List *prev = NULL;
+    List *current = list->next;
+
+    while (current != NULL && current != item) {
+        prev = current;
+        current = current->next;
+    }
+
+    if (current == NULL) {
+        return false;
+    }
+
+    if (prev == NULL) {
+        list->next = item->next;
+    } else {
+        prev->next = item->next;
+    }
+
+    if (list->tail == item) {
+        list->tail = prev;
+    }
+
+    item->next = NULL;
+    return true;
+}
+
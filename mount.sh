@@ -6,5 +6,8 @@ cp usr/process4.bin /mnt/d/
 cp usr/process2.bin /mnt/d/
 cp usr/cmd/ls.bin /mnt/d/
 cp usr/cmd/clr.bin /mnt/d/
+cp usr/cmd/sysbench.bin /mnt/d/
+cp usr/cmd/ringbench.bin /mnt/d/
+cp usr/cmd/sctop.bin /mnt/d/
 
 echo "Test reading file." > /mnt/d/test.txt
\ No newline at end of file
@@ -48,7 +48,9 @@ static void toLowers(char *str) {
 
 int main(void) {
     stat buffer[100];
-    int number_of_entries = lstat(".", buffer);
+    int number_of_entries = lstat(".",
+                                  buffer,
+                                  sizeof(buffer) / sizeof(buffer[0]));
     printf("Total %d\n", number_of_entries);
     for (int i = 0; i < number_of_entries; i++) {
 
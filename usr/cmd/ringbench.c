@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <uring.h>
+
+#define RINGBENCH_ITERATIONS    200
+#define RINGBENCH_FILES         16
+#define RINGBENCH_BUFFER_SIZE   64
+#define NS_PER_SECOND           1000000000
+
+static ioring_t ring;
+static char buffers[RINGBENCH_FILES][RINGBENCH_BUFFER_SIZE];
+
+static uint64_t GetTimeNS(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * NS_PER_SECOND + ts.tv_nsec;
+}
+
+static int OpenFiles(int *fds)
+{
+    for (int i = 0; i < RINGBENCH_FILES; i++) {
+        fds[i] = open("test.txt");
+        if (fds[i] < 0) {
+            printf("Cannot open test.txt\n");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void CloseFiles(int *fds)
+{
+    for (int i = 0; i < RINGBENCH_FILES; i++) {
+        close(fds[i]);
+    }
+}
+
+/* Read a batch of files with one system call per read and with one ring
+ * submission per batch, only the reads are timed. */
+int main(void)
+{
+    int fds[RINGBENCH_FILES];
+    uint64_t start = 0;
+    uint64_t read_ns = 0;
+    uint64_t ring_ns = 0;
+    IORingSQE *sqe;
+    IORingCQE *cqe;
+
+    if (ioring_setup(&ring, 0) < 0) {
+        printf("ioring_setup failed\n");
+        return 1;
+    }
+
+    for (int n = 0; n < RINGBENCH_ITERATIONS; n++) {
+        if (OpenFiles(fds) < 0) {
+            return 1;
+        }
+
+        start = GetTimeNS();
+        for (int i = 0; i < RINGBENCH_FILES; i++) {
+            read(fds[i], buffers[i], RINGBENCH_BUFFER_SIZE);
+        }
+        read_ns += GetTimeNS() - start;
+
+        CloseFiles(fds);
+    }
+
+    for (int n = 0; n < RINGBENCH_ITERATIONS; n++) {
+        if (OpenFiles(fds) < 0) {
+            return 1;
+        }
+
+        start = GetTimeNS();
+        for (int i = 0; i < RINGBENCH_FILES; i++) {
+            sqe = ioring_get_sqe(&ring);
+            ioring_prep_read(sqe, fds[i], buffers[i], RINGBENCH_BUFFER_SIZE, i);
+        }
+
+        ioring_submit_and_wait(&ring, RINGBENCH_FILES);
+        for (int i = 0; i < RINGBENCH_FILES; i++) {
+            cqe = ioring_wait_cqe(&ring);
+            if (cqe->result < 0) {
+                printf("Ring read %u failed\n", cqe->user_data);
+            }
+            ioring_cqe_seen(&ring);
+        }
+        ring_ns += GetTimeNS() - start;
+
+        CloseFiles(fds);
+    }
+
+    printf("%d reads:\n", RINGBENCH_ITERATIONS * RINGBENCH_FILES);
+    printf("  read():  %u ns/read\n",
+           read_ns / (RINGBENCH_ITERATIONS * RINGBENCH_FILES));
+    printf("  ioring:  %u ns/read\n",
+           ring_ns / (RINGBENCH_ITERATIONS * RINGBENCH_FILES));
+
+    return 0;
+}
@@ -0,0 +1,190 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <syscall.h>
+#include <scstat.h>
+#include <stat.h>
+
+#define SCTOP_MAXIMUM_CPUS      64
+
+static const char *s_names[SYSCALL_MAXIMUM] = {
+    [SYS_WRITE] = "write",
+    [SYS_SLEEP] = "sleep",
+    [SYS_EXIT] = "exit",
+    [SYS_WAIT] = "wait",
+    [SYS_READ] = "read",
+    [SYS_MEMINFO] = "meminfo",
+    [SYS_OPEN] = "open",
+    [SYS_CLOSE] = "close",
+    [SYS_FORK] = "fork",
+    [SYS_EXEC] = "exec",
+    [SYS_LSTAT] = "lstat",
+    [SYS_CLRSRC] = "clrsrc",
+    [SYS_CLONE] = "clone",
+    [SYS_THREAD_EXIT] = "thread_exit",
+    [SYS_THREAD_JOIN] = "thread_join",
+    [SYS_SPAWN] = "spawn",
+    [SYS_CLOCK_GETTIME] = "clock_gettime",
+    [SYS_NANOSLEEP] = "nanosleep",
+    [SYS_GETPID] = "getpid",
+    [SYS_MULTICALL] = "multicall",
+    [SYS_IORING_SETUP] = "ioring_setup",
+    [SYS_IORING_ENTER] = "ioring_enter",
+    [SYS_SYSCALL_STAT] = "syscall_stat",
+    [SYS_IRQ_STAT] = "irq_stat",
+    [SYS_PREEMPT_STAT] = "preempt_stat",
+    [SYS_BCACHE_STAT] = "bcache_stat",
+};
+
+static const char *s_softirq_names[SOFTIRQ_COUNT] = {
+    [SOFTIRQ_TIMER] = "timer",
+    [SOFTIRQ_KEYBOARD] = "keyboard",
+};
+
+static const char *s_section_names[] = {
+    [PREEMPT_SECTION_SYSCALL] = "syscall",
+    [PREEMPT_SECTION_INTERRUPT] = "interrupt",
+    [PREEMPT_SECTION_POINT] = "preemption point",
+};
+
+static syscall_stats_t s_cpu_stats[SYSCALL_MAXIMUM];
+static syscall_stats_t s_total[SYSCALL_MAXIMUM];
+static irq_stats_t s_irq_total;
+static preempt_stats_t s_preempt_total;
+static int s_uses_ns;
+
+static uint64_t ToTime(uint64_t cycles)
+{
+    uint64_t ns;
+
+    if (s_uses_ns && syscall_cycles_to_ns(cycles, &ns) == 0) {
+        return ns;
+    }
+
+    return cycles;
+}
+
+/* Upper bound of the bucket which holds the `percent` percentile. */
+static uint64_t Percentile(const syscall_stats_t *stats, uint64_t percent)
+{
+    uint64_t rank = (stats->count * percent + 99) / 100;
+    uint64_t seen = 0;
+
+    for (int i = 0; i < SYSCALL_LATENCY_BUCKETS; i++) {
+        seen += stats->histogram[i];
+        if (seen >= rank) {
+            return ToTime((uint64_t)2 << i);
+        }
+    }
+
+    return ToTime(stats->cycles);
+}
+
+/* Sum the counters of all CPUs and print the system calls, the most expensive
+ * first. */
+int main(void)
+{
+    int order[SYSCALL_MAXIMUM];
+    int count = 0;
+    uint64_t ns;
+
+    for (int cpu = 0; cpu < SCTOP_MAXIMUM_CPUS; cpu++) {
+        irq_stats_t irq_stats;
+        preempt_stats_t preempt_stats;
+
+        if (syscall_stat(cpu, s_cpu_stats, SYSCALL_MAXIMUM) < 0
+            || irq_stat(cpu, &irq_stats) < 0
+            || preempt_stat(cpu, &preempt_stats) < 0) {
+            break;
+        }
+
+        /* Keep the longest section of all CPUs. */
+        s_preempt_total.sections += preempt_stats.sections;
+        s_preempt_total.preemptions += preempt_stats.preemptions;
+        if (preempt_stats.max_cycles > s_preempt_total.max_cycles) {
+            s_preempt_total.max_cycles = preempt_stats.max_cycles;
+            s_preempt_total.max_kind = preempt_stats.max_kind;
+            s_preempt_total.max_number = preempt_stats.max_number;
+        }
+
+        s_irq_total.hardirq_count += irq_stats.hardirq_count;
+        s_irq_total.hardirq_cycles += irq_stats.hardirq_cycles;
+        for (int nr = 0; nr < SOFTIRQ_COUNT; nr++) {
+            s_irq_total.softirq_count[nr] += irq_stats.softirq_count[nr];
+            s_irq_total.softirq_cycles[nr] += irq_stats.softirq_cycles[nr];
+        }
+
+        for (int n = 0; n < SYSCALL_MAXIMUM; n++) {
+            s_total[n].count += s_cpu_stats[n].count;
+            s_total[n].cycles += s_cpu_stats[n].cycles;
+            for (int i = 0; i < SYSCALL_LATENCY_BUCKETS; i++) {
+                s_total[n].histogram[i] += s_cpu_stats[n].histogram[i];
+            }
+        }
+    }
+
+    s_uses_ns = syscall_cycles_to_ns(0, &ns) == 0;
+
+    for (int n = 0; n < SYSCALL_MAXIMUM; n++) {
+        if (s_total[n].count == 0) {
+            continue;
+        }
+
+        /* Insert by total time. */
+        int i = count++;
+        while (i > 0 && s_total[order[i - 1]].cycles < s_total[n].cycles) {
+            order[i] = order[i - 1];
+            i--;
+        }
+        order[i] = n;
+    }
+
+    printf("syscall: calls, total, avg, p50, p99 (%s)\n",
+           s_uses_ns ? "ns" : "cycles");
+
+    for (int i = 0; i < count; i++) {
+        const syscall_stats_t *stats = &s_total[order[i]];
+        const char *name = s_names[order[i]];
+
+        printf("%s: %u, %u, %u, %u, %u\n",
+               name != NULL ? name : "?",
+               stats->count,
+               ToTime(stats->cycles),
+               ToTime(stats->cycles / stats->count),
+               Percentile(stats, 50),
+               Percentile(stats, 99));
+    }
+
+    printf("interrupts: runs, total\n");
+    printf("hardirq: %u, %u\n",
+           s_irq_total.hardirq_count,
+           ToTime(s_irq_total.hardirq_cycles));
+    for (int nr = 0; nr < SOFTIRQ_COUNT; nr++) {
+        printf("softirq %s: %u, %u\n",
+               s_softirq_names[nr],
+               s_irq_total.softirq_count[nr],
+               ToTime(s_irq_total.softirq_cycles[nr]));
+    }
+
+    printf("preemption: sections, preemptions, longest section\n");
+    printf("%u, %u, %u at %s %u\n",
+           s_preempt_total.sections,
+           s_preempt_total.preemptions,
+           ToTime(s_preempt_total.max_cycles),
+           s_section_names[s_preempt_total.max_kind],
+           s_preempt_total.max_number);
+
+    bcache_stats_t bcache;
+    if (bcache_stat(&bcache) == 0) {
+        printf("buffer cache: hits, misses, writebacks, dirty/buffers\n");
+        printf("%u, %u, %u, %u/%u\n",
+               bcache.hits,
+               bcache.misses,
+               bcache.writebacks,
+               bcache.dirty,
+               bcache.buffers);
+        printf("readahead: sectors, hits\n");
+        printf("%u, %u\n", bcache.readahead, bcache.readahead_hits);
+    }
+
+    return 0;
+}
@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include <time.h>
+#include <syscall.h>
+
+#define SYSBENCH_ITERATIONS     100000
+#define NS_PER_SECOND           1000000000
+
+static uint64_t GetTimeNS(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * NS_PER_SECOND + ts.tv_nsec;
+}
+
+/* Run the null system call (getpid) in a loop with both kernel entries. */
+int main(void)
+{
+    uint64_t start = 0;
+    uint64_t syscall_ns = 0;
+    uint64_t int80_ns = 0;
+
+    start = GetTimeNS();
+    for (int i = 0; i < SYSBENCH_ITERATIONS; i++) {
+        syscall0((int64_t)SYS_GETPID);
+    }
+    syscall_ns = GetTimeNS() - start;
+
+    start = GetTimeNS();
+    for (int i = 0; i < SYSBENCH_ITERATIONS; i++) {
+        int80_syscall0((int64_t)SYS_GETPID);
+    }
+    int80_ns = GetTimeNS() - start;
+
+    printf("%d null system calls:\n", SYSBENCH_ITERATIONS);
+    printf("  syscall:  %u ns/call\n", syscall_ns / SYSBENCH_ITERATIONS);
+    printf("  int 0x80: %u ns/call\n", int80_ns / SYSBENCH_ITERATIONS);
+
+    return 0;
+}
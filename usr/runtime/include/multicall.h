@@ -0,0 +1,37 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#define MULTICALL_MAXIMUM_ENTRIES   64
+#define MULTICALL_STOP_ON_ERROR     1
+
+/* One system call of a batch, the kernel writes `result`. */
+typedef struct {
+    int64_t number;
+    int64_t args[6];
+    int64_t result;
+} multicall_entry_t;
+
+typedef struct {
+    int count;
+    multicall_entry_t entries[MULTICALL_MAXIMUM_ENTRIES];
+} multicall_batch_t;
+
+/* Run `count` system calls with one kernel entry. fork, exec, clone and
+ * multicall itself are refused with -EINVAL. Return the number of entries
+ * which were run. */
+int multicall(multicall_entry_t *entries, int count, int flags);
+
+void multicall_init(multicall_batch_t *batch);
+
+/* Append a system call, return its entry to read the result after the batch is
+ * submitted, or NULL if the batch is full. */
+multicall_entry_t *multicall_add(multicall_batch_t *batch,
+                                 int64_t number,
+                                 int64_t p1,
+                                 int64_t p2,
+                                 int64_t p3);
+
+/* Run the batch and empty it, the results stay in the entries until the next
+ * multicall_add(). */
+int multicall_submit(multicall_batch_t *batch, int flags);
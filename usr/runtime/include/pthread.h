@@ -0,0 +1,23 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#define PTHREAD_MAXIMUM_THREADS     8
+#define PTHREAD_STACK_SIZE          (16*1024)
+
+/**
+ * @brief   Thread control block. It is also the thread local storage block of
+ *          the thread, the kernel loads its address to FS base, so `self` is
+ *          at %fs:0.
+ */
+typedef struct pthread {
+    struct pthread *self;
+    int tid;
+    int used;
+    void *(*start_routine)(void *);
+    void *arg;
+} *pthread_t;
+
+int pthread_create(pthread_t *thread, void *(*start_routine)(void *), void *arg);
+int pthread_join(pthread_t thread, void **retval);
+void pthread_exit(void *retval);
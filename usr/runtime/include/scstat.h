@@ -0,0 +1,55 @@
+#pragma once
+#include <stdint.h>
+
+#define SYSCALL_MAXIMUM             32
+#define SYSCALL_LATENCY_BUCKETS     32  /* Bucket i: [2^i, 2^(i+1)) cycles. */
+
+/* Counters of one system call on one CPU, times are TSC cycles. */
+typedef struct {
+    uint64_t count;
+    uint64_t cycles;
+    uint64_t histogram[SYSCALL_LATENCY_BUCKETS];
+} syscall_stats_t;
+
+#define SOFTIRQ_TIMER               0
+#define SOFTIRQ_KEYBOARD            1
+#define SOFTIRQ_COUNT               2
+
+/* Interrupt counters of one CPU: top halves and softirqs, times are TSC
+ * cycles. */
+typedef struct {
+    uint64_t hardirq_count;
+    uint64_t hardirq_cycles;
+    uint64_t softirq_count[SOFTIRQ_COUNT];
+    uint64_t softirq_cycles[SOFTIRQ_COUNT];
+} irq_stats_t;
+
+#define PREEMPT_SECTION_SYSCALL     0
+#define PREEMPT_SECTION_INTERRUPT   1
+#define PREEMPT_SECTION_POINT       2
+
+/* Preemption counters of one CPU: the longest stretch the CPU ran the kernel
+ * without a chance to switch process, times are TSC cycles. */
+typedef struct {
+    uint64_t sections;
+    uint64_t preemptions;
+    uint64_t max_cycles;
+    uint64_t max_kind;      /* PREEMPT_SECTION_*, where the section ended.   */
+    uint64_t max_number;    /* System call number or vector.                */
+} preempt_stats_t;
+
+/* Copy the counters of the first `count` system call numbers of `cpu`, return
+ * the number of copied entries, or -EINVAL if there is no such CPU. */
+int syscall_stat(int cpu, syscall_stats_t *stats, int count);
+
+/* Copy the interrupt counters of `cpu`, return 0 or -EINVAL if there is no
+ * such CPU. */
+int irq_stat(int cpu, irq_stats_t *stats);
+
+/* Copy the preemption counters of `cpu`, return 0 or -EINVAL if there is no
+ * such CPU. */
+int preempt_stat(int cpu, preempt_stats_t *stats);
+
+/* Convert TSC cycles to nanoseconds with the time page, return -1 if the
+ * kernel clock doesn't run on the TSC. */
+int syscall_cycles_to_ns(uint64_t cycles, uint64_t *ns);
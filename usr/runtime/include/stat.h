@@ -29,5 +29,21 @@ typedef struct {
     uint32_t file_size;
 } __attribute__ ((packed)) stat;
 
+/* Counters of the kernel block buffer cache. */
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t writebacks;
+    uint64_t readahead;     /* Sectors read ahead of the readers.           */
+    uint64_t readahead_hits;
+    uint64_t buffers;       /* Size of the cache in sectors.                */
+    uint64_t dirty;         /* Sectors waiting to be written back.          */
+} bcache_stats_t;
+
 /* Public function prototype -------------------------------------------------*/
-int lstat(const char *pathname, stat *statbuf);
\ No newline at end of file
+/* Copy at most `count` entries of the root directory ("." or "/"), or the
+ * entry of a file, return the number of entries. */
+int lstat(const char *pathname, stat *statbuf, int count);
+
+/* Copy the counters of the buffer cache, return 0. */
+int bcache_stat(bcache_stats_t *stats);
\ No newline at end of file
@@ -1,4 +1,5 @@
 #pragma once
+#include <stdint.h>
 
 enum SYSCALL {
     SYS_WRITE = 0,
@@ -12,13 +13,108 @@ enum SYSCALL {
     SYS_FORK = 8,
     SYS_EXEC = 9,
     SYS_LSTAT = 10,
-    SYS_CLRSRC = 11
+    SYS_CLRSRC = 11,
+    SYS_CLONE = 12,
+    SYS_THREAD_EXIT = 13,
+    SYS_THREAD_JOIN = 14,
+    SYS_SPAWN = 15,
+    SYS_CLOCK_GETTIME = 16,
+    SYS_NANOSLEEP = 17,
+    SYS_GETPID = 18,
+    SYS_MULTICALL = 19,
+    SYS_IORING_SETUP = 20,
+    SYS_IORING_ENTER = 21,
+    SYS_SYSCALL_STAT = 22,
+    SYS_IRQ_STAT = 23,
+    SYS_PREEMPT_STAT = 24,
+    SYS_BCACHE_STAT = 25
 };
 
-int syscall0(int64_t number);
-int syscall1(int64_t number, int64_t p1);
-int syscall2(int64_t number, int64_t p1, int64_t p2);
-int syscall3(int32_t number, int64_t p1, int64_t p2, int64_t p3);
-int syscall4(int32_t number, int64_t p1, int64_t p2, int64_t p3, int64_t p4);
-int syscall5(int32_t number, int64_t p1, int64_t p2, int64_t p3, int64_t p4,
-                int64_t p5);
+/* System calls take the number in rax and the arguments in rdi, rsi, rdx, r10,
+ * r8 and r9. The SYSCALL instruction overwrites rcx and r11. The wrappers are
+ * inline, so a system call is only the register moves and the instruction. */
+static inline int64_t syscall0(int64_t number)
+{
+    int64_t ret;
+
+    __asm__ __volatile__("syscall"
+                         : "=a"(ret)
+                         : "a"(number)
+                         : "rcx", "r11", "memory");
+    return ret;
+}
+
+static inline int64_t syscall1(int64_t number, int64_t p1)
+{
+    int64_t ret;
+
+    __asm__ __volatile__("syscall"
+                         : "=a"(ret)
+                         : "a"(number), "D"(p1)
+                         : "rcx", "r11", "memory");
+    return ret;
+}
+
+static inline int64_t syscall2(int64_t number, int64_t p1, int64_t p2)
+{
+    int64_t ret;
+
+    __asm__ __volatile__("syscall"
+                         : "=a"(ret)
+                         : "a"(number), "D"(p1), "S"(p2)
+                         : "rcx", "r11", "memory");
+    return ret;
+}
+
+static inline int64_t syscall3(int64_t number, int64_t p1, int64_t p2,
+                               int64_t p3)
+{
+    int64_t ret;
+
+    __asm__ __volatile__("syscall"
+                         : "=a"(ret)
+                         : "a"(number), "D"(p1), "S"(p2), "d"(p3)
+                         : "rcx", "r11", "memory");
+    return ret;
+}
+
+static inline int64_t syscall4(int64_t number, int64_t p1, int64_t p2,
+                               int64_t p3, int64_t p4)
+{
+    int64_t ret;
+    register int64_t r10 __asm__("r10") = p4;
+
+    __asm__ __volatile__("syscall"
+                         : "=a"(ret)
+                         : "a"(number), "D"(p1), "S"(p2), "d"(p3), "r"(r10)
+                         : "rcx", "r11", "memory");
+    return ret;
+}
+
+static inline int64_t syscall5(int64_t number, int64_t p1, int64_t p2,
+                               int64_t p3, int64_t p4, int64_t p5)
+{
+    int64_t ret;
+    register int64_t r10 __asm__("r10") = p4;
+    register int64_t r8 __asm__("r8") = p5;
+
+    __asm__ __volatile__("syscall"
+                         : "=a"(ret)
+                         : "a"(number), "D"(p1), "S"(p2), "d"(p3), "r"(r10),
+                           "r"(r8)
+                         : "rcx", "r11", "memory");
+    return ret;
+}
+
+/* The same as syscall0, but enters the kernel with the old software interrupt,
+ * the registers are the same. */
+static inline int64_t int80_syscall0(int64_t number)
+{
+    int64_t ret;
+
+    __asm__ __volatile__("int $0x80"
+                         : "=a"(ret)
+                         : "a"(number)
+                         : "memory");
+    return ret;
+}
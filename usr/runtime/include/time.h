@@ -0,0 +1,18 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#define CLOCK_MONOTONIC     1
+
+typedef int clockid_t;
+
+struct timespec {
+    int64_t tv_sec;
+    int64_t tv_nsec;
+};
+
+int clock_gettime(clockid_t clock_id, struct timespec *tp);
+int nanosleep(const struct timespec *req, struct timespec *rem);
+
+/* Number of sleep() ticks since boot. */
+uint64_t gettick(void);
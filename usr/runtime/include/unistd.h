@@ -2,13 +2,28 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#define WAIT_ANY_CHILD  -1
+#define WNOHANG         1
+
+/* The spawned process gets `child_fd` referring to the same file as `fd`. */
+typedef struct {
+    int fd;
+    int child_fd;
+} spawn_file_action_t;
+
 int open(const char* filename);
 int close(int fd);
 int write(int fd, const char *buf, size_t count);
 int read(int fd, char *buf, size_t count);
 unsigned int sleep(unsigned int seconds);
-void exit(void);
+void exit(int status);
 int wait(int pid);
+int waitpid(int pid, int *status, int options);
 int mem(void);
+int getpid(void);
 int fork(void);
 int exec(const char* filename);
+int spawn(const char *path,
+          char *const argv[],
+          const spawn_file_action_t *actions,
+          int action_count);
@@ -0,0 +1,62 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <ioring.h>
+
+/* Asynchronous I/O rings, the ring layout (IORing) is shared with the kernel.
+ * Fill submissions with ioring_get_sqe() and ioring_prep_*(), start them with
+ * ioring_submit() and reap the results with ioring_peek_cqe() or
+ * ioring_wait_cqe() followed by ioring_cqe_seen(). */
+
+/* The kernel shares `ring`, the other fields are private to the program. New
+ * submissions are filled up to `sqe_tail` and published to `ring.sq_tail` by
+ * ioring_submit(), so the kernel never sees a half written entry. */
+typedef struct {
+    IORing ring;
+    uint32_t sqe_tail;
+    uint32_t setup_flags;
+} ioring_t;
+
+int ioring_setup(ioring_t *ring, uint32_t flags);
+
+int ioring_enter(uint32_t to_submit, uint32_t min_complete, uint32_t flags);
+
+/* Return the next free submission entry, or NULL if the submission ring is
+ * full. The entry is started by the next ioring_submit(). */
+IORingSQE *ioring_get_sqe(ioring_t *ring);
+
+void ioring_prep_nop(IORingSQE *sqe, uint64_t user_data);
+
+void ioring_prep_read(IORingSQE *sqe,
+                      int fd,
+                      void *buf,
+                      size_t count,
+                      uint64_t user_data);
+
+void ioring_prep_write(IORingSQE *sqe,
+                       int fd,
+                       const void *buf,
+                       size_t count,
+                       uint64_t user_data);
+
+void ioring_prep_open(IORingSQE *sqe, const char *path, uint64_t user_data);
+
+void ioring_prep_close(IORingSQE *sqe, int fd, uint64_t user_data);
+
+void ioring_prep_sleep(IORingSQE *sqe, uint64_t us, uint64_t user_data);
+
+/* Start the queued submissions and wait for `wait_nr` completions, return the
+ * number of started submissions. With IORING_SETUP_SQPOLL the kernel is only
+ * entered when it has to wait or when polling stopped. */
+int ioring_submit_and_wait(ioring_t *ring, uint32_t wait_nr);
+
+int ioring_submit(ioring_t *ring);
+
+/* Return the oldest completion which is not seen yet, or NULL. */
+IORingCQE *ioring_peek_cqe(ioring_t *ring);
+
+/* Return the oldest completion, wait for it if the ring is empty. */
+IORingCQE *ioring_wait_cqe(ioring_t *ring);
+
+/* Give the completion slot back to the kernel. */
+void ioring_cqe_seen(ioring_t *ring);
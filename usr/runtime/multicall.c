@@ -0,0 +1,52 @@
+#include <multicall.h>
+#include <syscall.h>
+
+int multicall(multicall_entry_t *entries, int count, int flags)
+{
+    return syscall3((int64_t)SYS_MULTICALL,
+                    (int64_t)entries,
+                    (int64_t)count,
+                    (int64_t)flags);
+}
+
+void multicall_init(multicall_batch_t *batch)
+{
+    batch->count = 0;
+}
+
+multicall_entry_t *multicall_add(multicall_batch_t *batch,
+                                 int64_t number,
+                                 int64_t p1,
+                                 int64_t p2,
+                                 int64_t p3)
+{
+    multicall_entry_t *entry;
+
+    if (batch->count >= MULTICALL_MAXIMUM_ENTRIES) {
+        return NULL;
+    }
+
+    entry = &batch->entries[batch->count++];
+    entry->number = number;
+    entry->args[0] = p1;
+    entry->args[1] = p2;
+    entry->args[2] = p3;
+    entry->args[3] = 0;
+    entry->args[4] = 0;
+    entry->args[5] = 0;
+    entry->result = 0;
+
+    return entry;
+}
+
+int multicall_submit(multicall_batch_t *batch, int flags)
+{
+    int count = batch->count;
+
+    batch->count = 0;
+    if (count == 0) {
+        return 0;
+    }
+
+    return multicall(batch->entries, count, flags);
+}
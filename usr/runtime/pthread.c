@@ -0,0 +1,78 @@
+#include <pthread.h>
+#include <syscall.h>
+
+static struct pthread s_threads[PTHREAD_MAXIMUM_THREADS];
+static uint8_t s_stacks[PTHREAD_MAXIMUM_THREADS][PTHREAD_STACK_SIZE]
+                __attribute__((aligned(16)));
+
+/* The kernel starts a new thread here with the control block in rdi. The
+ * function never returns, so it is entered with a jump instead of a call. */
+static void ThreadStart(pthread_t thread)
+{
+    pthread_exit(thread->start_routine(thread->arg));
+}
+
+int pthread_create(pthread_t *thread, void *(*start_routine)(void *), void *arg)
+{
+    int i = 0;
+    int tid = 0;
+    uint64_t stack_top = 0;
+
+    for (i = 0; i < PTHREAD_MAXIMUM_THREADS; i++) {
+        if (!s_threads[i].used) {
+            break;
+        }
+    }
+
+    if (i == PTHREAD_MAXIMUM_THREADS) {
+        return -1;
+    }
+
+    s_threads[i].self = &s_threads[i];
+    s_threads[i].used = 1;
+    s_threads[i].start_routine = start_routine;
+    s_threads[i].arg = arg;
+
+    /* Keep the stack pointer as it is after a call instruction. */
+    stack_top = (uint64_t)&s_stacks[i][PTHREAD_STACK_SIZE] - 8;
+
+    tid = syscall4((int64_t)SYS_CLONE,
+                   (int64_t)ThreadStart,
+                   (int64_t)stack_top,
+                   (int64_t)&s_threads[i],
+                   (int64_t)&s_threads[i]);
+    if (tid < 0) {
+        s_threads[i].used = 0;
+        return tid;
+    }
+
+    s_threads[i].tid = tid;
+    *thread = &s_threads[i];
+
+    return 0;
+}
+
+int pthread_join(pthread_t thread, void **retval)
+{
+    int64_t exit_code = 0;
+    int ret = syscall2((int64_t)SYS_THREAD_JOIN,
+                       (int64_t)thread->tid,
+                       (int64_t)&exit_code);
+    if (ret < 0) {
+        return ret;
+    }
+
+    if (retval != NULL) {
+        *retval = (void *)exit_code;
+    }
+
+    /* The thread is gone, so its stack can be reused. */
+    thread->used = 0;
+
+    return 0;
+}
+
+void pthread_exit(void *retval)
+{
+    syscall1((int64_t)SYS_THREAD_EXIT, (int64_t)retval);
+}
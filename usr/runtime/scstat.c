@@ -0,0 +1,36 @@
+#include <scstat.h>
+#include <syscall.h>
+#include <vdso.h>
+
+int syscall_stat(int cpu, syscall_stats_t *stats, int count)
+{
+    return syscall3((int64_t)SYS_SYSCALL_STAT,
+                    (int64_t)cpu,
+                    (int64_t)stats,
+                    (int64_t)count);
+}
+
+int irq_stat(int cpu, irq_stats_t *stats)
+{
+    return syscall2((int64_t)SYS_IRQ_STAT, (int64_t)cpu, (int64_t)stats);
+}
+
+int preempt_stat(int cpu, preempt_stats_t *stats)
+{
+    return syscall2((int64_t)SYS_PREEMPT_STAT, (int64_t)cpu, (int64_t)stats);
+}
+
+int syscall_cycles_to_ns(uint64_t cycles, uint64_t *ns)
+{
+    const VDSOTimeData *page = (const VDSOTimeData *)VDSO_TIME_PAGE_ADDRESS;
+
+    /* mult and shift only change with the clock mode, no need to take the
+     * sequence lock. */
+    if (page->clock_mode != VDSO_CLOCK_TSC) {
+        return -1;
+    }
+
+    *ns = (uint64_t)(((unsigned __int128)cycles * page->mult) >> page->shift);
+
+    return 0;
+}
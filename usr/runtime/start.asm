@@ -5,5 +5,6 @@ extern exit
 
 Start:
     call main
+    mov rdi, rax        ; Return value of main() is the exit status.
     call exit
     jmp $
\ No newline at end of file
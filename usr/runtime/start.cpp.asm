@@ -8,6 +8,9 @@ extern __destructor_array_start
 extern __destructor_array_end
 
 Start:
+    mov r13, rdi       ; Keep argc and argv for main(), constructors preserve
+    mov r14, rsi       ; R13 and R14.
+
 ; 1. Call all global constructors of static, global objects.
 CallGlobalConstructors:
    mov rbx, __constructor_array_start
@@ -20,7 +23,10 @@ CheckConstructorList:
    jb CallConstructor
 
 ; 2. Call user main function.
+    mov rdi, r13
+    mov rsi, r14
     call main
+    mov r12, rax        ; Keep the exit status, destructors preserve R12.
 
 ; 3. Call all global destructors of static, global objects.
 CallGlobalDestructors: 
@@ -34,5 +40,6 @@ CheckDestructorList:
    jb CallDestructor
 
 ; 4. Call exit.
+    mov rdi, r12
     call exit
     jmp $
\ No newline at end of file
@@ -2,9 +2,15 @@
 #include <syscall.h>
 
 /* Public function -----------------------------------------------------------*/
-int lstat(const char *pathname, stat *statbuf)
+int lstat(const char *pathname, stat *statbuf, int count)
 {
-    return syscall2((int64_t)SYS_LSTAT,
+    return syscall3((int64_t)SYS_LSTAT,
                     (int64_t)pathname,
-                    (int64_t)statbuf);
+                    (int64_t)statbuf,
+                    (int64_t)count);
+}
+
+int bcache_stat(bcache_stats_t *stats)
+{
+    return syscall1((int64_t)SYS_BCACHE_STAT, (int64_t)stats);
 }
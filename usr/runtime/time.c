@@ -0,0 +1,74 @@
+#include <time.h>
+#include <vdso.h>
+#include <syscall.h>
+
+#define NS_PER_SECOND   1000000000
+
+uint64_t read_tsc(void);
+
+/* Read the time page, retry if the kernel updated it while we read. */
+static int vdso_clock_ns(uint64_t *ns, uint64_t *tick_ns)
+{
+    const VDSOTimeData *page = (const VDSOTimeData *)VDSO_TIME_PAGE_ADDRESS;
+    uint32_t sequence;
+    uint64_t cycles;
+
+    do {
+        sequence = page->sequence;
+        __asm__ __volatile__("" ::: "memory");
+
+        if (page->clock_mode != VDSO_CLOCK_TSC) {
+            return -1;
+        }
+
+        cycles = read_tsc() - page->base_cycles;
+        *ns = page->base_ns
+              + (uint64_t)(((unsigned __int128)cycles * page->mult)
+                           >> page->shift);
+        *tick_ns = page->tick_ns;
+
+        __asm__ __volatile__("" ::: "memory");
+    } while ((sequence & 1) != 0 || sequence != page->sequence);
+
+    return 0;
+}
+
+int clock_gettime(clockid_t clock_id, struct timespec *tp)
+{
+    uint64_t ns;
+    uint64_t tick_ns;
+
+    if (clock_id == CLOCK_MONOTONIC && vdso_clock_ns(&ns, &tick_ns) == 0) {
+        tp->tv_sec = ns / NS_PER_SECOND;
+        tp->tv_nsec = ns % NS_PER_SECOND;
+        return 0;
+    }
+
+    return syscall2((int64_t)SYS_CLOCK_GETTIME,
+                    (int64_t)clock_id,
+                    (int64_t)tp);
+}
+
+uint64_t gettick(void)
+{
+    const VDSOTimeData *page = (const VDSOTimeData *)VDSO_TIME_PAGE_ADDRESS;
+    struct timespec ts;
+    uint64_t ns;
+    uint64_t tick_ns;
+
+    if (vdso_clock_ns(&ns, &tick_ns) == 0) {
+        return ns / tick_ns;
+    }
+
+    /* The tick length is valid in every clock mode. */
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * NS_PER_SECOND + ts.tv_nsec) / page->tick_ns;
+}
+
+int nanosleep(const struct timespec *req, struct timespec *rem)
+{
+    return syscall2((int64_t)SYS_NANOSLEEP,
+                    (int64_t)req,
+                    (int64_t)rem);
+}
@@ -0,0 +1,8 @@
+section .text
+global read_tsc
+
+read_tsc:
+    rdtsc               ; EDX:EAX.
+    shl rdx, 32
+    or rax, rdx
+    ret
@@ -23,15 +23,23 @@ unsigned int sleep(unsigned int seconds)
                     (int64_t)seconds);
 }
 
-void exit(void)
+void exit(int status)
 {
-    syscall0((int64_t)SYS_EXIT);
+    syscall1((int64_t)SYS_EXIT,
+             (int64_t)status);
 }
 
 int wait(int pid)
 {
-    return syscall1((int64_t)SYS_WAIT,
-                    (int64_t)pid);
+    return waitpid(pid, NULL, 0);
+}
+
+int waitpid(int pid, int *status, int options)
+{
+    return syscall3((int64_t)SYS_WAIT,
+                    (int64_t)pid,
+                    (int64_t)status,
+                    (int64_t)options);
 }
 
 int mem(void)
@@ -51,6 +59,11 @@ int close(int fd)
                     (int64_t)fd);
 }
 
+int getpid(void)
+{
+    return syscall0((int64_t)SYS_GETPID);
+}
+
 int fork(void)
 {
     return syscall0((int64_t)SYS_FORK);
@@ -61,3 +74,15 @@ int exec(const char* filename)
     return syscall1((int64_t)SYS_EXEC,
                     (int64_t)filename);
 }
+
+int spawn(const char *path,
+          char *const argv[],
+          const spawn_file_action_t *actions,
+          int action_count)
+{
+    return syscall4((int64_t)SYS_SPAWN,
+                    (int64_t)path,
+                    (int64_t)argv,
+                    (int64_t)actions,
+                    (int64_t)action_count);
+}
@@ -0,0 +1,149 @@
+#include <uring.h>
+#include <syscall.h>
+
+#define IORING_MASK     (IORING_ENTRIES - 1)
+
+/* Ring indexes are shared with the kernel, keep the compiler from moving the
+ * entry accesses across the index accesses. */
+#define barrier()       __asm__ __volatile__("" ::: "memory")
+
+static void ioring_prep(IORingSQE *sqe,
+                        uint32_t opcode,
+                        int fd,
+                        uint64_t addr,
+                        uint64_t len,
+                        uint64_t user_data)
+{
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = addr;
+    sqe->len = len;
+    sqe->user_data = user_data;
+}
+
+int ioring_setup(ioring_t *ring, uint32_t flags)
+{
+    ring->sqe_tail = 0;
+    ring->setup_flags = flags;
+
+    return syscall2((int64_t)SYS_IORING_SETUP,
+                    (int64_t)&ring->ring,
+                    (int64_t)flags);
+}
+
+int ioring_enter(uint32_t to_submit, uint32_t min_complete, uint32_t flags)
+{
+    return syscall3((int64_t)SYS_IORING_ENTER,
+                    (int64_t)to_submit,
+                    (int64_t)min_complete,
+                    (int64_t)flags);
+}
+
+IORingSQE *ioring_get_sqe(ioring_t *ring)
+{
+    IORingSQE *sqe;
+
+    if (ring->sqe_tail - ring->ring.sq_head >= IORING_ENTRIES) {
+        return NULL;
+    }
+
+    sqe = &ring->ring.sqes[ring->sqe_tail & IORING_MASK];
+    ring->sqe_tail++;
+
+    return sqe;
+}
+
+void ioring_prep_nop(IORingSQE *sqe, uint64_t user_data)
+{
+    ioring_prep(sqe, IORING_OP_NOP, -1, 0, 0, user_data);
+}
+
+void ioring_prep_read(IORingSQE *sqe,
+                      int fd,
+                      void *buf,
+                      size_t count,
+                      uint64_t user_data)
+{
+    ioring_prep(sqe, IORING_OP_READ, fd, (uint64_t)buf, count, user_data);
+}
+
+void ioring_prep_write(IORingSQE *sqe,
+                       int fd,
+                       const void *buf,
+                       size_t count,
+                       uint64_t user_data)
+{
+    ioring_prep(sqe, IORING_OP_WRITE, fd, (uint64_t)buf, count, user_data);
+}
+
+void ioring_prep_open(IORingSQE *sqe, const char *path, uint64_t user_data)
+{
+    ioring_prep(sqe, IORING_OP_OPEN, -1, (uint64_t)path, 0, user_data);
+}
+
+void ioring_prep_close(IORingSQE *sqe, int fd, uint64_t user_data)
+{
+    ioring_prep(sqe, IORING_OP_CLOSE, fd, 0, 0, user_data);
+}
+
+void ioring_prep_sleep(IORingSQE *sqe, uint64_t us, uint64_t user_data)
+{
+    ioring_prep(sqe, IORING_OP_SLEEP, -1, 0, us, user_data);
+}
+
+int ioring_submit_and_wait(ioring_t *ring, uint32_t wait_nr)
+{
+    uint32_t submitted = ring->sqe_tail - ring->ring.sq_tail;
+    uint32_t flags = 0;
+
+    /* Publish the filled entries. */
+    barrier();
+    ring->ring.sq_tail = ring->sqe_tail;
+    barrier();
+
+    if (ring->setup_flags & IORING_SETUP_SQPOLL) {
+        if (ring->ring.flags & IORING_SQ_NEED_WAKEUP) {
+            flags |= IORING_ENTER_SQ_WAKEUP;
+        } else if (wait_nr == 0) {
+            /* The kernel is polling, it finds the new entries by itself. */
+            return submitted;
+        }
+    }
+
+    return ioring_enter(ring->sqe_tail - ring->ring.sq_head, wait_nr, flags);
+}
+
+int ioring_submit(ioring_t *ring)
+{
+    return ioring_submit_and_wait(ring, 0);
+}
+
+IORingCQE *ioring_peek_cqe(ioring_t *ring)
+{
+    if (ring->ring.cq_head == ring->ring.cq_tail) {
+        return NULL;
+    }
+
+    barrier();
+
+    return &ring->ring.cqes[ring->ring.cq_head & IORING_MASK];
+}
+
+IORingCQE *ioring_wait_cqe(ioring_t *ring)
+{
+    IORingCQE *cqe;
+
+    while ((cqe = ioring_peek_cqe(ring)) == NULL) {
+        if (ioring_enter(0, 1, 0) < 0) {
+            return NULL;
+        }
+    }
+
+    return cqe;
+}
+
+void ioring_cqe_seen(ioring_t *ring)
+{
+    barrier();
+    ring->ring.cq_head++;
+}
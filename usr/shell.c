@@ -3,6 +3,8 @@
 #include <string.h>
 #include <unistd.h>
 
+#define SHELL_MAXIMUM_ARGS 8
+
 typedef void (*CmdFunc)(void);
 
 static CmdFunc s_cmd_list[10];
@@ -11,11 +13,12 @@ uint64_t MemInfo(void);
 
 static int ReadCmd(char *buffer);
 static int ParseCmd(char *buffer, int length);
+static int SplitArgs(char *buffer, char *argv[], int max_args);
 static void ExecuteCmd(int cmd);
 static void TotalMemCmd(void);
 
 int main(void) {
-    char buffer[80] = {0};
+    char buffer[81] = {0};
     int buffer_size = 0;
     int cmd = 0;
     s_cmd_list[0] = TotalMemCmd;
@@ -49,26 +52,26 @@ int main(void) {
 
 
         } else if (cmd < 0) {
+            char *argv[SHELL_MAXIMUM_ARGS + 1] = {0};
 
-            /* Check file is exist. */
-            int fd = open(buffer);
+            buffer[buffer_size] = '\0';
+            if (SplitArgs(buffer, argv, SHELL_MAXIMUM_ARGS) == 0) {
+                continue;
+            }
 
-            if (fd < 0) {
-                buffer[buffer_size] = '\0';
-                printf("Command '%s' not found.\n", buffer);
+            /* Spawn command in another process, the kernel loads it without
+             * copying the shell memory. */
+            int pid = spawn(argv[0], argv, NULL, 0);
+            if (pid < 0) {
+                printf("Command '%s' not found.\n", argv[0]);
                 continue;
             }
 
-            close(fd);
+            /* Wait command exit. */
+            wait(pid);
 
-            int pid = fork();
-            if (pid == 0) {
-                /* Exec command in another process. */
-                exec(buffer);
-            } else {
-                /* Wait command exit. */
-                wait(pid);
-            }
+            /* We are the INIT process, collect orphans given to us. */
+            while (waitpid(WAIT_ANY_CHILD, NULL, WNOHANG) > 0);
 
         } else {
             ExecuteCmd(cmd);
@@ -113,6 +116,29 @@ static int ParseCmd(char *buffer, int length)
     return cmd;
 }
 
+static int SplitArgs(char *buffer, char *argv[], int max_args)
+{
+    int argc = 0;
+
+    while (*buffer != '\0' && argc < max_args) {
+        while (*buffer == ' ') {
+            *buffer++ = '\0';
+        }
+
+        if (*buffer == '\0') {
+            break;
+        }
+
+        argv[argc++] = buffer;
+        while (*buffer != ' ' && *buffer != '\0') {
+            buffer++;
+        }
+    }
+
+    argv[argc] = NULL;
+    return argc;
+}
+
 static void ExecuteCmd(int cmd)
 {
     CmdFunc func = s_cmd_list[cmd];